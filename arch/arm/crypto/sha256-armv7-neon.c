@@ -0,0 +1,195 @@
+/*
+ * sha256-armv7-neon.c - ARM/NEON accelerated SHA-256 transform functions
+ *
+ * This file is built with -mfpu=neon and must only be entered between
+ * kernel_neon_begin() and kernel_neon_end(), see sha256_neon_glue.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <linux/types.h>
+#include <crypto/sha.h>
+#include <arm_neon.h>
+
+static const u32 sha256_k[64] __aligned(16) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Rotate each 32-bit lane right by n */
+#define vror(x, n)	vsriq_n_u32(vshlq_n_u32((x), 32 - (n)), (x), (n))
+#define vror_d(x, n)	vsri_n_u32(vshl_n_u32((x), 32 - (n)), (x), (n))
+
+#define vs0(x)		veorq_u32(veorq_u32(vror(x, 7), vror(x, 18)), \
+				  vshrq_n_u32((x), 3))
+#define vs1(x)		veorq_u32(veorq_u32(vror(x, 17), vror(x, 19)), \
+				  vshrq_n_u32((x), 10))
+#define vs1_d(x)	veor_u32(veor_u32(vror_d(x, 17), vror_d(x, 19)), \
+				 vshr_n_u32((x), 10))
+
+static inline uint32x4_t vload_be32(const u8 *p)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+/*
+ * Expand the next four message schedule words from the previous sixteen,
+ * held in x0..x3 (x0 oldest).  Only two of the four new words can use
+ * sigma1 of words already known, the other two need the first two.
+ */
+static inline uint32x4_t sha256_neon_schedule(uint32x4_t x0, uint32x4_t x1,
+					      uint32x4_t x2, uint32x4_t x3)
+{
+	uint32x4_t t;
+	uint32x2_t lo, hi;
+
+	t = vaddq_u32(x0, vextq_u32(x2, x3, 1));
+	t = vaddq_u32(t, vs0(vextq_u32(x0, x1, 1)));
+
+	lo = vadd_u32(vget_low_u32(t), vs1_d(vget_high_u32(x3)));
+	hi = vadd_u32(vget_high_u32(t), vs1_d(lo));
+
+	return vcombine_u32(lo, hi);
+}
+
+#define ror32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define e0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+
+/*
+ * Single message: NEON computes W[t] + K[t] four at a time, the rounds,
+ * which are one long dependency chain, run in the integer pipeline.
+ */
+void sha256_transform_neon(u32 *state, const u8 *data, unsigned int blocks)
+{
+	u32 wk[64] __aligned(16);
+	u32 a, b, c, d, e, f, g, h, t1, t2;
+	uint32x4_t x0, x1, x2, x3, x4;
+	int i;
+
+	while (blocks--) {
+		x0 = vload_be32(data);
+		x1 = vload_be32(data + 16);
+		x2 = vload_be32(data + 32);
+		x3 = vload_be32(data + 48);
+		data += SHA256_BLOCK_SIZE;
+
+		vst1q_u32(&wk[0], vaddq_u32(x0, vld1q_u32(&sha256_k[0])));
+		vst1q_u32(&wk[4], vaddq_u32(x1, vld1q_u32(&sha256_k[4])));
+		vst1q_u32(&wk[8], vaddq_u32(x2, vld1q_u32(&sha256_k[8])));
+		vst1q_u32(&wk[12], vaddq_u32(x3, vld1q_u32(&sha256_k[12])));
+
+		for (i = 16; i < 64; i += 4) {
+			x4 = sha256_neon_schedule(x0, x1, x2, x3);
+			vst1q_u32(&wk[i], vaddq_u32(x4, vld1q_u32(&sha256_k[i])));
+			x0 = x1;
+			x1 = x2;
+			x2 = x3;
+			x3 = x4;
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 64; i++) {
+			t1 = h + e1(e) + Ch(e, f, g) + wk[i];
+			t2 = e0(a) + Maj(a, b, c);
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#define vCh(x, y, z)	vbslq_u32((x), (y), (z))
+#define vMaj(x, y, z)	vbslq_u32(veorq_u32((x), (y)), (z), (y))
+#define vE0(x)		veorq_u32(veorq_u32(vror(x, 2), vror(x, 13)), vror(x, 22))
+#define vE1(x)		veorq_u32(veorq_u32(vror(x, 6), vror(x, 11)), vror(x, 25))
+
+/* Load word i..i+3 of the current block of each lane, one lane per vector */
+static inline void sha256_neon_load_x4(uint32x4_t w[4], const u8 *data[4],
+				       unsigned int off)
+{
+	uint32x4x2_t t0, t1;
+
+	t0 = vtrnq_u32(vload_be32(data[0] + off), vload_be32(data[1] + off));
+	t1 = vtrnq_u32(vload_be32(data[2] + off), vload_be32(data[3] + off));
+
+	w[0] = vcombine_u32(vget_low_u32(t0.val[0]), vget_low_u32(t1.val[0]));
+	w[1] = vcombine_u32(vget_low_u32(t0.val[1]), vget_low_u32(t1.val[1]));
+	w[2] = vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0]));
+	w[3] = vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1]));
+}
+
+/*
+ * Four independent messages of the same length, one per 32-bit lane:
+ * state[j] holds word j of the four states.  All four message schedules
+ * and all four round chains are computed at once, which also keeps the
+ * round dependency chain off the critical path.
+ */
+void sha256_transform_neon_x4(u32 state[8][4], const u8 *data[4],
+			      unsigned int blocks)
+{
+	uint32x4_t w[16];
+	uint32x4_t s[8];
+	uint32x4_t a, b, c, d, e, f, g, h, t1, t2;
+	const u8 *src[4] = { data[0], data[1], data[2], data[3] };
+	int i, j;
+
+	for (j = 0; j < 8; j++)
+		s[j] = vld1q_u32(state[j]);
+
+	while (blocks--) {
+		for (i = 0; i < 16; i += 4)
+			sha256_neon_load_x4(&w[i], src, i * 4);
+		for (j = 0; j < 4; j++)
+			src[j] += SHA256_BLOCK_SIZE;
+
+		a = s[0]; b = s[1]; c = s[2]; d = s[3];
+		e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+		for (i = 0; i < 64; i++) {
+			if (i >= 16)
+				w[i & 15] = vaddq_u32(
+					vaddq_u32(w[i & 15], vs0(w[(i - 15) & 15])),
+					vaddq_u32(w[(i - 7) & 15], vs1(w[(i - 2) & 15])));
+
+			t1 = vaddq_u32(vaddq_u32(h, vE1(e)),
+				       vaddq_u32(vCh(e, f, g),
+						 vaddq_u32(w[i & 15],
+							   vdupq_n_u32(sha256_k[i]))));
+			t2 = vaddq_u32(vE0(a), vMaj(a, b, c));
+			h = g; g = f; f = e; e = vaddq_u32(d, t1);
+			d = c; c = b; b = a; a = vaddq_u32(t1, t2);
+		}
+
+		s[0] = vaddq_u32(s[0], a); s[1] = vaddq_u32(s[1], b);
+		s[2] = vaddq_u32(s[2], c); s[3] = vaddq_u32(s[3], d);
+		s[4] = vaddq_u32(s[4], e); s[5] = vaddq_u32(s[5], f);
+		s[6] = vaddq_u32(s[6], g); s[7] = vaddq_u32(s[7], h);
+	}
+
+	for (j = 0; j < 8; j++)
+		vst1q_u32(state[j], s[j]);
+}
@@ -32,5 +32,6 @@
 
 #else
 void kernel_neon_begin(void);
+bool kernel_neon_try_begin(void);
 #endif
 void kernel_neon_end(void);
@@ -26,6 +26,11 @@ extern void * memset(void *, int, __kernel_size_t);
 
 extern void __memzero(void *ptr, __kernel_size_t n);
 
+/* The assembler versions, behind the NEON ones of CONFIG_ARM_NEON_COPY */
+extern void * __memcpy_std(void *, const void *, __kernel_size_t);
+extern void * __memset_std(void *, int, __kernel_size_t);
+extern void __memzero_std(void *ptr, __kernel_size_t n);
+
 #define memset(p,v,n)							\
 	({								\
 	 	void *__p = (p); size_t __n = n;			\
@@ -87,6 +87,14 @@ EXPORT_SYMBOL(memmove);
 EXPORT_SYMBOL(memchr);
 EXPORT_SYMBOL(__memzero);
 
+#ifdef CONFIG_ARM_NEON_COPY
+	/* the integer versions behind the NEON ones, for test_neon_copy */
+EXPORT_SYMBOL(__memset_std);
+EXPORT_SYMBOL(__memcpy_std);
+EXPORT_SYMBOL(__memzero_std);
+EXPORT_SYMBOL(__copy_page_std);
+#endif
+
 	/* user mem (segment) */
 EXPORT_SYMBOL(__strnlen_user);
 EXPORT_SYMBOL(__strncpy_from_user);
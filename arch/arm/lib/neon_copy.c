@@ -0,0 +1,198 @@
+/*
+ *  linux/arch/arm/lib/neon_copy.c
+ *
+ *  memcpy(), memset(), __memzero() and copy_page() moving large buffers
+ *  through NEON.  These override the weak assembler versions and fall
+ *  back to them, through their *_std entry points, for small sizes, in
+ *  interrupt context, with interrupts disabled and from inside another
+ *  kernel mode NEON section.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/irqflags.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+#include "neon_copy.h"
+
+/* asm/string.h routes memset(p, 0, n) to __memzero() with a macro */
+#undef memset
+
+struct neon_copy_tuning {
+	unsigned int part;		/* read_cpuid_part(), 0 for the rest */
+	unsigned long threshold;	/* smallest copy worth switching for */
+	unsigned int prefetch;		/* preload distance in bytes */
+};
+
+/*
+ * kernel_neon_begin() may have to save the user's VFP registers, which
+ * the task then faults back in, so only copies of a few cache lines and
+ * more are worth it.  The out-of-order Cortex-A15 hides more memory
+ * latency than the in-order Cortex-A7, which gets the longer preload
+ * distance.  These are starting points: test_neon_copy reports the
+ * gain per size, and neon_copy= overrides them.
+ */
+static struct neon_copy_tuning neon_copy_tunings[] = {
+	{ ARM_CPU_PART_CORTEX_A15,	1024,	256 },
+	{ ARM_CPU_PART_CORTEX_A7,	2048,	384 },
+	{ 0,				2048,	256 },
+};
+
+/* Smallest copy any CPU type takes through NEON, ULONG_MAX while unusable */
+static unsigned long neon_copy_min __read_mostly = ULONG_MAX;
+
+static bool neon_copy_disabled __initdata;
+
+/*
+ * neon_copy=off, or neon_copy=<threshold>,<prefetch> for every core type,
+ * or up to three such pairs for the Cortex-A15, the Cortex-A7 and other
+ * cores in that order.
+ */
+static int __init neon_copy_setup(char *str)
+{
+	int ints[2 * ARRAY_SIZE(neon_copy_tunings) + 1];
+	unsigned int i, pair;
+
+	if (!strcmp(str, "off")) {
+		neon_copy_disabled = true;
+		return 1;
+	}
+
+	get_options(str, ARRAY_SIZE(ints), ints);
+	if (ints[0] < 2 || ints[0] & 1)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(neon_copy_tunings); i++) {
+		pair = ints[0] == 2 ? 0 : i;
+		if (2 * pair + 2 > ints[0])
+			break;
+		if (ints[2 * pair + 1] < NEON_COPY_BLOCK ||
+		    ints[2 * pair + 2] < 0)
+			return 0;
+		neon_copy_tunings[i].threshold = ints[2 * pair + 1];
+		neon_copy_tunings[i].prefetch = ints[2 * pair + 2];
+	}
+	return 1;
+}
+__setup("neon_copy=", neon_copy_setup);
+
+static const struct neon_copy_tuning *neon_copy_tuning(void)
+{
+	const struct neon_copy_tuning *t = neon_copy_tunings;
+	unsigned int part = read_cpuid_part();
+
+	while (t->part && t->part != part)
+		t++;
+	return t;
+}
+
+/*
+ * Returns the tuning of this CPU with NEON enabled, or NULL if the copy
+ * should stay in the integer loops.  Interrupts are off on the CPU PM and
+ * hotplug paths, where the VFP unit may not be accessible yet.
+ */
+static const struct neon_copy_tuning *neon_copy_begin(size_t len)
+{
+	const struct neon_copy_tuning *t;
+
+	if (len < neon_copy_min || irqs_disabled())
+		return NULL;
+
+	t = neon_copy_tuning();
+	if (len < t->threshold || !kernel_neon_try_begin())
+		return NULL;
+
+	return t;
+}
+
+/*
+ * Also reached from memmove() when dst is below src.  Every stage copies
+ * forwards and loads a block before storing it, which keeps that safe.
+ */
+void *memcpy(void *dst, const void *src, size_t len)
+{
+	const struct neon_copy_tuning *t = neon_copy_begin(len);
+	size_t head, bulk;
+
+	if (!t)
+		return __memcpy_std(dst, src, len);
+
+	/* Align the stores, the loads cope with any alignment */
+	head = -(unsigned long)dst & 15;
+	bulk = (len - head) & ~(NEON_COPY_BLOCK - 1);
+
+	__memcpy_std(dst, src, head);
+	neon_copy_blocks(dst + head, src + head, bulk, t->prefetch);
+	kernel_neon_end();
+	__memcpy_std(dst + head + bulk, src + head + bulk, len - head - bulk);
+
+	return dst;
+}
+
+/* Called with NEON enabled by neon_copy_begin(), which this undoes */
+static void neon_set(void *dst, int c, size_t len)
+{
+	size_t head = -(unsigned long)dst & 15;
+	size_t bulk = (len - head) & ~(NEON_COPY_BLOCK - 1);
+
+	__memset_std(dst, c, head);
+	neon_set_blocks(dst + head, c, bulk);
+	kernel_neon_end();
+	__memset_std(dst + head + bulk, c, len - head - bulk);
+}
+
+void *memset(void *dst, int c, size_t len)
+{
+	if (!neon_copy_begin(len))
+		return __memset_std(dst, c, len);
+
+	neon_set(dst, c, len);
+	return dst;
+}
+
+void __memzero(void *dst, size_t len)
+{
+	if (!neon_copy_begin(len)) {
+		__memzero_std(dst, len);
+		return;
+	}
+
+	neon_set(dst, 0, len);
+}
+
+void copy_page(void *to, const void *from)
+{
+	const struct neon_copy_tuning *t = neon_copy_begin(PAGE_SIZE);
+
+	if (!t) {
+		__copy_page_std(to, from);
+		return;
+	}
+
+	neon_copy_blocks(to, from, PAGE_SIZE, t->prefetch);
+	kernel_neon_end();
+}
+
+static int __init neon_copy_init(void)
+{
+	unsigned long lowest = ULONG_MAX;
+	unsigned int i;
+
+	/* vfp_init() has run by now and reported NEON, if there is any */
+	if (neon_copy_disabled || !cpu_has_neon())
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(neon_copy_tunings); i++)
+		lowest = min(lowest, neon_copy_tunings[i].threshold);
+	neon_copy_min = lowest;
+
+	return 0;
+}
+arch_initcall(neon_copy_init);
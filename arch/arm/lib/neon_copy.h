@@ -0,0 +1,14 @@
+/*
+ *  linux/arch/arm/lib/neon_copy.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* Bytes moved per iteration of the NEON loops */
+#define NEON_COPY_BLOCK		64
+
+void neon_copy_blocks(void *dst, const void *src, size_t len,
+		      unsigned int prefetch);
+void neon_set_blocks(void *dst, int c, size_t len);
@@ -0,0 +1,63 @@
+/*
+ *  linux/arch/arm/lib/neon_copy_blocks.c
+ *
+ *  Inner loops of the NEON memcpy(), memset() and copy_page(): 64 bytes
+ *  per iteration through four q registers.  Built with -mfpu=neon, so
+ *  only to be entered between kernel_neon_try_begin() and
+ *  kernel_neon_end(), see neon_copy.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <arm_neon.h>
+
+#include "neon_copy.h"
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/*
+ * Copy len bytes, a multiple of NEON_COPY_BLOCK.  The source is preloaded
+ * prefetch bytes ahead of the loads; pld never faults, so running past the
+ * end of the source is harmless.
+ */
+void neon_copy_blocks(void *dst, const void *src, size_t len,
+		      unsigned int prefetch)
+{
+	const u8 *s = src;
+	u8 *d = dst;
+	uint8x16_t a, b, c, e;
+
+	for (; len; len -= NEON_COPY_BLOCK) {
+		__builtin_prefetch(s + prefetch);
+		a = vld1q_u8(s);
+		b = vld1q_u8(s + 16);
+		c = vld1q_u8(s + 32);
+		e = vld1q_u8(s + 48);
+		s += NEON_COPY_BLOCK;
+		vst1q_u8(d, a);
+		vst1q_u8(d + 16, b);
+		vst1q_u8(d + 32, c);
+		vst1q_u8(d + 48, e);
+		d += NEON_COPY_BLOCK;
+	}
+}
+
+/* Fill len bytes, a multiple of NEON_COPY_BLOCK, with c */
+void neon_set_blocks(void *dst, int c, size_t len)
+{
+	uint8x16_t v = vdupq_n_u8(c);
+	u8 *d = dst;
+
+	for (; len; len -= NEON_COPY_BLOCK) {
+		vst1q_u8(d, v);
+		vst1q_u8(d + 16, v);
+		vst1q_u8(d + 32, v);
+		vst1q_u8(d + 48, v);
+		d += NEON_COPY_BLOCK;
+	}
+}
@@ -0,0 +1,147 @@
+/*
+ *  linux/arch/arm/lib/xor-neon.c
+ *
+ *  RAID-5 XOR block functions on 64 bytes per iteration through q
+ *  registers.  Built with -mfpu=neon, so only to be called between
+ *  kernel_neon_begin() and kernel_neon_end(), see asm/xor.h.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/raid/xor.h>
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+MODULE_LICENSE("GPL");
+
+#define XOR_NEON_LINE	64
+
+struct xor_neon_line {
+	uint64x2_t a, b, c, d;
+};
+
+static inline void xor_neon_load(struct xor_neon_line *l,
+				 const unsigned long *p)
+{
+	const u64 *s = (const u64 *)p;
+
+	l->a = vld1q_u64(s);
+	l->b = vld1q_u64(s + 2);
+	l->c = vld1q_u64(s + 4);
+	l->d = vld1q_u64(s + 6);
+}
+
+static inline void xor_neon_xor(struct xor_neon_line *l,
+				const unsigned long *p)
+{
+	const u64 *s = (const u64 *)p;
+
+	l->a = veorq_u64(l->a, vld1q_u64(s));
+	l->b = veorq_u64(l->b, vld1q_u64(s + 2));
+	l->c = veorq_u64(l->c, vld1q_u64(s + 4));
+	l->d = veorq_u64(l->d, vld1q_u64(s + 6));
+}
+
+static inline void xor_neon_store(unsigned long *p,
+				  const struct xor_neon_line *l)
+{
+	u64 *d = (u64 *)p;
+
+	vst1q_u64(d, l->a);
+	vst1q_u64(d + 2, l->b);
+	vst1q_u64(d + 4, l->c);
+	vst1q_u64(d + 6, l->d);
+}
+
+#define XOR_NEON_STEP	(XOR_NEON_LINE / sizeof(unsigned long))
+
+/* bytes is a multiple of XOR_NEON_LINE: md and btrfs XOR whole pages */
+static void
+xor_neon_2(unsigned long bytes, unsigned long *p1, unsigned long *p2)
+{
+	struct xor_neon_line l;
+	unsigned long lines = bytes / XOR_NEON_LINE;
+
+	do {
+		xor_neon_load(&l, p1);
+		xor_neon_xor(&l, p2);
+		xor_neon_store(p1, &l);
+		p1 += XOR_NEON_STEP;
+		p2 += XOR_NEON_STEP;
+	} while (--lines);
+}
+
+static void
+xor_neon_3(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	   unsigned long *p3)
+{
+	struct xor_neon_line l;
+	unsigned long lines = bytes / XOR_NEON_LINE;
+
+	do {
+		xor_neon_load(&l, p1);
+		xor_neon_xor(&l, p2);
+		xor_neon_xor(&l, p3);
+		xor_neon_store(p1, &l);
+		p1 += XOR_NEON_STEP;
+		p2 += XOR_NEON_STEP;
+		p3 += XOR_NEON_STEP;
+	} while (--lines);
+}
+
+static void
+xor_neon_4(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	   unsigned long *p3, unsigned long *p4)
+{
+	struct xor_neon_line l;
+	unsigned long lines = bytes / XOR_NEON_LINE;
+
+	do {
+		xor_neon_load(&l, p1);
+		xor_neon_xor(&l, p2);
+		xor_neon_xor(&l, p3);
+		xor_neon_xor(&l, p4);
+		xor_neon_store(p1, &l);
+		p1 += XOR_NEON_STEP;
+		p2 += XOR_NEON_STEP;
+		p3 += XOR_NEON_STEP;
+		p4 += XOR_NEON_STEP;
+	} while (--lines);
+}
+
+static void
+xor_neon_5(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	   unsigned long *p3, unsigned long *p4, unsigned long *p5)
+{
+	struct xor_neon_line l;
+	unsigned long lines = bytes / XOR_NEON_LINE;
+
+	do {
+		xor_neon_load(&l, p1);
+		xor_neon_xor(&l, p2);
+		xor_neon_xor(&l, p3);
+		xor_neon_xor(&l, p4);
+		xor_neon_xor(&l, p5);
+		xor_neon_store(p1, &l);
+		p1 += XOR_NEON_STEP;
+		p2 += XOR_NEON_STEP;
+		p3 += XOR_NEON_STEP;
+		p4 += XOR_NEON_STEP;
+		p5 += XOR_NEON_STEP;
+	} while (--lines);
+}
+
+struct xor_block_template const xor_block_neon_inner = {
+	.name	= "__inner_neon__",
+	.do_2	= xor_neon_2,
+	.do_3	= xor_neon_3,
+	.do_4	= xor_neon_4,
+	.do_5	= xor_neon_5,
+};
+EXPORT_SYMBOL(xor_block_neon_inner);
@@ -171,6 +171,7 @@ static void __init exynos_reserve_mem(void)
 		{
 			.name = "ion",
 			.size = CONFIG_ION_EXYNOS_CONTIGHEAP_SIZE * SZ_1K,
+			.reusable = 1,
 		},
 #endif
 #ifdef CONFIG_EXYNOS_CONTENT_PATH_PROTECTION
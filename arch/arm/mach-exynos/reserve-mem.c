@@ -180,6 +180,12 @@ void __init exynos_cma_region_reserve(struct cma_region *regions,
 			reg->alignment = PAGE_SIZE;
 		}
 
+		if (reg->reusable) {
+			reg->alignment = max_t(dma_addr_t, reg->alignment,
+					       CMA_REUSABLE_ALIGN);
+			reg->size = ALIGN(reg->size, CMA_REUSABLE_ALIGN);
+		}
+
 		paddr = memblock_find_in_range(0, MEMBLOCK_ALLOC_ANYWHERE,
 						reg->size, reg->alignment);
 
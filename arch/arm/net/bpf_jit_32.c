@@ -14,8 +14,10 @@
 #include <linux/filter.h>
 #include <linux/moduleloader.h>
 #include <linux/netdevice.h>
+#include <linux/seccomp.h>
 #include <linux/string.h>
 #include <linux/slab.h>
+#include <net/netlink.h>
 #include <asm/cacheflush.h>
 #include <asm/hwcap.h>
 
@@ -72,36 +74,88 @@ struct jit_ctx {
 
 int bpf_jit_enable __read_mostly;
 
-static u64 jit_get_skb_b(struct sk_buff *skb, unsigned offset)
+/*
+ * Negative offsets are relative to the network or link layer header
+ * (SKF_NET_OFF, SKF_LL_OFF) and always take the slow path.
+ */
+static int jit_copy_bits(struct sk_buff *skb, int offset, void *to, int len)
+{
+	void *ptr;
+
+	if (offset >= 0)
+		return skb_copy_bits(skb, offset, to, len);
+
+	ptr = bpf_internal_load_pointer_neg_helper(skb, offset, len);
+	if (!ptr)
+		return -EFAULT;
+	memcpy(to, ptr, len);
+	return 0;
+}
+
+static u64 jit_get_skb_b(struct sk_buff *skb, int offset)
 {
 	u8 ret;
 	int err;
 
-	err = skb_copy_bits(skb, offset, &ret, 1);
+	err = jit_copy_bits(skb, offset, &ret, 1);
 
 	return (u64)err << 32 | ret;
 }
 
-static u64 jit_get_skb_h(struct sk_buff *skb, unsigned offset)
+static u64 jit_get_skb_h(struct sk_buff *skb, int offset)
 {
 	u16 ret;
 	int err;
 
-	err = skb_copy_bits(skb, offset, &ret, 2);
+	err = jit_copy_bits(skb, offset, &ret, 2);
 
 	return (u64)err << 32 | ntohs(ret);
 }
 
-static u64 jit_get_skb_w(struct sk_buff *skb, unsigned offset)
+static u64 jit_get_skb_w(struct sk_buff *skb, int offset)
 {
 	u32 ret;
 	int err;
 
-	err = skb_copy_bits(skb, offset, &ret, 4);
+	err = jit_copy_bits(skb, offset, &ret, 4);
 
 	return (u64)err << 32 | ntohl(ret);
 }
 
+/*
+ * The netlink attribute lookups, with the error convention of the loads
+ * above: a non-zero upper word makes the filter return 0.
+ */
+static u64 jit_get_nlattr(struct sk_buff *skb, u32 A, u32 X)
+{
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb) || skb->len < sizeof(struct nlattr) ||
+	    A > skb->len - sizeof(struct nlattr))
+		return (u64)-EINVAL << 32;
+
+	nla = nla_find((struct nlattr *)&skb->data[A], skb->len - A, X);
+
+	return nla ? (void *)nla - (void *)skb->data : 0;
+}
+
+static u64 jit_get_nlattr_nest(struct sk_buff *skb, u32 A, u32 X)
+{
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb) || skb->len < sizeof(struct nlattr) ||
+	    A > skb->len - sizeof(struct nlattr))
+		return (u64)-EINVAL << 32;
+
+	nla = (struct nlattr *)&skb->data[A];
+	if (nla->nla_len > skb->len - A)
+		return (u64)-EINVAL << 32;
+
+	nla = nla_find_nested(nla, X);
+
+	return nla ? (void *)nla - (void *)skb->data : 0;
+}
+
 /*
  * Wrapper that handles both OABI and EABI and assures Thumb2 interworking
  * (where the assembly routines like __aeabi_uidiv could cause problems).
@@ -170,6 +224,9 @@ static inline bool is_load_to_a(u16 inst)
 	case BPF_S_ANC_PROTOCOL:
 	case BPF_S_ANC_RXHASH:
 	case BPF_S_ANC_QUEUE:
+	case BPF_S_ANC_PKTTYPE:
+	case BPF_S_ANC_HATYPE:
+	case BPF_S_ANC_SECCOMP_LD_W:
 		return true;
 	default:
 		return false;
@@ -466,6 +523,25 @@ static inline void update_on_xread(struct jit_ctx *ctx)
 	ctx->seen |= SEEN_X;
 }
 
+/*
+ * Call a u64 helper(skb, A, X) whose upper word is an error indication,
+ * and put the lower word in A.
+ */
+static void emit_helper_call(void *func, struct jit_ctx *ctx)
+{
+	update_on_xread(ctx);
+	ctx->seen |= SEEN_SKB | SEEN_CALL;
+
+	emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+	emit(ARM_MOV_R(ARM_R1, r_A), ctx);
+	emit(ARM_MOV_R(ARM_R2, r_X), ctx);
+	emit_mov_i(ARM_R3, (u32)func, ctx);
+	emit_blx_r(ARM_R3, ctx);
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	emit_err_ret(ARM_COND_NE, ctx);
+	emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+}
+
 static int build_body(struct jit_ctx *ctx)
 {
 	void *load_func[] = {jit_get_skb_b, jit_get_skb_h, jit_get_skb_w};
@@ -508,9 +584,6 @@ static int build_body(struct jit_ctx *ctx)
 		case BPF_S_LD_B_ABS:
 			load_order = 0;
 load:
-			/* the interpreter will deal with the negative K */
-			if ((int)k < 0)
-				return -ENOTSUPP;
 			emit_mov_i(r_off, k, ctx);
 load_common:
 			ctx->seen |= SEEN_DATA | SEEN_CALL;
@@ -519,8 +592,16 @@ load_common:
 				emit(ARM_SUB_I(r_scratch, r_skb_hl,
 					       1 << load_order), ctx);
 				emit(ARM_CMP_R(r_scratch, r_off), ctx);
-				condt = ARM_COND_HS;
+				condt = ARM_COND_GE;
+				/*
+				 * A negative offset (SKF_NET_OFF, SKF_LL_OFF
+				 * or a negative X + K) must take the slow
+				 * path: if the fast path was chosen, redo
+				 * the flags from the sign of the offset.
+				 */
+				_emit(condt, ARM_CMP_I(r_off, 0), ctx);
 			} else {
+				/* unsigned, negative offsets fail it */
 				emit(ARM_CMP_R(r_skb_hl, r_off), ctx);
 				condt = ARM_COND_HI;
 			}
@@ -557,6 +638,7 @@ load_common:
 		case BPF_S_LD_B_IND:
 			load_order = 0;
 load_ind:
+			update_on_xread(ctx);
 			OP_IMM3(ARM_ADD, r_off, r_X, k, ctx);
 			goto load_common;
 		case BPF_S_LDX_IMM:
@@ -575,10 +657,11 @@ load_ind:
 		case BPF_S_LDX_B_MSH:
 			/* x = ((*(frame + k)) & 0xf) << 2; */
 			ctx->seen |= SEEN_X | SEEN_DATA | SEEN_CALL;
-			/* the interpreter should deal with the negative K */
-			if (k < 0)
-				return -1;
-			/* offset in r1: we might have to take the slow path */
+			/*
+			 * offset in r1: we might have to take the slow path,
+			 * which is also where a negative K ends up as the
+			 * comparison is unsigned
+			 */
 			emit_mov_i(r_off, k, ctx);
 			emit(ARM_CMP_R(r_skb_hl, r_off), ctx);
 
@@ -824,6 +907,47 @@ b_epilogue:
 			off = offsetof(struct sk_buff, queue_mapping);
 			emit(ARM_LDRH_I(r_A, r_skb, off), ctx);
 			break;
+		case BPF_S_ANC_PKTTYPE:
+			/* A = skb->pkt_type */
+			ctx->seen |= SEEN_SKB;
+			off = PKT_TYPE_OFFSET();
+			emit(ARM_LDRB_I(r_scratch, r_skb, off), ctx);
+			emit(ARM_AND_I(r_A, r_scratch, PKT_TYPE_MAX), ctx);
+#ifdef __BIG_ENDIAN_BITFIELD
+			emit(ARM_LSR_I(r_A, r_A, 5), ctx);
+#endif
+			break;
+		case BPF_S_ANC_HATYPE:
+			/* A = skb->dev->type */
+			ctx->seen |= SEEN_SKB;
+			off = offsetof(struct sk_buff, dev);
+			emit(ARM_LDR_I(r_scratch, r_skb, off), ctx);
+
+			emit(ARM_CMP_I(r_scratch, 0), ctx);
+			emit_err_ret(ARM_COND_EQ, ctx);
+
+			/* too far into net_device for ldrh rd, [rn, #imm] */
+			BUILD_BUG_ON(FIELD_SIZEOF(struct net_device, type) != 2);
+			off = offsetof(struct net_device, type);
+			emit_mov_i(ARM_R3, off, ctx);
+			emit(ARM_LDRH_R(r_A, r_scratch, ARM_R3), ctx);
+			break;
+		case BPF_S_ANC_NLATTR:
+			emit_helper_call(jit_get_nlattr, ctx);
+			break;
+		case BPF_S_ANC_NLATTR_NEST:
+			emit_helper_call(jit_get_nlattr_nest, ctx);
+			break;
+#ifdef CONFIG_SECCOMP_FILTER
+		case BPF_S_ANC_SECCOMP_LD_W:
+			/* A = seccomp_bpf_load(K), there is no skb */
+			ctx->seen |= SEEN_CALL;
+			emit_mov_i(ARM_R0, k, ctx);
+			emit_mov_i(ARM_R3, (u32)seccomp_bpf_load, ctx);
+			emit_blx_r(ARM_R3, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+#endif
 		default:
 			return -1;
 		}
@@ -14,6 +14,7 @@
 #include <linux/hardirq.h>
 #include <linux/kernel.h>
 #include <linux/notifier.h>
+#include <linux/percpu.h>
 #include <linux/signal.h>
 #include <linux/sched.h>
 #include <linux/smp.h>
@@ -651,6 +652,12 @@ static int vfp_hotplug(struct notifier_block *b, unsigned long action,
 
 #ifdef CONFIG_KERNEL_MODE_NEON
 
+/*
+ * Set between kernel_neon_begin() and kernel_neon_end(), so that callers
+ * which may run inside another kernel mode NEON section can tell.
+ */
+static DEFINE_PER_CPU(bool, kernel_neon_busy);
+
 /*
  * Kernel-side NEON support functions
  */
@@ -667,6 +674,7 @@ void kernel_neon_begin(void)
 	 */
 	BUG_ON(in_interrupt());
 	cpu = get_cpu();
+	per_cpu(kernel_neon_busy, cpu) = true;
 
 	fpexc = fmrx(FPEXC) | FPEXC_EN;
 	fmxr(FPEXC, fpexc);
@@ -689,10 +697,34 @@ void kernel_neon_end(void)
 {
 	/* Disable the NEON/VFP unit. */
 	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	__this_cpu_write(kernel_neon_busy, false);
 	put_cpu();
 }
 EXPORT_SYMBOL(kernel_neon_end);
 
+/*
+ * kernel_neon_begin() for code that may be called from inside another
+ * kernel mode NEON section or from interrupt context, such as memcpy().
+ * Returns false, and leaves the NEON unit alone, where kernel_neon_begin()
+ * is not allowed or would switch NEON off under the outer section.
+ */
+bool kernel_neon_try_begin(void)
+{
+	bool busy;
+
+	if (in_interrupt())
+		return false;
+
+	preempt_disable();
+	busy = __this_cpu_read(kernel_neon_busy);
+	if (!busy)
+		kernel_neon_begin();
+	preempt_enable();
+
+	return !busy;
+}
+EXPORT_SYMBOL(kernel_neon_try_begin);
+
 #endif /* CONFIG_KERNEL_MODE_NEON */
 
 /*
@@ -28,6 +28,7 @@
 #include <linux/gfp.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/moduleparam.h>
 #include <linux/jiffies.h>
@@ -475,6 +476,164 @@ out:
 	crypto_free_hash(tfm);
 }
 
+static int test_mb_hash_jiffies(struct shash_desc *desc,
+				const u8 * const data[], int blen,
+				u8 * const outs[], unsigned int num, int sec)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = crypto_shash_init(desc);
+		if (ret)
+			return ret;
+		ret = crypto_shash_finup_mb(desc, data, blen, outs, num);
+		if (ret)
+			return ret;
+	}
+
+	printk("%6u messages/sec, %9lu bytes/sec\n",
+	       bcount * num / sec, ((long)bcount * num * blen) / sec);
+
+	return 0;
+}
+
+static int test_mb_hash_cycles(struct shash_desc *desc,
+			       const u8 * const data[], int blen,
+			       u8 * const outs[], unsigned int num)
+{
+	unsigned long cycles = 0;
+	int i;
+	int ret;
+
+	local_bh_disable();
+	local_irq_disable();
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = crypto_shash_init(desc);
+		if (ret)
+			goto out;
+		ret = crypto_shash_finup_mb(desc, data, blen, outs, num);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+
+		ret = crypto_shash_init(desc);
+		if (ret)
+			goto out;
+		ret = crypto_shash_finup_mb(desc, data, blen, outs, num);
+		if (ret)
+			goto out;
+
+		end = get_cycles();
+
+		cycles += end - start;
+	}
+
+out:
+	local_irq_enable();
+	local_bh_enable();
+
+	if (ret)
+		return ret;
+
+	printk("%6lu cycles/message, %4lu cycles/byte\n",
+	       cycles / (8 * num), cycles / (8 * num * blen));
+
+	return 0;
+}
+
+/*
+ * Compare hashing one message at a time with finishing as many as the
+ * driver takes at once through crypto_shash_finup_mb(), one tvmem page
+ * per message.
+ */
+static void test_mb_hash_speed(const char *algo, unsigned int sec,
+			       struct hash_speed *speed)
+{
+	static u8 output[TVMEMSIZE][64];
+	const u8 *data[TVMEMSIZE];
+	u8 *outs[TVMEMSIZE];
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+	unsigned int num, n;
+	int i;
+	int ret;
+
+	printk(KERN_INFO "\ntesting multi-buffer speed of %s\n", algo);
+
+	tfm = crypto_alloc_shash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		printk(KERN_ERR "failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	if (crypto_shash_digestsize(tfm) > sizeof(output[0])) {
+		printk(KERN_ERR "digestsize(%u) > outputbuffer(%zu)\n",
+		       crypto_shash_digestsize(tfm), sizeof(output[0]));
+		goto out;
+	}
+
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc)
+		goto out;
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	num = min_t(unsigned int, crypto_shash_mb_max_msgs(tfm), TVMEMSIZE);
+	for (i = 0; i < TVMEMSIZE; i++) {
+		memset(tvmem[i], 0xff, PAGE_SIZE);
+		data[i] = tvmem[i];
+		outs[i] = output[i];
+	}
+
+	printk(KERN_INFO "%s finishes up to %u messages at once\n",
+	       crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)), num);
+
+	for (i = 0; speed[i].blen != 0; i++) {
+		if (speed[i].blen > PAGE_SIZE) {
+			printk(KERN_ERR
+			       "template (%u) too big for tvmem (%lu)\n",
+			       speed[i].blen, PAGE_SIZE);
+			break;
+		}
+
+		for (n = 1; n <= num; n = n < num ? num : n + 1) {
+			printk(KERN_INFO "test%3u (%5u byte messages,%2u at once): ",
+			       i, speed[i].blen, n);
+
+			if (sec)
+				ret = test_mb_hash_jiffies(desc, data,
+							   speed[i].blen,
+							   outs, n, sec);
+			else
+				ret = test_mb_hash_cycles(desc, data,
+							  speed[i].blen,
+							  outs, n);
+
+			if (ret) {
+				printk(KERN_ERR "hashing failed ret=%d\n", ret);
+				goto out_free;
+			}
+		}
+	}
+
+out_free:
+	kfree(desc);
+out:
+	crypto_free_shash(tfm);
+}
+
 struct tcrypt_result {
 	struct completion completion;
 	int err;
@@ -1414,6 +1573,10 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_mb_hash_speed("sha256", sec, mb_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -86,6 +86,19 @@ static struct hash_speed generic_hash_speed_template[] = {
 	{  .blen = 0,	.plen = 0, }
 };
 
+/*
+ * Whole-message sizes for the multi-buffer speed test; 4096 is the usual
+ * dm-verity data block size.
+ */
+static struct hash_speed mb_hash_speed_template[] = {
+	{ .blen = 512,	.plen = 512, },
+	{ .blen = 1024,	.plen = 1024, },
+	{ .blen = 4096,	.plen = 4096, },
+
+	/* End marker */
+	{  .blen = 0,	.plen = 0, }
+};
+
 static struct hash_speed hash_speed_template_16[] = {
 	{ .blen = 16,	.plen = 16,	.klen = 16, },
 	{ .blen = 64,	.plen = 16,	.klen = 16, },
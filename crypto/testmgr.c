@@ -1433,10 +1433,98 @@ static int alg_test_pcomp(const struct alg_test_desc *desc, const char *driver,
 	return err;
 }
 
+/*
+ * Finish several copies of each vector at once through the multi-buffer
+ * interface, both from a fresh state and from one that already holds the
+ * first half of the message.  Every lane must produce the same digest.
+ */
+static int test_hash_mb(struct crypto_shash *tfm, struct hash_testvec *template,
+			unsigned int tcount)
+{
+	const char *algo = crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm));
+	unsigned int digestsize = crypto_shash_digestsize(tfm);
+	unsigned int n = min_t(unsigned int, crypto_shash_mb_max_msgs(tfm),
+			       XBUFSIZE);
+	const u8 *data[XBUFSIZE];
+	u8 *outs[XBUFSIZE];
+	char *xbuf[XBUFSIZE];
+	unsigned int i, j, k, split;
+	u8 *result;
+	int ret = -ENOMEM;
+
+	if (testmgr_alloc_buf(xbuf))
+		goto out_nobuf;
+
+	result = kmalloc(n * digestsize, GFP_KERNEL);
+	if (!result)
+		goto out_noresult;
+
+	for (k = 0; k < n; k++) {
+		data[k] = xbuf[k];
+		outs[k] = result + k * digestsize;
+	}
+
+	ret = 0;
+	for (i = 0, j = 0; i < tcount && !ret; i++) {
+		struct {
+			struct shash_desc shash;
+			char ctx[crypto_shash_descsize(tfm)];
+		} sdesc;
+
+		if (template[i].ksize)
+			continue;
+
+		j++;
+		sdesc.shash.tfm = tfm;
+		sdesc.shash.flags = 0;
+
+		for (split = 0; split <= template[i].psize / 2 && !ret;
+		     split += template[i].psize / 2 ?: 1) {
+			for (k = 0; k < n; k++)
+				memcpy(xbuf[k], template[i].plaintext + split,
+				       template[i].psize - split);
+			memset(result, 0, n * digestsize);
+
+			ret = crypto_shash_init(&sdesc.shash) ?:
+			      crypto_shash_update(&sdesc.shash,
+						  template[i].plaintext, split) ?:
+			      crypto_shash_finup_mb(&sdesc.shash, data,
+						    template[i].psize - split,
+						    outs, n);
+			if (ret) {
+				printk(KERN_ERR "alg: hash: multi-buffer finup "
+				       "failed on test %d for %s: ret=%d\n", j,
+				       algo, -ret);
+				break;
+			}
+
+			for (k = 0; k < n; k++) {
+				if (memcmp(outs[k], template[i].digest,
+					   digestsize)) {
+					printk(KERN_ERR "alg: hash: Multi-buffer "
+					       "test %d failed for %s, message "
+					       "%u of %u, split at %u\n", j,
+					       algo, k, n, split);
+					hexdump(outs[k], digestsize);
+					ret = -EINVAL;
+					break;
+				}
+			}
+		}
+	}
+
+	kfree(result);
+out_noresult:
+	testmgr_free_buf(xbuf);
+out_nobuf:
+	return ret;
+}
+
 static int alg_test_hash(const struct alg_test_desc *desc, const char *driver,
 			 u32 type, u32 mask)
 {
 	struct crypto_ahash *tfm;
+	struct crypto_shash *stfm;
 	int err;
 
 	tfm = crypto_alloc_ahash(driver, type, mask);
@@ -1453,6 +1541,19 @@ static int alg_test_hash(const struct alg_test_desc *desc, const char *driver,
 				desc->suite.hash.count, false);
 
 	crypto_free_ahash(tfm);
+	if (err)
+		return err;
+
+	/* Only shash drivers can offer a multi-buffer finup */
+	stfm = crypto_alloc_shash(driver, type, mask);
+	if (IS_ERR(stfm))
+		return 0;
+
+	if (crypto_shash_mb_max_msgs(stfm) > 1)
+		err = test_hash_mb(stfm, desc->suite.hash.vecs,
+				   desc->suite.hash.count);
+
+	crypto_free_shash(stfm);
 	return err;
 }
 
@@ -2362,6 +2463,21 @@ static const struct alg_test_desc alg_test_descs[] = {
 				}
 			}
 		}
+	}, {
+		.alg = "lz4",
+		.test = alg_test_comp,
+		.suite = {
+			.comp = {
+				.comp = {
+					.vecs = lz4_comp_tv_template,
+					.count = LZ4_COMP_TEST_VECTORS
+				},
+				.decomp = {
+					.vecs = lz4_decomp_tv_template,
+					.count = LZ4_DECOMP_TEST_VECTORS
+				}
+			}
+		}
 	}, {
 		.alg = "lzo",
 		.test = alg_test_comp,
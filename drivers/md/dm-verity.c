@@ -32,6 +32,7 @@
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
 
 #define DM_VERITY_MAX_LEVELS		63
+#define DM_VERITY_MAX_MB_MSGS		4
 
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
@@ -58,6 +59,7 @@ struct dm_verity {
 	unsigned char version;
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
+	unsigned mb_msgs;	/* data blocks hashed at once, 1 if no batching */
 	int hash_failed;	/* set to 1 if hash of any block failed */
 
 	mempool_t *io_mempool;	/* mempool of struct dm_verity_io */
@@ -97,6 +99,13 @@ struct dm_verity_io {
 	 * u8 want_digest[v->digest_size];
 	 *
 	 * To access them use: io_hash_desc(), io_real_digest() and io_want_digest().
+	 *
+	 * If v->mb_msgs > 1, the digests of a batch of data blocks follow:
+	 *
+	 * u8 mb_want_digest[v->mb_msgs][v->digest_size];
+	 * u8 mb_real_digest[v->mb_msgs][v->digest_size];
+	 *
+	 * To access them use: io_mb_want_digest() and io_mb_real_digest().
 	 */
 };
 
@@ -115,6 +124,18 @@ static u8 *io_want_digest(struct dm_verity *v, struct dm_verity_io *io)
 	return (u8 *)(io + 1) + v->shash_descsize + v->digest_size;
 }
 
+static u8 *io_mb_want_digest(struct dm_verity *v, struct dm_verity_io *io,
+			     unsigned k)
+{
+	return io_want_digest(v, io) + v->digest_size * (1 + k);
+}
+
+static u8 *io_mb_real_digest(struct dm_verity *v, struct dm_verity_io *io,
+			     unsigned k)
+{
+	return io_mb_want_digest(v, io, v->mb_msgs + k);
+}
+
 /*
  * Auxiliary structure appended to each dm-bufio buffer. If the value
  * hash_verified is nonzero, hash of the block has been verified.
@@ -278,46 +299,166 @@ release_ret_r:
 	return r;
 }
 
+static int verity_data_block_corrupted(struct dm_verity *v, sector_t block)
+{
+	DMERR_LIMIT("data block %llu is corrupted", (unsigned long long)block);
+	v->hash_failed = 1;
+#if defined(CONFIG_TZ_ICCC)
+	printk(KERN_ERR "ICCC smc ret = %d \n",exynos_smc(SMC_CMD_DMV_WRITE_STATUS, 1, 0, 0));
+#endif
+	return -EIO;
+}
+
+/*
+ * Get the hash of the specified data block into io_want_digest(v, io),
+ * verifying as much of the tree as needed on the way.
+ */
+static int verity_get_want_digest(struct dm_verity_io *io, sector_t block)
+{
+	struct dm_verity *v = io->v;
+	int i;
+
+	if (likely(v->levels)) {
+		/*
+		 * First, we try to get the requested hash for
+		 * the current block. If the hash block itself is
+		 * verified, zero is returned. If it isn't, this
+		 * function returns 0 and we fall back to whole
+		 * chain verification.
+		 */
+		int r = verity_verify_level(io, block, 0, true);
+		if (likely(!r))
+			return 0;
+		if (r < 0)
+			return r;
+	}
+
+	memcpy(io_want_digest(v, io), v->root_digest, v->digest_size);
+
+	for (i = v->levels - 1; i >= 0; i--) {
+		int r = verity_verify_level(io, block, i, false);
+		if (unlikely(r))
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+ * Data blocks queued for verity_verify_batch(), each one contained in a
+ * single bio_vec.
+ */
+struct dm_verity_batch {
+	unsigned n;
+	sector_t block[DM_VERITY_MAX_MB_MSGS];
+	struct page *page[DM_VERITY_MAX_MB_MSGS];
+	unsigned offset[DM_VERITY_MAX_MB_MSGS];
+};
+
+/*
+ * Hash the queued data blocks together: the salt is hashed once and all
+ * blocks are finished from that state by a single crypto_shash_finup_mb()
+ * call, which lets the hash driver interleave them.
+ */
+static int verity_verify_batch(struct dm_verity_io *io,
+			       struct dm_verity_batch *batch)
+{
+	struct dm_verity *v = io->v;
+	struct shash_desc *desc;
+	const u8 *data[DM_VERITY_MAX_MB_MSGS];
+	u8 *outs[DM_VERITY_MAX_MB_MSGS];
+	u8 *page[DM_VERITY_MAX_MB_MSGS];
+	unsigned n = batch->n;
+	unsigned k;
+	int r;
+
+	if (!n)
+		return 0;
+	batch->n = 0;
+
+	desc = io_hash_desc(v, io);
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	r = crypto_shash_init(desc);
+	if (r < 0) {
+		DMERR("crypto_shash_init failed: %d", r);
+		return r;
+	}
+
+	r = crypto_shash_update(desc, v->salt, v->salt_size);
+	if (r < 0) {
+		DMERR("crypto_shash_update failed: %d", r);
+		return r;
+	}
+
+	for (k = 0; k < n; k++) {
+		page[k] = kmap_atomic(batch->page[k]);
+		data[k] = page[k] + batch->offset[k];
+		outs[k] = io_mb_real_digest(v, io, k);
+	}
+	r = crypto_shash_finup_mb(desc, data, 1 << v->data_dev_block_bits,
+				  outs, n);
+	while (k--)
+		kunmap_atomic(page[k]);
+	if (r < 0) {
+		DMERR("crypto_shash_finup_mb failed: %d", r);
+		return r;
+	}
+
+	for (k = 0; k < n; k++)
+		if (unlikely(memcmp(outs[k], io_mb_want_digest(v, io, k),
+				    v->digest_size)))
+			return verity_data_block_corrupted(v, batch->block[k]);
+
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
 static int verity_verify_io(struct dm_verity_io *io)
 {
 	struct dm_verity *v = io->v;
+	struct dm_verity_batch batch;
 	unsigned b;
-	int i;
 	unsigned vector = 0, offset = 0;
+	int r;
+
+	batch.n = 0;
 
 	for (b = 0; b < io->n_blocks; b++) {
 		struct shash_desc *desc;
+		struct bio_vec *bv;
 		u8 *result;
-		int r;
 		unsigned todo;
 
-		if (likely(v->levels)) {
-			/*
-			 * First, we try to get the requested hash for
-			 * the current block. If the hash block itself is
-			 * verified, zero is returned. If it isn't, this
-			 * function returns 0 and we fall back to whole
-			 * chain verification.
-			 */
-			int r = verity_verify_level(io, io->block + b, 0, true);
-			if (likely(!r))
-				goto test_block_hash;
-			if (r < 0)
-				return r;
-		}
+		r = verity_get_want_digest(io, io->block + b);
+		if (unlikely(r))
+			return r;
 
-		memcpy(io_want_digest(v, io), v->root_digest, v->digest_size);
+		todo = 1 << v->data_dev_block_bits;
 
-		for (i = v->levels - 1; i >= 0; i--) {
-			int r = verity_verify_level(io, io->block + b, i, false);
-			if (unlikely(r))
-				return r;
+		BUG_ON(vector >= io->io_vec_size);
+		bv = &io->io_vec[vector];
+		if (v->mb_msgs > 1 && likely(bv->bv_len - offset >= todo)) {
+			memcpy(io_mb_want_digest(v, io, batch.n),
+			       io_want_digest(v, io), v->digest_size);
+			batch.block[batch.n] = io->block + b;
+			batch.page[batch.n] = bv->bv_page;
+			batch.offset[batch.n] = bv->bv_offset + offset;
+			offset += todo;
+			if (likely(offset == bv->bv_len)) {
+				offset = 0;
+				vector++;
+			}
+			if (++batch.n == v->mb_msgs) {
+				r = verity_verify_batch(io, &batch);
+				if (unlikely(r))
+					return r;
+			}
+			continue;
 		}
 
-test_block_hash:
 		desc = io_hash_desc(v, io);
 		desc->tfm = v->tfm;
 		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
@@ -335,9 +476,7 @@ test_block_hash:
 			}
 		}
 
-		todo = 1 << v->data_dev_block_bits;
 		do {
-			struct bio_vec *bv;
 			u8 *page;
 			unsigned len;
 
@@ -376,16 +515,14 @@ test_block_hash:
 			DMERR("crypto_shash_final failed: %d", r);
 			return r;
 		}
-		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
-			DMERR_LIMIT("data block %llu is corrupted",
-				(unsigned long long)(io->block + b));
-			v->hash_failed = 1;
-#if defined(CONFIG_TZ_ICCC)
-			printk(KERN_ERR "ICCC smc ret = %d \n",exynos_smc(SMC_CMD_DMV_WRITE_STATUS, 1, 0, 0));
-#endif
-			return -EIO;
-		}
+		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size)))
+			return verity_data_block_corrupted(v, io->block + b);
 	}
+
+	r = verity_verify_batch(io, &batch);
+	if (unlikely(r))
+		return r;
+
 	BUG_ON(vector != io->io_vec_size);
 	BUG_ON(offset);
 
@@ -770,6 +907,15 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	v->shash_descsize =
 		sizeof(struct shash_desc) + crypto_shash_descsize(v->tfm);
 
+	/*
+	 * Data blocks can only share the hash state up to the end of the
+	 * salt, so batching needs the salt-first format of version 1.
+	 */
+	v->mb_msgs = 1;
+	if (v->version >= 1)
+		v->mb_msgs = min_t(unsigned, crypto_shash_mb_max_msgs(v->tfm),
+				   DM_VERITY_MAX_MB_MSGS);
+
 	v->root_digest = kmalloc(v->digest_size, GFP_KERNEL);
 	if (!v->root_digest) {
 		ti->error = "Cannot allocate root digest";
@@ -847,7 +993,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	}
 
 	v->io_mempool = mempool_create_kmalloc_pool(DM_VERITY_MEMPOOL_SIZE,
-	  sizeof(struct dm_verity_io) + v->shash_descsize + v->digest_size * 2);
+	  sizeof(struct dm_verity_io) + v->shash_descsize + v->digest_size * 2 +
+	  (v->mb_msgs > 1 ? v->digest_size * 2 * v->mb_msgs : 0));
 	if (!v->io_mempool) {
 		ti->error = "Cannot allocate io mempool";
 		r = -ENOMEM;
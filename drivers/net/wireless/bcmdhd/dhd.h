@@ -672,6 +672,21 @@ extern void dhd_sched_dpc(dhd_pub_t *dhdp);
 /* Notify tx completion */
 extern void dhd_txcomplete(dhd_pub_t *dhdp, void *txp, bool success);
 
+#ifdef DHD_SKB_RECYCLE
+/* Free a tx completed packet, keeping it as an rx buffer if it qualifies */
+extern void dhd_os_pktfree_tx(dhd_pub_t *dhdp, void *pkt);
+/* Get an rx buffer, from the recycle pool of the interfaces if possible */
+extern void *dhd_os_pktget_rx(dhd_pub_t *dhdp, uint len);
+#else
+#define dhd_os_pktfree_tx(dhdp, pkt)	PKTFREE((dhdp)->osh, (pkt), TRUE)
+#define dhd_os_pktget_rx(dhdp, len)	PKTGET((dhdp)->osh, (len), FALSE)
+#endif /* DHD_SKB_RECYCLE */
+
+#ifdef DHD_LOOPBACK
+/* Turn an outgoing frame into one received from its destination */
+extern int dhd_os_pktloopback(dhd_pub_t *dhdp, void *pkt);
+#endif /* DHD_LOOPBACK */
+
 /* OS independent layer functions */
 extern int dhd_os_proto_block(dhd_pub_t * pub);
 extern int dhd_os_proto_unblock(dhd_pub_t * pub);
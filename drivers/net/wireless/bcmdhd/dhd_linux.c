@@ -44,6 +44,11 @@
 #include <linux/fs.h>
 #include <linux/ip.h>
 #include <net/addrconf.h>
+#ifdef DHD_LOOPBACK
+#include <linux/ipv6.h>
+#include <net/dst.h>
+#include <net/xfrm.h>
+#endif /* DHD_LOOPBACK */
 #include <linux/cpufreq.h>
 
 #include <asm/uaccess.h>
@@ -345,6 +350,9 @@ typedef struct dhd_if {
 	uint8			bssidx;			/* bsscfg index for the interface */
 	bool			set_macaddress;
 	bool			set_multicast;
+#ifdef DHD_SKB_RECYCLE
+	struct sk_buff_head	skb_recycle_q;	/* tx completed skbs kept for rx */
+#endif /* DHD_SKB_RECYCLE */
 } dhd_if_t;
 
 #ifdef WLMEDIA_HTSF
@@ -417,6 +425,10 @@ typedef struct dhd_info {
 	tsk_ctl_t	thr_rxf_ctl;
 	spinlock_t	rxf_lock;
 	bool		rxthread_enabled;
+#ifdef DHD_NAPI
+	struct napi_struct	rx_napi;
+	struct sk_buff_head	rx_napi_queue;	/* frames waiting for dhd_napi_poll */
+#endif /* DHD_NAPI */
 
 	/* Wakelocks */
 #if defined(CONFIG_HAS_WAKELOCK) && (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
@@ -2185,6 +2197,63 @@ static const char *_get_packet_type_str(uint16 type)
 }
 #endif /* DHD_RX_DUMP */
 
+#ifdef DHD_NAPI
+#define DHD_NAPI_WEIGHT	64
+
+/* Queue a batch of received frames for dhd_napi_poll and kick the softirq.
+ * Called from the dpc thread or tasklet, never from hard interrupt context.
+ */
+static void
+dhd_napi_rx(dhd_info_t *dhd, struct sk_buff_head *list)
+{
+	struct sk_buff_head *q = &dhd->rx_napi_queue;
+	unsigned long flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (skb_queue_len(q) > netdev_max_backlog) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		dhd->pub.rx_dropped += skb_queue_len(list);
+		__skb_queue_purge(list);
+		return;
+	}
+	skb_queue_splice_tail_init(list, q);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	/* Like netif_rx_ni(), run NET_RX_SOFTIRQ now if we are in process context */
+	local_bh_disable();
+	napi_schedule(&dhd->rx_napi);
+	local_bh_enable();
+}
+
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff_head *q = &dhd->rx_napi_queue;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int work_done = 0;
+
+	while (work_done < budget && (skb = skb_dequeue(q)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	if (work_done < budget) {
+		napi_gro_flush(napi);
+
+		/* Only complete if dhd_napi_rx did not queue more meanwhile,
+		 * otherwise stay on the poll list and get polled again.
+		 */
+		spin_lock_irqsave(&q->lock, flags);
+		if (skb_queue_empty(q))
+			__napi_complete(napi);
+		spin_unlock_irqrestore(&q->lock, flags);
+	}
+
+	return work_done;
+}
+#endif /* DHD_NAPI */
 
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
@@ -2199,8 +2268,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	wl_event_msg_t event;
 	int tout_rx = 0;
 	int tout_ctrl = 0;
+#ifdef DHD_NAPI
+	struct sk_buff_head rx_list;
+#else
 	void *skbhead = NULL;
 	void *skbprev = NULL;
+#endif /* DHD_NAPI */
 #if defined(DHD_RX_DUMP) || defined(DHD_8021X_DUMP)
 	char *dump_data;
 	uint16 protocol;
@@ -2208,6 +2281,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef DHD_NAPI
+	__skb_queue_head_init(&rx_list);
+#endif /* DHD_NAPI */
 	for (i = 0; pktbuf && i < numpkt; i++, pktbuf = pnext) {
 		struct ether_header *eh;
 #ifdef WLBTAMP
@@ -2396,6 +2472,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			ifp->stats.rx_packets++;
 		}
 
+#ifdef DHD_NAPI
+		__skb_queue_tail(&rx_list, skb);
+#else
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -2424,10 +2503,16 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) */
 			}
 		}
+#endif /* DHD_NAPI */
 	}
 
+#ifdef DHD_NAPI
+	if (!skb_queue_empty(&rx_list))
+		dhd_napi_rx(dhd, &rx_list);
+#else
 	if (dhd->rxthread_enabled && skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
+#endif /* DHD_NAPI */
 
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
@@ -2492,6 +2577,119 @@ dhd_txcomplete(dhd_pub_t *dhdp, void *txp, bool success)
 #endif
 }
 
+#ifdef DHD_SKB_RECYCLE
+/* Every pooled skb can take a receive of up to DHD_SKB_RECYCLE_BUFSZ bytes,
+ * which covers a full sized frame unless the read was padded to a block.
+ */
+#define DHD_SKB_RECYCLE_BUFSZ	1600
+#define DHD_SKB_RECYCLE_MAX	64
+
+void
+dhd_os_pktfree_tx(dhd_pub_t *dhdp, void *pkt)
+{
+	dhd_info_t *dhd = (dhd_info_t *)(dhdp->info);
+	struct sk_buff *skb = (struct sk_buff *)pkt;
+	dhd_if_t *ifp;
+	int ifidx;
+
+	if (PKTNEXT(dhdp->osh, pkt) != NULL || skb->dev == NULL)
+		goto free;
+
+	ifidx = dhd_net2idx(dhd, skb->dev);
+	if (ifidx == DHD_BAD_IF)
+		goto free;
+	ifp = dhd->iflist[ifidx];
+
+	if (skb_queue_len(&ifp->skb_recycle_q) >= DHD_SKB_RECYCLE_MAX ||
+	    !skb_recycle_check(skb, DHD_SKB_RECYCLE_BUFSZ))
+		goto free;
+
+	/* skb_recycle() has dropped the socket and dst references */
+	skb = PKTTONATIVE(dhdp->osh, pkt);
+	skb_queue_tail(&ifp->skb_recycle_q, skb);
+	return;
+
+free:
+	PKTFREE(dhdp->osh, pkt, TRUE);
+}
+
+void *
+dhd_os_pktget_rx(dhd_pub_t *dhdp, uint len)
+{
+	dhd_info_t *dhd = (dhd_info_t *)(dhdp->info);
+	struct sk_buff *skb = NULL;
+	dhd_if_t *ifp;
+	int i;
+
+	if (len > DHD_SKB_RECYCLE_BUFSZ)
+		return PKTGET(dhdp->osh, len, FALSE);
+
+	for (i = 0; i < DHD_MAX_IFS && skb == NULL; i++) {
+		ifp = dhd->iflist[i];
+		if (ifp && !skb_queue_empty(&ifp->skb_recycle_q))
+			skb = skb_dequeue(&ifp->skb_recycle_q);
+	}
+	if (skb == NULL)
+		return PKTGET(dhdp->osh, len, FALSE);
+
+	skb_put(skb, len);
+	return PKTFRMNATIVE(dhdp->osh, skb);
+}
+#endif /* DHD_SKB_RECYCLE */
+
+#ifdef DHD_LOOPBACK
+/* Make a frame handed to the bus look like it came back from its destination:
+ * detach it from the sending socket and route, and swap the MAC addresses and,
+ * for IP, the IP addresses so that the stack delivers it locally.  Swapping
+ * the two addresses changes neither the IPv4 header checksum nor the TCP/UDP
+ * pseudo header sum.  The ports are left alone, so the frame arrives on the
+ * port it was sent to.  TCP transmits clones, so the headers are copied
+ * before they are rewritten.
+ */
+int
+dhd_os_pktloopback(dhd_pub_t *dhdp, void *pkt)
+{
+	struct sk_buff *skb = (struct sk_buff *)pkt;
+	struct ether_header *eh;
+	struct iphdr *iph;
+	struct ipv6hdr *ip6h;
+	uint8 ea[ETHER_ADDR_LEN];
+	uint len;
+
+	skb_orphan(skb);
+	skb_dst_drop(skb);
+	secpath_reset(skb);
+	nf_reset(skb);
+	skb->tstamp.tv64 = 0;
+	skb->mark = 0;
+
+	if (PKTLEN(dhdp->osh, pkt) < ETHER_HDR_LEN)
+		return BCME_BADLEN;
+	if (skb_cow_head(skb, 0))
+		return BCME_NOMEM;
+	eh = (struct ether_header *)PKTDATA(dhdp->osh, pkt);
+	memcpy(ea, eh->ether_dhost, ETHER_ADDR_LEN);
+	memcpy(eh->ether_dhost, eh->ether_shost, ETHER_ADDR_LEN);
+	memcpy(eh->ether_shost, ea, ETHER_ADDR_LEN);
+
+	len = PKTLEN(dhdp->osh, pkt) - ETHER_HDR_LEN;
+	switch (ntoh16(eh->ether_type)) {
+	case ETH_P_IP:
+		iph = (struct iphdr *)(eh + 1);
+		if (len >= sizeof(*iph))
+			swap(iph->saddr, iph->daddr);
+		break;
+	case ETH_P_IPV6:
+		ip6h = (struct ipv6hdr *)(eh + 1);
+		if (len >= sizeof(*ip6h))
+			swap(ip6h->saddr, ip6h->daddr);
+		break;
+	}
+
+	return BCME_OK;
+}
+#endif /* DHD_LOOPBACK */
+
 static struct net_device_stats *
 dhd_get_stats(struct net_device *net)
 {
@@ -4054,6 +4252,9 @@ dhd_allocate_if(dhd_pub_t *dhdpub, int ifidx, char *name,
 			}
 			ifp->net = NULL;
 		}
+#ifdef DHD_SKB_RECYCLE
+		skb_queue_purge(&ifp->skb_recycle_q);
+#endif /* DHD_SKB_RECYCLE */
 	} else {
 		ifp = MALLOC(dhdinfo->pub.osh, sizeof(dhd_if_t));
 		if (ifp == NULL) {
@@ -4066,6 +4267,9 @@ dhd_allocate_if(dhd_pub_t *dhdpub, int ifidx, char *name,
 	ifp->info = dhdinfo;
 	ifp->idx = ifidx;
 	ifp->bssidx = bssidx;
+#ifdef DHD_SKB_RECYCLE
+	skb_queue_head_init(&ifp->skb_recycle_q);
+#endif /* DHD_SKB_RECYCLE */
 	if (mac != NULL)
 		memcpy(&ifp->mac_addr, mac, ETHER_ADDR_LEN);
 
@@ -4137,6 +4341,9 @@ dhd_remove_if(dhd_pub_t *dhdpub, int ifidx, bool need_rtnl_lock)
 		}
 
 		dhdinfo->iflist[ifidx] = NULL;
+#ifdef DHD_SKB_RECYCLE
+		skb_queue_purge(&ifp->skb_recycle_q);
+#endif /* DHD_SKB_RECYCLE */
 		MFREE(dhdinfo->pub.osh, ifp, sizeof(*ifp));
 
 	}
@@ -4247,6 +4454,13 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 		goto fail;
 	dhd_state |= DHD_ATTACH_STATE_ADD_IF;
 
+#ifdef DHD_NAPI
+	/* Received frames of all interfaces are polled through the primary one */
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	netif_napi_add(net, &dhd->rx_napi, dhd_napi_poll, DHD_NAPI_WEIGHT);
+	napi_enable(&dhd->rx_napi);
+#endif /* DHD_NAPI */
+
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 31))
 	net->open = NULL;
 #else
@@ -4272,9 +4486,9 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	spin_lock_init(&dhd->txqlock);
 	spin_lock_init(&dhd->dhd_lock);
 	spin_lock_init(&dhd->rxf_lock);
-#if defined(RXFRAME_THREAD)
+#if defined(RXFRAME_THREAD) && !defined(DHD_NAPI)
 	dhd->rxthread_enabled = TRUE;
-#endif /* defined(RXFRAME_THREAD) */
+#endif /* defined(RXFRAME_THREAD) && !defined(DHD_NAPI) */
 
 #ifdef DHDTCPACK_SUPPRESS
 	spin_lock_init(&dhd->tcpack_lock);
@@ -5120,7 +5334,7 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 
 	DHD_ERROR(("Firmware up: op_mode=0x%04x, MAC="MACDBG"\n",
 		dhd->op_mode, MAC2STRDBG(dhd->mac.octet)));
-#if defined(RXFRAME_THREAD) && defined(RXTHREAD_ONLYSTA)
+#if defined(RXFRAME_THREAD) && defined(RXTHREAD_ONLYSTA) && !defined(DHD_NAPI)
 	if (dhd->op_mode == DHD_FLAG_HOSTAP_MODE)
 		dhd->info->rxthread_enabled = FALSE;
 	else
@@ -6261,6 +6475,12 @@ void dhd_detach(dhd_pub_t *dhdp)
 		}
 		dhd_net_if_unlock_local(dhd);
 
+#ifdef DHD_NAPI
+		napi_disable(&dhd->rx_napi);
+		netif_napi_del(&dhd->rx_napi);
+		skb_queue_purge(&dhd->rx_napi_queue);
+#endif /* DHD_NAPI */
+
 		/*  delete primary interface 0 */
 		ifp = dhd->iflist[0];
 		ASSERT(ifp);
@@ -6274,6 +6494,9 @@ void dhd_detach(dhd_pub_t *dhdp)
 			else
 				unregister_netdev(ifp->net);
 			ifp->net = NULL;
+#ifdef DHD_SKB_RECYCLE
+			skb_queue_purge(&ifp->skb_recycle_q);
+#endif /* DHD_SKB_RECYCLE */
 			MFREE(dhd->pub.osh, ifp, sizeof(*ifp));
 			dhd->iflist[0] = NULL;
 		}
@@ -311,6 +311,12 @@ typedef struct dhd_bus {
 	bool		usebufpool;
 	int32		txinrx_thres;	/* num of in-queued pkts */
 	int32		dotxinrx;	/* tx first in dhdsdio_readframes */
+#ifdef DHD_LOOPBACK
+	bool		txloopback;	/* reflect tx frames to rx on the host */
+#ifdef PROP_TXSTATUS
+	int		txloopback_fcmode;	/* proptx mode to restore afterwards */
+#endif /* PROP_TXSTATUS */
+#endif /* DHD_LOOPBACK */
 #ifdef SDTEST
 	/* external loopback */
 	bool		ext_loop;
@@ -1693,6 +1699,33 @@ dhd_enable_oob_intr(struct dhd_bus *bus, bool enable)
 }
 #endif /* defined(OOB_INTR_ONLY) || defined(BCMSPI_ANDROID) */
 
+#ifdef DHD_LOOPBACK
+/* Host side loopback: hand a frame queued for the dongle straight back to the
+ * receive path, bypassing SDIO and the firmware, so that the host cost per
+ * packet can be measured independently of the bus and the radio.
+ */
+static void
+dhdsdio_txloopback(dhd_bus_t *bus, void *pkt)
+{
+	uchar reorder_info_buf[WLHOST_REORDERDATA_TOTLEN];
+	uint reorder_info_len;
+	int ifidx = 0;
+
+	if (dhd_prot_hdrpull(bus->dhd, &ifidx, pkt, reorder_info_buf, &reorder_info_len) != 0) {
+		bus->dhd->tx_errors++;
+		PKTFREE(bus->dhd->osh, pkt, TRUE);
+		return;
+	}
+
+	if (dhd_os_pktloopback(bus->dhd, pkt) != BCME_OK) {
+		bus->dhd->tx_errors++;
+		PKTFREE(bus->dhd->osh, pkt, TRUE);
+		return;
+	}
+	dhd_rx_frame(bus->dhd, ifidx, pkt, 1, 0);
+}
+#endif /* DHD_LOOPBACK */
+
 int
 dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 {
@@ -1708,6 +1741,22 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 	osh = bus->dhd->osh;
 	datalen = PKTLEN(osh, pkt);
 
+#ifdef DHD_LOOPBACK
+	if (bus->txloopback) {
+#ifdef PROP_TXSTATUS
+		/* proptx is off while looping back, see IOV_TXLOOPBACK.  A frame
+		 * that still went through it waits in its hanger for a tx status,
+		 * so let the dongle complete it.
+		 */
+		if (DHD_PKTTAG_WLFCPKT(PKTTAG(pkt)) == 0)
+#endif /* PROP_TXSTATUS */
+		{
+			dhdsdio_txloopback(bus, pkt);
+			return BCME_OK;
+		}
+	}
+#endif /* DHD_LOOPBACK */
+
 #ifdef SDTEST
 	/* Push the test header if doing loopback */
 	if (bus->ext_loop) {
@@ -2211,7 +2260,7 @@ done:
 			PKTSETNEXT(osh, pkt, NULL);
 			dhd_txcomplete(bus->dhd, pkt, ret != 0);
 			if (free_pkt)
-				PKTFREE(osh, pkt, TRUE);
+				dhd_os_pktfree_tx(bus->dhd, pkt);
 		}
 	}
 
@@ -2632,6 +2681,9 @@ enum {
 	IOV_PKTGEN,
 	IOV_EXTLOOP,
 #endif /* SDTEST */
+#ifdef DHD_LOOPBACK
+	IOV_TXLOOPBACK,
+#endif /* DHD_LOOPBACK */
 	IOV_SPROM,
 	IOV_TXBOUND,
 	IOV_RXBOUND,
@@ -2691,6 +2743,9 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 	{"extloop",	IOV_EXTLOOP,	0,	IOVT_BOOL,	0 },
 	{"pktgen",	IOV_PKTGEN,	0,	IOVT_BUFFER,	sizeof(dhd_pktgen_t) },
 #endif /* SDTEST */
+#ifdef DHD_LOOPBACK
+	{"txloopback",	IOV_TXLOOPBACK,	0,	IOVT_BOOL,	0 },
+#endif /* DHD_LOOPBACK */
 #if defined(USE_SDIOFIFO_IOVAR)
 	{"watermark",	IOV_WATERMARK,	0,	IOVT_UINT32,	0 },
 	{"mesbusyctrl",	IOV_MESBUSYCTRL,	0,	IOVT_UINT32,	0 },
@@ -3868,6 +3923,30 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 		break;
 #endif /* SDTEST */
 
+#ifdef DHD_LOOPBACK
+	case IOV_GVAL(IOV_TXLOOPBACK):
+		int_val = (int32)bus->txloopback;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_TXLOOPBACK):
+		if (bool_val == bus->txloopback)
+			break;
+#ifdef PROP_TXSTATUS
+		/* Nothing answers proptx with tx status or credits in loopback, so
+		 * it is off meanwhile.  Frames already at the dongle keep their
+		 * hanger slots and credits, so toggle this with the link idle.
+		 */
+		if (bool_val) {
+			dhd_wlfc_mode_off(bus->dhd, &bus->txloopback_fcmode);
+		} else {
+			dhd_wlfc_set_mode(bus->dhd, bus->txloopback_fcmode);
+		}
+#endif /* PROP_TXSTATUS */
+		bus->txloopback = bool_val;
+		break;
+#endif /* DHD_LOOPBACK */
+
 #if defined(USE_SDIOFIFO_IOVAR)
 	case IOV_GVAL(IOV_WATERMARK):
 		int_val = (int32)watermark;
@@ -4932,7 +5011,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 
 			/* Allocate/chain packet for next subframe */
-			if ((pnext = PKTGET(osh, sublen + DHD_SDALIGN, FALSE)) == NULL) {
+			if ((pnext = dhd_os_pktget_rx(bus->dhd, sublen + DHD_SDALIGN)) == NULL) {
 				DHD_ERROR(("%s: PKTGET failed, num %d len %d\n",
 				           __FUNCTION__, num, sublen));
 				break;
@@ -5457,7 +5536,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 			 */
 			/* Allocate a packet buffer */
 			dhd_os_sdlock_rxq(bus->dhd);
-			if (!(pkt = PKTGET(osh, rdlen + DHD_SDALIGN, FALSE))) {
+			if (!(pkt = dhd_os_pktget_rx(bus->dhd, rdlen + DHD_SDALIGN))) {
 				if (bus->bus == SPI_BUS) {
 					bus->usebufpool = FALSE;
 					bus->rxctl = bus->rxbuf;
@@ -5909,7 +5988,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 		}
 
 		dhd_os_sdlock_rxq(bus->dhd);
-		if (!(pkt = PKTGET(osh, (rdlen + firstread + DHD_SDALIGN), FALSE))) {
+		if (!(pkt = dhd_os_pktget_rx(bus->dhd, (rdlen + firstread + DHD_SDALIGN)))) {
 			/* Give up on data, request rtx of events */
 			DHD_ERROR(("%s: PKTGET failed: rdlen %d chan %d\n",
 			           __FUNCTION__, rdlen, chan));
@@ -2141,8 +2141,8 @@ _dhd_wlfc_compressed_txstatus_update(dhd_pub_t *dhd, uint8* pkt_info, uint8 len,
 				}
 			}
 			if (!waitevent) {
-				/* free the packet */
-				PKTFREE(wlfc->osh, pktbuf, TRUE);
+				/* free the packet, or keep it as an rx buffer */
+				dhd_os_pktfree_tx(dhd, pktbuf);
 			}
 		}
 		/* pkt back from firmware side */
@@ -3092,8 +3092,8 @@ dhd_wlfc_txcomplete(dhd_pub_t *dhd, void *txp, bool success)
 				BCM_REFERENCE(ret);
 				ASSERT((ret == BCME_OK) && pktbuf_tmp && (txp == pktbuf_tmp));
 
-				/* free the packet */
-				PKTFREE(wlfc->osh, txp, TRUE);
+				/* free the packet, or keep it as an rx buffer */
+				dhd_os_pktfree_tx(dhd, txp);
 			}
 		}
 	}
@@ -3905,6 +3905,30 @@ int dhd_wlfc_set_mode(dhd_pub_t *dhd, int val)
 	return BCME_OK;
 }
 
+/* Switch proptx off, returning the mode it had in *val.  The frames it
+ * committed to the bus queue are released in the same locked step, so that
+ * none is committed in between and then completed outside of the hanger.
+ */
+int dhd_wlfc_mode_off(dhd_pub_t *dhd, int *val)
+{
+	if (!dhd || !val) {
+		DHD_ERROR(("Error: %s():%d\n", __FUNCTION__, __LINE__));
+		return BCME_BADARG;
+	}
+
+	dhd_os_wlfc_block(dhd);
+
+	*val = dhd->wlfc_state ? dhd->proptxstatus_mode : 0;
+	if (dhd->wlfc_state && (dhd->proptxstatus_mode != WLFC_FCMODE_NONE)) {
+		_dhd_wlfc_cleanup_txq(dhd, NULL, 0);
+		dhd->proptxstatus_mode = WLFC_FCMODE_NONE;
+	}
+
+	dhd_os_wlfc_unblock(dhd);
+
+	return BCME_OK;
+}
+
 bool dhd_wlfc_is_header_only_pkt(dhd_pub_t * dhd, void *pktbuf)
 {
 	athost_wl_status_info_t* wlfc;
@@ -496,6 +496,7 @@ int dhd_wlfc_clear_counts(dhd_pub_t *dhd);
 int dhd_wlfc_get_enable(dhd_pub_t *dhd, bool *val);
 int dhd_wlfc_get_mode(dhd_pub_t *dhd, int *val);
 int dhd_wlfc_set_mode(dhd_pub_t *dhd, int val);
+int dhd_wlfc_mode_off(dhd_pub_t *dhd, int *val);
 bool dhd_wlfc_is_supported(dhd_pub_t *dhd);
 bool dhd_wlfc_is_header_only_pkt(dhd_pub_t * dhd, void *pktbuf);
 int dhd_wlfc_flowcontrol(dhd_pub_t *dhdp, bool state, bool bAcquireLock);
@@ -224,6 +224,9 @@ struct cma_allocator;
  *		one allocation request for.  Private.
  * @registered:	Whether this region has been registered.  Read only.
  * @reserved:	Whether this region has been reserved.  Early.  Read only.
+ * @reusable:	Whether the page allocator may use the region for movable
+ *		pages while no chunks occupy it.  Start and size of such
+ *		a region must be aligned to CMA_REUSABLE_ALIGN.  Early.
  * @copy_name:	Whether @name and @alloc_name needs to be copied when
  *		this region is converted from early to normal.  Early.
  *		Private.
@@ -266,6 +269,7 @@ struct cma_region {
 	unsigned used:1;
 	unsigned registered:1;
 	unsigned reserved:1;
+	unsigned reusable:1;
 	unsigned copy_name:1;
 	unsigned free_alloc_name:1;
 };
@@ -294,6 +298,14 @@ struct cma_region {
  */
 int __must_check cma_region_register(struct cma_region *reg);
 
+/*
+ * Reusable regions are handed to the page allocator in whole
+ * MIGRATE_CMA pageblocks which must not be merged with buddies
+ * outside of the region.
+ */
+#define CMA_REUSABLE_ALIGN \
+	(PAGE_SIZE << max_t(unsigned long, MAX_ORDER - 1, pageblock_order))
+
 /**
  * cma_region_unregister() - unregisters a region.
  * @reg:	Region to unregister.
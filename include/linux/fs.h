@@ -698,6 +698,7 @@ struct address_space {
 	struct mutex		i_mmap_mutex;	/* protect tree, count, list */
 	/* Protected by tree_lock together with the radix tree */
 	unsigned long		nrpages;	/* number of total pages */
+	unsigned long		nr_ra_evicted;	/* readahead markers reclaimed */
 	pgoff_t			writeback_index;/* writeback starts here */
 	const struct address_space_operations *a_ops;	/* methods */
 	unsigned long		flags;		/* error bits/gfp mask */
@@ -1036,6 +1037,13 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	unsigned int adapt_pages;	/* Adaptive window, 0 until resized */
+	unsigned int ra_used;		/* Used pages of retired windows */
+	unsigned int ra_wasted;		/* Wasted pages of retired windows */
+	unsigned int mmap_hit;		/* mmap hits in the current window */
+	unsigned int ra_retired;	/* Current window accounted for */
+	unsigned long ra_evicted;	/* Last seen mapping->nr_ra_evicted */
 };
 
 /*
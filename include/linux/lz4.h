@@ -84,4 +84,14 @@ int lz4_decompress(const unsigned char *src, size_t *src_len,
  */
 int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
 		unsigned char *dest, size_t *dest_len);
+
+/*
+ * With CONFIG_LZ4_DECOMPRESS_NEON, lz4_decompress_unknownoutputsize() picks
+ * one of these at run time.  They are exported for the self-test only; the
+ * NEON one must be called between kernel_neon_begin() and kernel_neon_end().
+ */
+int lz4_decompress_unknownoutputsize_generic(const unsigned char *src,
+		size_t src_len, unsigned char *dest, size_t *dest_len);
+int lz4_decompress_unknownoutputsize_neon(const unsigned char *src,
+		size_t src_len, unsigned char *dest, size_t *dest_len);
 #endif
@@ -27,6 +27,16 @@ int lzo1x_1_compress(const unsigned char *src, size_t src_len,
 int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
 			  unsigned char *dst, size_t *dst_len);
 
+/*
+ * With CONFIG_LZO_DECOMPRESS_NEON, lzo1x_decompress_safe() picks one of these
+ * at run time.  They are exported for the self-test only; the NEON one must
+ * be called between kernel_neon_begin() and kernel_neon_end().
+ */
+int lzo1x_decompress_safe_generic(const unsigned char *src, size_t src_len,
+				  unsigned char *dst, size_t *dst_len);
+int lzo1x_decompress_safe_neon(const unsigned char *src, size_t src_len,
+			       unsigned char *dst, size_t *dst_len);
+
 /*
  * Return values (< 0 = Error)
  */
@@ -1461,6 +1461,9 @@ unsigned long max_sane_readahead(unsigned long nr);
 unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
+unsigned long ra_adaptive_pages(struct file_ra_state *ra);
+void ra_retire_window(struct file_ra_state *ra, struct address_space *mapping,
+		      unsigned long used);
 
 extern unsigned long stack_guard_gap;
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
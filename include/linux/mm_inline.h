@@ -24,6 +24,49 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+/*
+ * The list a page is linked on when added to @lru of @lruvec.  With the
+ * multi-generation LRU, active pages start in the youngest generation and
+ * the others in the one after the oldest, to be evicted soon unless used.
+ */
+static inline struct list_head *lruvec_add_list(struct lruvec *lruvec,
+						enum lru_list lru)
+{
+#ifdef CONFIG_LRU_GEN
+	if (lru_gen_enabled() && !is_unevictable_lru(lru)) {
+		struct lru_gen *lrugen = &lruvec->lrugen;
+		int type = is_file_lru(lru);
+		unsigned long seq;
+
+		if (is_active_lru(lru))
+			seq = lrugen->max_seq;
+		else
+			seq = min(lrugen->min_seq[type] + 1, lrugen->max_seq);
+		return &lrugen->lists[lru_gen_from_seq(seq)][type];
+	}
+#endif
+	return &lruvec->lists[lru];
+}
+
+/*
+ * The list whose tail reclaim takes pages of @lru from next: with the
+ * multi-generation LRU, the oldest generation of that type.
+ */
+static inline struct list_head *lruvec_evict_list(struct lruvec *lruvec,
+						  enum lru_list lru)
+{
+#ifdef CONFIG_LRU_GEN
+	if (lru_gen_enabled() && !is_unevictable_lru(lru)) {
+		struct lru_gen *lrugen = &lruvec->lrugen;
+		int type = is_file_lru(lru);
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		return &lrugen->lists[gen][type];
+	}
+#endif
+	return &lruvec->lists[lru];
+}
+
 static inline void
 add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list lru)
 {
@@ -32,11 +75,11 @@ add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list lru)
 	lruvec = mem_cgroup_lru_add_list(zone, page, lru);
 #ifdef CONFIG_SCFS_LOWER_PAGECACHE_INVALIDATION
 	if (PageNocache(page))
-		list_add_tail(&page->lru, &lruvec->lists[lru]);
+		list_add_tail(&page->lru, lruvec_add_list(lruvec, lru));
 	else
-		list_add(&page->lru, &lruvec->lists[lru]);
+		list_add(&page->lru, lruvec_add_list(lruvec, lru));
 #else
-	list_add(&page->lru, &lruvec->lists[lru]);
+	list_add(&page->lru, lruvec_add_list(lruvec, lru));
 #endif
 	__mod_zone_page_state(zone, NR_LRU_BASE + lru, hpage_nr_pages(page));
 }
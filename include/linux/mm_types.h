@@ -267,6 +267,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* swapin_readahead() state */
+#endif
 };
 
 struct core_thread {
@@ -390,6 +393,18 @@ struct mm_struct {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	pgtable_t pmd_huge_pte; /* protected by page_table_lock */
 #endif
+#ifdef CONFIG_LRU_GEN
+	/* on the list of mms whose page tables reclaim walks for aging */
+	struct list_head lru_gen_list;
+#endif
+#ifdef CONFIG_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * Set by reclaim under the pte lock when it clears a pte without
+	 * flushing the TLB; anyone changing ptes under that lock must then
+	 * call flush_tlb_batched_pending() first.
+	 */
+	bool tlb_flush_batched;
+#endif
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
@@ -40,8 +40,30 @@
 #define MIGRATE_MOVABLE       2
 #define MIGRATE_PCPTYPES      3 /* the number of types on the pcp lists */
 #define MIGRATE_RESERVE       3
+#ifdef CONFIG_CMA
+/*
+ * MIGRATE_CMA migration type is designed to mimic the way
+ * ZONE_MOVABLE works.  Only movable pages can be allocated
+ * from MIGRATE_CMA pageblocks and page allocator never
+ * implicitly change migration type of MIGRATE_CMA pageblock.
+ *
+ * The way to use it is to change migratetype of a range of
+ * pageblocks to MIGRATE_CMA which can be done by
+ * init_cma_reserved_pageblock() function.
+ */
+#define MIGRATE_CMA           4
+#define MIGRATE_ISOLATE       5 /* can't allocate from here */
+#define MIGRATE_TYPES         6
+#else
 #define MIGRATE_ISOLATE       4 /* can't allocate from here */
 #define MIGRATE_TYPES         5
+#endif
+
+#ifdef CONFIG_CMA
+#  define is_migrate_cma(migratetype) unlikely((migratetype) == MIGRATE_CMA)
+#else
+#  define is_migrate_cma(migratetype) false
+#endif
 
 #define for_each_migratetype_order(order, type) \
 	for (order = 0; order < MAX_ORDER; order++) \
@@ -116,6 +138,7 @@ enum zone_stat_item {
 	NUMA_OTHER,		/* allocation from other node */
 #endif
 	NR_ANON_TRANSPARENT_HUGEPAGES,
+	NR_FREE_CMA_PAGES,	/* free pages in MIGRATE_CMA pageblocks */
 	NR_VM_ZONE_STAT_ITEMS };
 
 /*
@@ -159,10 +182,59 @@ static inline int is_unevictable_lru(enum lru_list lru)
 	return (lru == LRU_UNEVICTABLE);
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-generation LRU, see mm/vmscan.c.  Generations are numbered by an
+ * ever increasing sequence; at most MAX_NR_GENS of them are live at once,
+ * and reclaim never evicts from the MIN_NR_GENS youngest.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+struct lru_gen {
+	/* the youngest generation, shared by anon and file pages */
+	unsigned long max_seq;
+	/* the oldest generation of anon [0] and file [1] pages */
+	unsigned long min_seq[2];
+	/* when each generation was created, in jiffies */
+	unsigned long timestamps[MAX_NR_GENS];
+	/* pages of each generation and type, evicted from the tail */
+	struct list_head lists[MAX_NR_GENS][2];
+};
+
+extern bool lru_gen_on;
+
+static inline bool lru_gen_enabled(void)
+{
+	return lru_gen_on;
+}
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+#else
+static inline bool lru_gen_enabled(void)
+{
+	return false;
+}
+#endif
+
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen lrugen;
+#endif
 };
 
+#ifdef CONFIG_LRU_GEN
+extern void lru_gen_init_lruvec(struct lruvec *lruvec);
+#else
+static inline void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+}
+#endif
+
 /* Mask used at gathering information at once (see memcontrol.c) */
 #define LRU_ALL_FILE (BIT(LRU_INACTIVE_FILE) | BIT(LRU_ACTIVE_FILE))
 #define LRU_ALL_ANON (BIT(LRU_INACTIVE_ANON) | BIT(LRU_ACTIVE_ANON))
@@ -190,6 +262,25 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Blocks of order 1 to PCP_HIGH_ORDER are also kept on per cpu lists, so
+ * that the small high order allocations of kernel stacks, network buffers
+ * and drivers do not take zone->lock every time.
+ */
+#ifdef CONFIG_PCP_HIGH_ORDER
+#define PCP_HIGH_ORDER	CONFIG_PCP_HIGH_ORDER
+#else
+#define PCP_HIGH_ORDER	0
+#endif
+
+struct per_cpu_order_pages {
+	int count;		/* number of blocks in the list */
+	int high;		/* high watermark, in blocks */
+	int batch;		/* chunk size for buddy add/remove, in blocks */
+
+	struct list_head lists[MIGRATE_PCPTYPES];
+};
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -197,6 +288,10 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+#if PCP_HIGH_ORDER > 0
+	/* Lists of order 1 .. PCP_HIGH_ORDER blocks */
+	struct per_cpu_order_pages orders[PCP_HIGH_ORDER];
+#endif
 };
 
 struct per_cpu_pageset {
@@ -362,6 +457,9 @@ struct zone {
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
 	int			compact_order_failed;
+	/* The same for kcompactd, kept apart from direct compaction */
+	unsigned int		kcompactd_considered;
+	unsigned int		kcompactd_defer_shift;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -629,6 +727,21 @@ extern struct page *mem_map;
  * Memory statistics and page replacement data structures are maintained on a
  * per-zone basis.
  */
+/* Upper bound of the vm.kswapd_threads sysctl */
+#define MAX_KSWAPD_THREADS	8
+
+struct pglist_data;
+
+/* One of the kswapd threads of a node, see kswapd_run() */
+struct kswapd_thread {
+	struct task_struct *task;
+	struct pglist_data *pgdat;
+	int id;
+	/* Pending request from wakeup_kswapd(), taken by the thread */
+	int max_order;
+	enum zone_type classzone_idx;
+};
+
 struct bootmem_data;
 typedef struct pglist_data {
 	struct zone node_zones[MAX_NR_ZONES];
@@ -659,9 +772,13 @@ typedef struct pglist_data {
 					     range, including holes */
 	int node_id;
 	wait_queue_head_t kswapd_wait;
-	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
-	int kswapd_max_order;
-	enum zone_type classzone_idx;
+	/* The first kswapd_threads are running; lock_memory_hotplug() */
+	struct kswapd_thread kswapd[MAX_KSWAPD_THREADS];
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_requested;	/* set by wakeup_kcompactd() */
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
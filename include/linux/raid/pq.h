@@ -60,6 +60,10 @@ extern const char raid6_empty_zero_page[PAGE_SIZE];
 #define cpu_has_feature(x) 1
 #define enable_kernel_altivec()
 #define disable_kernel_altivec()
+#define cpu_has_neon() 1
+#define may_use_simd() 1
+#define kernel_neon_begin()
+#define kernel_neon_end()
 
 #define EXPORT_SYMBOL(sym)
 #define EXPORT_SYMBOL_GPL(sym)
@@ -80,6 +84,15 @@ struct raid6_calls {
 /* Selected algorithm */
 extern struct raid6_calls raid6_call;
 
+/* Recovery routine choices, the highest valid priority is used */
+struct raid6_recov_calls {
+	void (*data2)(int, size_t, int, int, void **);
+	void (*datap)(int, size_t, int, void **);
+	int  (*valid)(void);	/* Returns 1 if this routine set is usable */
+	const char *name;	/* Name of this routine set */
+	int priority;		/* Preferred over lower priorities */
+};
+
 /* Various routine sets */
 extern const struct raid6_calls raid6_intx1;
 extern const struct raid6_calls raid6_intx2;
@@ -98,9 +111,17 @@ extern const struct raid6_calls raid6_altivec1;
 extern const struct raid6_calls raid6_altivec2;
 extern const struct raid6_calls raid6_altivec4;
 extern const struct raid6_calls raid6_altivec8;
+extern const struct raid6_calls raid6_neonx1;
+extern const struct raid6_calls raid6_neonx2;
+extern const struct raid6_calls raid6_neonx4;
+extern const struct raid6_calls raid6_neonx8;
+
+extern const struct raid6_recov_calls raid6_recov_intx1;
+extern const struct raid6_recov_calls raid6_recov_neon;
 
 /* Algorithm list */
 extern const struct raid6_calls * const raid6_algos[];
+extern const struct raid6_recov_calls * const raid6_recov_algos[];
 int raid6_select_algo(void);
 
 /* Return values from chk_syndrome */
@@ -114,11 +135,14 @@ extern const u8 raid6_gfmul[256][256] __attribute__((aligned(256)));
 extern const u8 raid6_gfexp[256]      __attribute__((aligned(256)));
 extern const u8 raid6_gfinv[256]      __attribute__((aligned(256)));
 extern const u8 raid6_gfexi[256]      __attribute__((aligned(256)));
-
-/* Recovery routines */
-void raid6_2data_recov(int disks, size_t bytes, int faila, int failb,
-		       void **ptrs);
-void raid6_datap_recov(int disks, size_t bytes, int faila, void **ptrs);
+/* raid6_gfmul[c] split in products of the low and of the high nibble */
+extern const u8 raid6_vgfmul[256][32] __attribute__((aligned(256)));
+
+/* Recovery routines, of the selected recovery algorithm */
+extern void (*raid6_2data_recov)(int disks, size_t bytes, int faila,
+				 int failb, void **ptrs);
+extern void (*raid6_datap_recov)(int disks, size_t bytes, int faila,
+				 void **ptrs);
 void raid6_dual_recov(int disks, size_t bytes, int faila, int failb,
 		      void **ptrs);
 
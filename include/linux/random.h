@@ -112,6 +112,12 @@ static inline void prandom_seed_state(struct rnd_state *state, u64 seed)
 	state->s3 = __seed(i, 16);
 }
 
+/* Pseudo random number generator from numerical recipes. */
+static inline u32 next_pseudo_random32(u32 seed)
+{
+	return seed * 1664525 + 1013904223;
+}
+
 #ifdef CONFIG_ARCH_RANDOM
 # include <asm/archrandom.h>
 #else
@@ -1277,6 +1277,9 @@ enum perf_event_task_context {
 	perf_nr_task_contexts,
 };
 
+/* Number of mms a reclaimer defers TLB flushes for before flushing */
+#define TLB_UBC_NR_MM		8
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1634,6 +1637,17 @@ struct task_struct {
 		unsigned long memsw_nr_pages; /* uncharged mem+swap usage */
 	} memcg_batch;
 #endif
+#ifdef CONFIG_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * mms whose TLB flush was deferred by reclaim: see
+	 * try_to_unmap_flush().  Each mm holds an mm_count reference.
+	 */
+	struct tlbflush_unmap_batch {
+		struct mm_struct *mm[TLB_UBC_NR_MM];
+		int nr_mm;
+		bool writable;	/* a dirty pte was unmapped */
+	} tlb_ubc;
+#endif
 #ifdef CONFIG_HAVE_HW_BREAKPOINT
 	atomic_t ptrace_bp_refcnt;
 #endif
@@ -106,6 +106,22 @@ int kmem_cache_shrink(struct kmem_cache *);
 void kmem_cache_free(struct kmem_cache *, void *);
 unsigned int kmem_cache_size(struct kmem_cache *);
 
+/*
+ * Bulk allocation and freeing of objects of a single cache.
+ * kmem_cache_alloc_bulk() returns the number of objects stored in the
+ * array, which is either all of them or 0.  kmem_cache_free_bulk() may
+ * clobber the array it is passed.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
+int kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+
+/*
+ * True if the allocator checks or tracks each object of the cache as it is
+ * allocated and freed, so callers keeping objects of their own around to
+ * hand them out again would bypass that.
+ */
+bool kmem_cache_debugged(struct kmem_cache *);
+
 /*
  * Please use this macro to create slab caches. Simply specify the
  * name of the structure and maybe some flags that are listed above.
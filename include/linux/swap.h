@@ -174,6 +174,30 @@ enum {
 #define SWAP_CONT_MAX	0x7f	/* Max count, in each swap_map continuation */
 #define COUNT_CONTINUED	0x80	/* See swap_map continuation for full count */
 #define SWAP_MAP_SHMEM	0xbf	/* Owned by shmem/tmpfs, in first swap_map */
+#define SWAP_MAP_FREEING (SWAP_HAS_CACHE | SWAP_MAP_BAD) /* Freed entry which
+					 * is parked in a swap slots cache */
+
+/*
+ * Swap areas are divided into clusters of SWAPFILE_CLUSTER entries.  Each
+ * cluster carries its own lock, which serializes updates of the swap_map
+ * counts inside it, so that swap_duplicate() and swap_free() on different
+ * clusters do not contend on swap_info_struct.lock.  The usage count lets
+ * the allocator find an entirely free cluster without scanning swap_map.
+ */
+struct swap_cluster_info {
+	spinlock_t lock;		/* protect swap_map entries in cluster */
+	unsigned int count;		/* entries in use, under si->lock */
+};
+
+/*
+ * Per cpu allocation cursor into a cluster, so that cpus allocating
+ * from the same solid state swap area hand out entries from different
+ * clusters rather than fighting over cluster_next.
+ */
+struct percpu_cluster {
+	unsigned int next;		/* next offset to try in the cluster */
+	unsigned int end;		/* end of the cluster, 0 if none */
+};
 
 /*
  * The in-memory structure used to track swap areas.
@@ -193,6 +217,8 @@ struct swap_info_struct {
 	unsigned int cluster_nr;	/* countdown to next cluster search */
 	unsigned int lowest_alloc;	/* while preparing discard cluster */
 	unsigned int highest_alloc;	/* while preparing discard cluster */
+	struct swap_cluster_info *cluster_info; /* vmalloc'ed, per cluster */
+	struct percpu_cluster __percpu *percpu_cluster; /* SSD allocation */
 	struct swap_extent *curr_swap_extent;
 	struct swap_extent first_swap_extent;
 	struct block_device *bdev;	/* swap device or bdev of swap file */
@@ -209,6 +235,13 @@ struct swap_info_struct {
 					 * flags need hold this lock and
 					 * swap_lock. If both locks need hold,
 					 * hold swap_lock first.
+					 * swap_map entries are updated with
+					 * their cluster lock held as well,
+					 * which nests inside this lock.
+					 */
+	spinlock_t cont_lock;		/*
+					 * protect swap count continuation
+					 * page lists.
 					 */
 #ifdef CONFIG_FRONTSWAP
 	unsigned long *frontswap_map;	/* frontswap in-use, one bit per page */
@@ -277,6 +310,19 @@ extern int vm_swappiness;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern long vm_total_pages;
 
+#ifdef CONFIG_LRU_GEN
+extern void lru_gen_add_mm(struct mm_struct *mm);
+extern void lru_gen_del_mm(struct mm_struct *mm);
+#else
+static inline void lru_gen_add_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_del_mm(struct mm_struct *mm)
+{
+}
+#endif
+
 #ifdef CONFIG_NUMA
 extern int zone_reclaim_mode;
 extern int sysctl_min_unmapped_ratio;
@@ -311,6 +357,10 @@ static inline void scan_unevictable_unregister_node(struct node *node)
 
 extern int kswapd_run(int nid);
 extern void kswapd_stop(int nid);
+extern int kswapd_threads;
+extern int proactive_free_kbytes;
+extern int kswapd_threads_sysctl_handler(struct ctl_table *, int,
+					 void __user *, size_t *, loff_t *);
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
 extern int mem_cgroup_swappiness(struct mem_cgroup *mem);
 #else
@@ -351,16 +401,19 @@ extern void __delete_from_swap_cache(struct page *);
 extern void delete_from_swap_cache(struct page *);
 extern void free_page_and_swap_cache(struct page *);
 extern void free_pages_and_swap_cache(struct page **, int);
-extern struct page *lookup_swap_cache(swp_entry_t);
+extern struct page *lookup_swap_cache(swp_entry_t, struct vm_area_struct *vma,
+			unsigned long addr);
 extern struct page *read_swap_cache_async(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern struct page *swap_cluster_readahead(swp_entry_t, gfp_t,
+			struct vm_area_struct *vma, unsigned long addr);
 extern struct page *swapin_readahead(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern int sysctl_swap_vma_readahead;
 
 /* linux/mm/swapfile.c */
 extern atomic_long_t nr_swap_pages;
 extern long total_swap_pages;
-extern bool is_swap_fast(swp_entry_t entry);
 
 /* Swap 50% full? Release swapcache more aggressively.. */
 static inline bool vm_swap_full(struct swap_info_struct *si)
@@ -382,6 +435,7 @@ static inline long get_nr_swap_pages(void)
 
 extern void si_swapinfo(struct sysinfo *);
 extern swp_entry_t get_swap_page(void);
+extern int get_swap_pages(int n, swp_entry_t swp_entries[]);
 extern swp_entry_t get_swap_page_of_type(int);
 extern int add_swap_count_continuation(swp_entry_t, gfp_t);
 extern void swap_shmem_alloc(swp_entry_t);
@@ -389,6 +443,7 @@ extern int swap_duplicate(swp_entry_t);
 extern int swapcache_prepare(swp_entry_t);
 extern void swap_free(swp_entry_t);
 extern void swapcache_free(swp_entry_t, struct page *page);
+extern void swapcache_free_entries(swp_entry_t *entries, int n);
 extern int free_swap_and_cache(swp_entry_t);
 extern int swap_type_of(dev_t, sector_t, struct block_device **);
 extern unsigned int count_swap_pages(int, int);
@@ -396,6 +451,7 @@ extern sector_t map_swap_page(struct page *, struct block_device **);
 extern sector_t swapdev_block(int, pgoff_t);
 extern int page_swapcount(struct page *);
 extern struct swap_info_struct *page_swap_info(struct page *);
+extern int __swp_swapcount(swp_entry_t entry);
 extern int swp_swapcount(swp_entry_t entry);
 extern int reuse_swap_page(struct page *);
 extern int try_to_free_swap(struct page *);
@@ -462,12 +518,20 @@ static inline struct page *swapin_readahead(swp_entry_t swp, gfp_t gfp_mask,
 	return NULL;
 }
 
+static inline struct page *swap_cluster_readahead(swp_entry_t swp,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr)
+{
+	return NULL;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
 }
 
-static inline struct page *lookup_swap_cache(swp_entry_t swp)
+static inline struct page *lookup_swap_cache(swp_entry_t swp,
+			struct vm_area_struct *vma, unsigned long addr)
 {
 	return NULL;
 }
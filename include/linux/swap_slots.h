@@ -0,0 +1,33 @@
+#ifndef _LINUX_SWAP_SLOTS_H
+#define _LINUX_SWAP_SLOTS_H
+
+#include <linux/swap.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+
+#define SWAP_SLOTS_CACHE_SIZE			64
+#define THRESHOLD_ACTIVATE_SWAP_SLOTS_CACHE	(5 * SWAP_SLOTS_CACHE_SIZE)
+#define THRESHOLD_DEACTIVATE_SWAP_SLOTS_CACHE	(2 * SWAP_SLOTS_CACHE_SIZE)
+
+/*
+ * Per cpu cache of swap entries: get_swap_page() hands out entries from
+ * slots[], refilled SWAP_SLOTS_CACHE_SIZE at a time by get_swap_pages(),
+ * and free_swap_slot() collects released entries in slots_ret[] until a
+ * full batch can be given back by swapcache_free_entries().
+ */
+struct swap_slots_cache {
+	struct mutex	alloc_lock;	/* protects slots, nr, cur */
+	swp_entry_t	*slots;
+	int		nr;
+	int		cur;
+	spinlock_t	free_lock;	/* protects slots_ret, n_ret */
+	swp_entry_t	*slots_ret;
+	int		n_ret;
+};
+
+extern void enable_swap_slots_cache(void);
+extern void disable_swap_slots_cache(void);
+extern void reenable_swap_slots_cache(void);
+extern void free_swap_slot(swp_entry_t entry);
+
+#endif /* _LINUX_SWAP_SLOTS_H */
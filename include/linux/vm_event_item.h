@@ -35,11 +35,17 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #endif
 		PGINODESTEAL, SLABS_SCANNED, KSWAPD_INODESTEAL,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
-		KSWAPD_SKIP_CONGESTION_WAIT,
+		KSWAPD_SKIP_CONGESTION_WAIT, KSWAPD_PROACTIVE_STEAL,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		READAHEAD_USED, READAHEAD_WASTED,
+		READAHEAD_GROW, READAHEAD_SHRINK,
+#ifdef CONFIG_SWAP
+		SWAP_RA, SWAP_RA_HIT,
+#endif
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_WAKE, KCOMPACTD_MIGRATED, KCOMPACTD_MSECS,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
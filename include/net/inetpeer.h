@@ -59,6 +59,15 @@ struct inet_peer {
 		struct inet_peer	*gc_next;
 	};
 
+	/* TCP Fast Open client state, see net/ipv4/tcp_fastopen.c */
+	struct {
+		u16		mss;		/* MSS the server last announced */
+		u16		syn_loss;	/* Recurring Fast Open SYN losses */
+		unsigned long	last_syn_loss;	/* Last Fast Open SYN loss */
+		s8		cookie_len;
+		u8		cookie[16];	/* TCP_FASTOPEN_COOKIE_MAX */
+	} tcp_fastopen;
+
 	/* following fields might be frequently dirtied */
 	__u32			dtime;	/* the time of last use of not referenced entries */
 	atomic_t		refcnt;
@@ -4,6 +4,7 @@
 #include <linux/if_tunnel.h>
 #include <net/ip.h>
 #include <net/ip_vs.h>
+#include <net/gro_cells.h>
 
 /* Keep error state on tunnel for 30 sec */
 #define IPTUNNEL_ERR_TIMEO	(30*HZ)
@@ -37,6 +38,8 @@ struct ip_tunnel {
 #endif
 	struct ip_tunnel_prl_entry __rcu *prl;		/* potential router list */
 	unsigned int			prl_count;	/* # of entries in PRL */
+
+	struct gro_cells		gro_cells;	/* GRE only */
 };
 
 struct ip_tunnel_prl_entry {
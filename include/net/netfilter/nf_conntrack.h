@@ -77,6 +77,7 @@ struct nf_conn {
 	struct nf_conntrack ct_general;
 
 	spinlock_t lock;
+	u16 cpu;	/* whose unconfirmed or dying list we are on */
 
 	/* XXX should I move this to the tail ? - Y.K */
 	/* These are my tuples; original and reply */
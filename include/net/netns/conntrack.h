@@ -4,19 +4,30 @@
 #include <linux/list.h>
 #include <linux/list_nulls.h>
 #include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/seqlock.h>
 
 struct ctl_table_header;
 struct nf_conntrack_ecache;
+struct nf_ct_flow_cache;
+
+struct ct_pcpu {
+	spinlock_t		lock;
+	struct hlist_nulls_head unconfirmed;
+	struct hlist_nulls_head dying;
+};
 
 struct netns_ct {
 	atomic_t		count;
 	unsigned int		expect_count;
 	unsigned int		htable_size;
 	struct kmem_cache	*nf_conntrack_cachep;
+	seqcount_t		generation;
 	struct hlist_nulls_head	*hash;
 	struct hlist_head	*expect_hash;
-	struct hlist_nulls_head	unconfirmed;
-	struct hlist_nulls_head	dying;
+	struct ct_pcpu __percpu	*pcpu_lists;
+	struct nf_ct_flow_cache __percpu *flow_cache;
+	atomic_t		flow_cache_gen;
 	struct ip_conntrack_stat __percpu *stat;
 	struct nf_ct_event_notifier __rcu *nf_conntrack_event_cb;
 	struct nf_exp_event_notifier __rcu *nf_expect_event_cb;
@@ -132,6 +132,7 @@ static int __maybe_unused two = 2;
 static int __maybe_unused three = 3;
 static unsigned long one_ul = 1;
 static int one_hundred = 100;
+static int max_kswapd_threads = MAX_KSWAPD_THREADS;
 #ifdef CONFIG_ZSWAP
 extern int max_swappiness;
 #endif
@@ -266,6 +267,7 @@ static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compaction_order = MAX_ORDER - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1070,6 +1072,17 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= &zero,
 	},
+#ifdef CONFIG_SWAP
+	{
+		.procname	= "swap_vma_readahead",
+		.data		= &sysctl_swap_vma_readahead,
+		.maxlen		= sizeof(sysctl_swap_vma_readahead),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 	{
 		.procname	= "dirty_background_ratio",
 		.data		= &dirty_background_ratio,
@@ -1217,6 +1230,24 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compaction_proactiveness",
+		.data		= &sysctl_compaction_proactiveness,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_hundred,
+	},
+	{
+		.procname	= "compaction_proactive_order",
+		.data		= &sysctl_compaction_proactive_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &max_compaction_order,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -1235,6 +1266,23 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= min_free_kbytes_sysctl_handler,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "proactive_free_kbytes",
+		.data		= &proactive_free_kbytes,
+		.maxlen		= sizeof(proactive_free_kbytes),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "kswapd_threads",
+		.data		= &kswapd_threads,
+		.maxlen		= sizeof(kswapd_threads),
+		.mode		= 0644,
+		.proc_handler	= kswapd_threads_sysctl_handler,
+		.extra1		= &one,
+		.extra2		= &max_kswapd_threads,
+	},
 	{
 		.procname	= "min_free_order_shift",
 		.data		= &min_free_order_shift,
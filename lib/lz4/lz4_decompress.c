@@ -47,6 +47,32 @@
 
 #include "lz4defs.h"
 
+/*
+ * lz4_decompress_neon.c builds the bounded decoder below a second time with
+ * LZ4_WIDECOPY() defined as a 16-byte NEON copy.  When that is configured,
+ * lz4_decompress_unknownoutputsize() picks one of the two at run time and
+ * the C version stays reachable as lz4_decompress_unknownoutputsize_generic().
+ */
+#ifndef STATIC
+#if IS_ENABLED(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(LZ4_WIDECOPY)
+#define LZ4_NEON_DISPATCH
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* Below this, saving the NEON registers costs more than it gains */
+#define LZ4_NEON_MIN_OUTPUT	256
+#endif
+#endif
+
+#if defined(LZ4_WIDECOPY)
+#define LZ4_DECOMPRESS_UNKNOWN	lz4_decompress_unknownoutputsize_neon
+#elif defined(LZ4_NEON_DISPATCH)
+#define LZ4_DECOMPRESS_UNKNOWN	lz4_decompress_unknownoutputsize_generic
+#else
+#define LZ4_DECOMPRESS_UNKNOWN	lz4_decompress_unknownoutputsize
+#endif
+
+#ifndef LZ4_WIDECOPY
 static int lz4_uncompress(const char *source, char *dest, int osize)
 {
 	const BYTE *ip = (const BYTE *) source;
@@ -164,6 +190,7 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 _output_error:
 	return -1;
 }
+#endif /* !LZ4_WIDECOPY */
 
 static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				int isize, size_t maxoutputsize)
@@ -218,7 +245,14 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			op += length;
 			break;/* Necessarily EOF, due to parsing restrictions */
 		}
-		LZ4_WILDCOPY(ip, op, cpy);
+#ifdef LZ4_WIDECOPY
+		/* Wide copy only where its over-read and over-write stay inside */
+		if (cpy <= oend - LZ4_WIDECOPYLENGTH &&
+		    ip + length <= iend - LZ4_WIDECOPYLENGTH)
+			LZ4_WIDECOPY(ip, op, cpy);
+		else
+#endif
+			LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
 
@@ -283,7 +317,15 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+#ifdef LZ4_WIDECOPY
+		/* Each 16-byte load must only see bytes already written */
+		if (op - ref >= LZ4_WIDECOPYLENGTH &&
+		    cpy <= oend - LZ4_WIDECOPYLENGTH) {
+			if (op < cpy)
+				LZ4_WIDECOPY(ref, op, cpy);
+		} else
+#endif
+			LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -294,6 +336,7 @@ _output_error:
 	return -1;
 }
 
+#ifndef LZ4_WIDECOPY
 int lz4_decompress(const unsigned char *src, size_t *src_len,
 		unsigned char *dest, size_t actual_dest_len)
 {
@@ -312,8 +355,9 @@ exit_0:
 #ifndef STATIC
 EXPORT_SYMBOL(lz4_decompress);
 #endif
+#endif /* !LZ4_WIDECOPY */
 
-int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+int LZ4_DECOMPRESS_UNKNOWN(const unsigned char *src, size_t src_len,
 		unsigned char *dest, size_t *dest_len)
 {
 	int ret = -1;
@@ -330,8 +374,31 @@ exit_0:
 	return ret;
 }
 #ifndef STATIC
+EXPORT_SYMBOL(LZ4_DECOMPRESS_UNKNOWN);
+#endif
+
+#ifdef LZ4_NEON_DISPATCH
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	int ret;
+
+	if (*dest_len < LZ4_NEON_MIN_OUTPUT || !cpu_has_neon() ||
+	    !may_use_simd())
+		return lz4_decompress_unknownoutputsize_generic(src, src_len,
+				dest, dest_len);
+
+	kernel_neon_begin();
+	ret = lz4_decompress_unknownoutputsize_neon(src, src_len, dest,
+			dest_len);
+	kernel_neon_end();
+
+	return ret;
+}
 EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+#endif
 
+#if !defined(STATIC) && !defined(LZ4_WIDECOPY)
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("LZ4 Decompressor");
 #endif
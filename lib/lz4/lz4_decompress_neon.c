@@ -0,0 +1,33 @@
+/*
+ * LZ4 Decompressor for Linux kernel, NEON copy loops
+ *
+ * The bounded decoder of lz4_decompress.c, built with -mfpu=neon so that
+ * literal runs and matches at least 16 bytes back are moved 16 bytes per
+ * load/store pair.  lz4_decompress_unknownoutputsize() calls it between
+ * kernel_neon_begin() and kernel_neon_end(); nothing else should.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+#define LZ4_WIDECOPYLENGTH	16
+
+#define LZ4_WIDECOPY(s, d, e)						\
+	do {								\
+		vst1q_u8((uint8_t *)(d), vld1q_u8((const uint8_t *)(s)));	\
+		d += LZ4_WIDECOPYLENGTH;				\
+		s += LZ4_WIDECOPYLENGTH;				\
+	} while (d < e)
+
+#include "lz4_decompress.c"
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor, NEON accelerated");
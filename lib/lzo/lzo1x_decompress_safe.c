@@ -19,6 +19,31 @@
 #include <linux/lzo.h>
 #include "lzodefs.h"
 
+/*
+ * lzo1x_decompress_safe_neon.c builds this file a second time with COPY16()
+ * defined as a 16-byte NEON copy.  When that is configured,
+ * lzo1x_decompress_safe() picks one of the two at run time and the C
+ * version stays reachable as lzo1x_decompress_safe_generic().
+ */
+#ifndef STATIC
+#if IS_ENABLED(CONFIG_LZO_DECOMPRESS_NEON) && !defined(COPY16)
+#define LZO_NEON_DISPATCH
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* Below this, saving the NEON registers costs more than it gains */
+#define LZO_NEON_MIN_OUTPUT	256
+#endif
+#endif
+
+#if defined(COPY16)
+#define LZO1X_DECOMPRESS_SAFE	lzo1x_decompress_safe_neon
+#elif defined(LZO_NEON_DISPATCH)
+#define LZO1X_DECOMPRESS_SAFE	lzo1x_decompress_safe_generic
+#else
+#define LZO1X_DECOMPRESS_SAFE	lzo1x_decompress_safe
+#endif
+
 #define HAVE_IP(x)      ((size_t)(ip_end - ip) >= (size_t)(x))
 #define HAVE_OP(x)      ((size_t)(op_end - op) >= (size_t)(x))
 #define NEED_IP(x)      if (!HAVE_IP(x)) goto input_overrun
@@ -35,7 +60,7 @@
  */
 #define MAX_255_COUNT      ((((size_t)~0) / 255) - 2)
 
-int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+int LZO1X_DECOMPRESS_SAFE(const unsigned char *in, size_t in_len,
 			  unsigned char *out, size_t *out_len)
 {
 	unsigned char *op;
@@ -86,13 +111,19 @@ copy_literal_run:
 					const unsigned char *ie = ip + t;
 					unsigned char *oe = op + t;
 					do {
+#  if defined(COPY16)
+						COPY16(op, ip);
+						op += 16;
+						ip += 16;
+#  else
 						COPY8(op, ip);
 						op += 8;
 						ip += 8;
-#  if !defined(__arm__)
+#   if !defined(__arm__)
 						COPY8(op, ip);
 						op += 8;
 						ip += 8;
+#   endif
 #  endif
 					} while (ip < ie);
 					ip = ie;
@@ -188,6 +219,15 @@ copy_literal_run:
 		if (op - m_pos >= 8) {
 			unsigned char *oe = op + t;
 			if (likely(HAVE_OP(t + 15))) {
+#  if defined(COPY16)
+				if (op - m_pos >= 16) {
+					do {
+						COPY16(op, m_pos);
+						op += 16;
+						m_pos += 16;
+					} while (op < oe);
+				} else
+#  endif
 				do {
 					COPY8(op, m_pos);
 					op += 8;
@@ -264,9 +304,29 @@ lookbehind_overrun:
 	return LZO_E_LOOKBEHIND_OVERRUN;
 }
 #ifndef STATIC
+EXPORT_SYMBOL_GPL(LZO1X_DECOMPRESS_SAFE);
+#endif
+
+#ifdef LZO_NEON_DISPATCH
+int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+			  unsigned char *out, size_t *out_len)
+{
+	int ret;
+
+	if (*out_len < LZO_NEON_MIN_OUTPUT || !cpu_has_neon() ||
+	    !may_use_simd())
+		return lzo1x_decompress_safe_generic(in, in_len, out, out_len);
+
+	kernel_neon_begin();
+	ret = lzo1x_decompress_safe_neon(in, in_len, out, out_len);
+	kernel_neon_end();
+
+	return ret;
+}
 EXPORT_SYMBOL_GPL(lzo1x_decompress_safe);
+#endif
 
+#if !defined(STATIC) && !defined(COPY16)
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("LZO1X Decompressor");
-
 #endif
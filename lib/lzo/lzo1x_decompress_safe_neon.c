@@ -0,0 +1,27 @@
+/*
+ *  LZO1X Decompressor, NEON copy loops
+ *
+ *  lzo1x_decompress_safe.c built with -mfpu=neon so that literal runs and
+ *  matches at least 16 bytes back are moved 16 bytes per load/store pair.
+ *  lzo1x_decompress_safe() calls it between kernel_neon_begin() and
+ *  kernel_neon_end(); nothing else should.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+#define COPY16(dst, src)	\
+		vst1q_u8((uint8_t *)(dst), vld1q_u8((const uint8_t *)(src)))
+
+#include "lzo1x_decompress_safe.c"
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X Decompressor, NEON accelerated");
@@ -33,6 +33,12 @@ EXPORT_SYMBOL(raid6_empty_zero_page);
 struct raid6_calls raid6_call;
 EXPORT_SYMBOL_GPL(raid6_call);
 
+void (*raid6_2data_recov)(int, size_t, int, int, void **);
+EXPORT_SYMBOL_GPL(raid6_2data_recov);
+
+void (*raid6_datap_recov)(int, size_t, int, void **);
+EXPORT_SYMBOL_GPL(raid6_datap_recov);
+
 const struct raid6_calls * const raid6_algos[] = {
 	&raid6_intx1,
 	&raid6_intx2,
@@ -61,6 +67,20 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_altivec4,
 	&raid6_altivec8,
 #endif
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_neonx1,
+	&raid6_neonx2,
+	&raid6_neonx4,
+	&raid6_neonx8,
+#endif
+	NULL
+};
+
+const struct raid6_recov_calls *const raid6_recov_algos[] = {
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_recov_neon,
+#endif
+	&raid6_recov_intx1,
 	NULL
 };
 
@@ -72,6 +92,24 @@ const struct raid6_calls * const raid6_algos[] = {
 #define time_before(x, y) ((x) < (y))
 #endif
 
+/* Recovery has no benchmark: take the valid set of highest priority */
+static void __init raid6_choose_recov(void)
+{
+	const struct raid6_recov_calls *const *algo;
+	const struct raid6_recov_calls *best = NULL;
+
+	for (algo = raid6_recov_algos; *algo; algo++)
+		if (!best || (*algo)->priority > best->priority)
+			if (!(*algo)->valid || (*algo)->valid())
+				best = *algo;
+
+	/* intx1 is always valid */
+	raid6_2data_recov = best->data2;
+	raid6_datap_recov = best->datap;
+
+	printk("raid6: using %s recovery algorithm\n", best->name);
+}
+
 /* Try to pick the best algorithm */
 /* This code uses the gfmul table as convenient data set to abuse */
 
@@ -86,6 +124,8 @@ int __init raid6_select_algo(void)
 	int bestprefer;
 	unsigned long j0, j1;
 
+	raid6_choose_recov();
+
 	disks = (65536/PAGE_SIZE)+2;
 	for ( i = 0 ; i < disks-2 ; i++ ) {
 		dptrs[i] = ((char *)raid6_gfmul) + PAGE_SIZE*i;
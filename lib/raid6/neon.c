@@ -0,0 +1,53 @@
+/*
+ * raid6/neon.c
+ *
+ * NEON RAID-6 syndrome calculation: claims the NEON unit around the
+ * unrolled routines of neon.uc, which are built with -mfpu=neon.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/raid/pq.h>
+
+#ifdef __KERNEL__
+#include <asm/neon.h>
+#include <asm/simd.h>
+#endif
+
+#include "neon.h"
+
+/*
+ * In interrupt context the NEON registers cannot be claimed, use the
+ * integer version of the same unroll factor there.
+ */
+#define RAID6_NEON_WRAPPER(_n)						\
+	static void raid6_neon ## _n ## _gen_syndrome(int disks,	\
+					size_t bytes, void **ptrs)	\
+	{								\
+		if (!may_use_simd()) {					\
+			raid6_intx ## _n.gen_syndrome(disks, bytes, ptrs); \
+			return;						\
+		}							\
+		kernel_neon_begin();					\
+		raid6_neon ## _n ## _gen_syndrome_real(disks,		\
+					(unsigned long)bytes, ptrs);	\
+		kernel_neon_end();					\
+	}								\
+	const struct raid6_calls raid6_neonx ## _n = {			\
+		raid6_neon ## _n ## _gen_syndrome,			\
+		raid6_have_neon,					\
+		"neonx" #_n,						\
+		0							\
+	}
+
+static int raid6_have_neon(void)
+{
+	return cpu_has_neon();
+}
+
+RAID6_NEON_WRAPPER(1);
+RAID6_NEON_WRAPPER(2);
+RAID6_NEON_WRAPPER(4);
+RAID6_NEON_WRAPPER(8);
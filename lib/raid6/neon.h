@@ -0,0 +1,25 @@
+/*
+ * raid6/neon.h
+ *
+ * The parts of the NEON RAID-6 routines built with -mfpu=neon, which are
+ * only to be called between kernel_neon_begin() and kernel_neon_end().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+void raid6_neon1_gen_syndrome_real(int disks, unsigned long bytes,
+				   void **ptrs);
+void raid6_neon2_gen_syndrome_real(int disks, unsigned long bytes,
+				   void **ptrs);
+void raid6_neon4_gen_syndrome_real(int disks, unsigned long bytes,
+				   void **ptrs);
+void raid6_neon8_gen_syndrome_real(int disks, unsigned long bytes,
+				   void **ptrs);
+
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q,
+			      uint8_t *dp, uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul);
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q,
+			      uint8_t *dq, const uint8_t *qmul);
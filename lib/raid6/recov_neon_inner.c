@@ -0,0 +1,107 @@
+/*
+ * raid6/recov_neon_inner.c
+ *
+ * Inner loops of the NEON RAID-6 recovery, see recov_neon.c.  A GF(2^8)
+ * multiplication by a constant c is two 16 entry table lookups, one for
+ * each nibble of the other factor, in the raid6_vgfmul[c] products:
+ *
+ *	c * x = raid6_vgfmul[c][x & 15] ^ raid6_vgfmul[c][16 + (x >> 4)]
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+#include "neon.h"
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+struct gf_table {
+	uint8x8x2_t lo;		/* products of the low nibble */
+	uint8x8x2_t hi;		/* products of the high nibble */
+};
+
+static inline void gf_table_load(struct gf_table *t, const uint8_t *mul)
+{
+	t->lo.val[0] = vld1_u8(mul);
+	t->lo.val[1] = vld1_u8(mul + 8);
+	t->hi.val[0] = vld1_u8(mul + 16);
+	t->hi.val[1] = vld1_u8(mul + 24);
+}
+
+/* ARMv7 has no 128-bit table lookup, vtbl.8 takes 8 indices at a time */
+static inline uint8x16_t gf_lookup(uint8x8x2_t tbl, uint8x16_t idx)
+{
+	return vcombine_u8(vtbl2_u8(tbl, vget_low_u8(idx)),
+			   vtbl2_u8(tbl, vget_high_u8(idx)));
+}
+
+static inline uint8x16_t gf_mul(const struct gf_table *t, uint8x16_t x)
+{
+	uint8x16_t lo = vandq_u8(x, vdupq_n_u8(0x0f));
+	uint8x16_t hi = vshrq_n_u8(x, 4);
+
+	return veorq_u8(gf_lookup(t->lo, lo), gf_lookup(t->hi, hi));
+}
+
+/*
+ * The recov.c loop, 16 bytes at a time:
+ *
+ *	px    = *p ^ *dp;
+ *	qx    = qmul[*q ^ *dq];
+ *	*dq++ = db = pbmul[px] ^ qx;
+ *	*dp++ = db ^ px;
+ */
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q,
+			      uint8_t *dp, uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul)
+{
+	struct gf_table pm, qm;
+	uint8x16_t px, qx, db;
+
+	gf_table_load(&pm, pbmul);
+	gf_table_load(&qm, qmul);
+
+	for (; bytes > 0; bytes -= 16) {
+		px = veorq_u8(vld1q_u8(p), vld1q_u8(dp));
+		qx = gf_mul(&qm, veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+		db = veorq_u8(gf_mul(&pm, px), qx);
+
+		vst1q_u8(dq, db);
+		vst1q_u8(dp, veorq_u8(db, px));
+
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+}
+
+/*
+ * The recov.c loop, 16 bytes at a time:
+ *
+ *	*p++ ^= *dq = qmul[*q ^ *dq];
+ */
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q,
+			      uint8_t *dq, const uint8_t *qmul)
+{
+	struct gf_table qm;
+	uint8x16_t dx;
+
+	gf_table_load(&qm, qmul);
+
+	for (; bytes > 0; bytes -= 16) {
+		dx = gf_mul(&qm, veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+
+		vst1q_u8(dq, dx);
+		vst1q_u8(p, veorq_u8(vld1q_u8(p), dx));
+
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+}
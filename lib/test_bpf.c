@@ -0,0 +1,683 @@
+/*
+ * Testsuite and microbenchmark for the classic BPF interpreter and JIT.
+ *
+ * Every filter of the corpus below is created with
+ * sk_unattached_filter_create(), which JIT compiles it when the
+ * architecture supports it and net.core.bpf_jit_enable is set, and run
+ * on a test packet both through the JIT (SK_RUN_FILTER) and through the
+ * interpreter (sk_run_filter).  Both must return the expected value.
+ * Each filter is then run repeatedly to report the per-packet cost of
+ * the interpreter and of the JIT.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/filter.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/errno.h>
+
+static unsigned int runs = 100000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Runs of each filter for the timing, 0 to only test");
+
+#define MAX_INSNS	32
+#define MAX_DATA	64
+
+/* Test flags */
+#define FLAG_NO_DEV	0x1	/* run with skb->dev == NULL */
+
+#define SKB_MARK	0x1234aaaa
+#define SKB_QUEUE	17
+#define SKB_RXHASH	0xdeadbeef
+#define SKB_PKT_TYPE	PACKET_OTHERHOST
+#define SKB_DEV_IFINDEX	577
+#define SKB_DEV_TYPE	588
+
+struct bpf_test {
+	const char *descr;
+	struct sock_filter insns[MAX_INSNS];
+	const u8 *data;		/* test_pkt if NULL */
+	unsigned int data_len;
+	unsigned int flags;
+	u32 result;
+};
+
+/* Ethernet, IPv4 192.168.0.1 -> 192.168.0.2, UDP 1234 -> 5678 */
+static const u8 test_pkt[] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x11,
+	0x22, 0x33, 0x44, 0x55, 0x08, 0x00,
+	0x45, 0x00, 0x00, 0x1c, 0x00, 0x00, 0x40, 0x00,
+	0x40, 0x11, 0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01,
+	0xc0, 0xa8, 0x00, 0x02,
+	0x04, 0xd2, 0x16, 0x2e, 0x00, 0x08, 0x00, 0x00,
+};
+
+/* nla_len and nla_type are in host byte order */
+#ifdef __LITTLE_ENDIAN
+#define NLA_HDR(len, type)	(len) & 0xff, (len) >> 8, (type) & 0xff, (type) >> 8
+#else
+#define NLA_HDR(len, type)	(len) >> 8, (len) & 0xff, (type) >> 8, (type) & 0xff
+#endif
+
+/* attributes 1 and 2 at offsets 0 and 8 */
+static const u8 nla_pkt[] = {
+	NLA_HDR(8, 1), 0xaa, 0xaa, 0xaa, 0xaa,
+	NLA_HDR(8, 2), 0xbb, 0xbb, 0xbb, 0xbb,
+};
+
+/* attribute 1 nesting attributes 5 and 6, at offsets 4 and 12 */
+static const u8 nla_nest_pkt[] = {
+	NLA_HDR(20, 1),
+	NLA_HDR(8, 5), 0xaa, 0xaa, 0xaa, 0xaa,
+	NLA_HDR(8, 6), 0xbb, 0xbb, 0xbb, 0xbb,
+};
+
+#define LD_ANC(ad)	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + (ad))
+
+static struct bpf_test tests[] = {
+	{
+		"RET_K",
+		{ BPF_STMT(BPF_RET | BPF_K, 42) },
+		.result = 42,
+	},
+	{
+		"LD_IMM, RET_A",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0x12345678),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x12345678,
+	},
+	{
+		"ALU arithmetic K",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 10),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 5),
+			BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 3),
+			BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 4),
+			BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 3),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 16,
+	},
+	{
+		"ALU arithmetic X",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 3),
+			BPF_STMT(BPF_LD | BPF_IMM, 20),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_ALU | BPF_SUB | BPF_X, 0),
+			BPF_STMT(BPF_ALU | BPF_MUL | BPF_X, 0),
+			BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 20,
+	},
+	{
+		"ALU DIV_X by zero",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 0),
+			BPF_STMT(BPF_LD | BPF_IMM, 5),
+			BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 0,
+	},
+	{
+		"ALU bitwise K",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0xf0f0),
+			BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xff00),
+			BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x0f),
+			BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 4),
+			BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 8),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xf00,
+	},
+	{
+		"ALU bitwise X",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0xff),
+			BPF_STMT(BPF_LDX | BPF_IMM, 4),
+			BPF_STMT(BPF_ALU | BPF_LSH | BPF_X, 0),
+			BPF_STMT(BPF_ALU | BPF_RSH | BPF_X, 0),
+			BPF_STMT(BPF_LDX | BPF_IMM, 0x0f),
+			BPF_STMT(BPF_ALU | BPF_AND | BPF_X, 0),
+			BPF_STMT(BPF_LDX | BPF_IMM, 0x30),
+			BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x3f,
+	},
+	{
+		"ALU NEG",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 1),
+			BPF_STMT(BPF_ALU | BPF_NEG, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xffffffff,
+	},
+	{
+		"TAX, TXA",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 7),
+			BPF_STMT(BPF_MISC | BPF_TAX, 0),
+			BPF_STMT(BPF_LD | BPF_IMM, 0),
+			BPF_STMT(BPF_MISC | BPF_TXA, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 7,
+	},
+	{
+		"ST, STX, LD_MEM, LDX_MEM",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0xabc),
+			BPF_STMT(BPF_ST, 3),
+			BPF_STMT(BPF_LDX | BPF_IMM, 5),
+			BPF_STMT(BPF_STX, 15),
+			BPF_STMT(BPF_LD | BPF_IMM, 0),
+			BPF_STMT(BPF_LDX | BPF_MEM, 3),
+			BPF_STMT(BPF_LD | BPF_MEM, 15),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xabc + 5,
+	},
+	{
+		"LD_LEN, LDX_LEN",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+			BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 2 * sizeof(test_pkt),
+	},
+	{
+		"LD_B_ABS",
+		{
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x11,
+	},
+	{
+		"LD_H_ABS",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x0800,
+	},
+	{
+		"LD_W_ABS",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 26),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xc0a80001,
+	},
+	{
+		"LD_B_IND",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 14),
+			BPF_STMT(BPF_LD | BPF_B | BPF_IND, 9),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x11,
+	},
+	{
+		"LD_H_IND",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 14),
+			BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x001c,
+	},
+	{
+		"LD_W_IND",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 14),
+			BPF_STMT(BPF_LD | BPF_W | BPF_IND, 16),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xc0a80002,
+	},
+	{
+		"LDX_B_MSH",
+		{
+			BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+			BPF_STMT(BPF_LD | BPF_H | BPF_IND, 14),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 1234,
+	},
+	{
+		"LD_B_ABS past the end",
+		{
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, sizeof(test_pkt)),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 0,
+	},
+	{
+		"LD_H_ABS straddling the end",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, sizeof(test_pkt) - 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 0,
+	},
+	{
+		"LD_W_IND straddling the end",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 2),
+			BPF_STMT(BPF_LD | BPF_W | BPF_IND, sizeof(test_pkt) - 4),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 0,
+	},
+	{
+		"LD_B_ABS SKF_NET_OFF",
+		{
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + 9),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x11,
+	},
+	{
+		"LD_H_ABS SKF_LL_OFF",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 12),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x0800,
+	},
+	{
+		"LD_W_ABS SKF_NET_OFF",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 16),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0xc0a80002,
+	},
+	{
+		"LD_B_IND SKF_NET_OFF",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 9),
+			BPF_STMT(BPF_LD | BPF_B | BPF_IND, SKF_NET_OFF),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = 0x11,
+	},
+	{
+		"LD_W_ABS SKF_NET_OFF past the end",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 100),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 0,
+	},
+	{
+		"JMP_JA",
+		{
+			BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JEQ_K",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JGT_K",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 5),
+			BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 4, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JGE_K",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 5),
+			BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 6, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 0,
+	},
+	{
+		"JMP_JSET_K",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0x10),
+			BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x11, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JEQ_X, JMP_JGT_X, JMP_JGE_X, JMP_JSET_X",
+		{
+			BPF_STMT(BPF_LDX | BPF_IMM, 5),
+			BPF_STMT(BPF_LD | BPF_IMM, 5),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 0, 4),
+			BPF_JUMP(BPF_JMP | BPF_JGT | BPF_X, 0, 3, 0),
+			BPF_JUMP(BPF_JMP | BPF_JGE | BPF_X, 0, 0, 2),
+			BPF_JUMP(BPF_JMP | BPF_JSET | BPF_X, 0, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 1,
+	},
+	{
+		"ANC protocol",
+		{
+			LD_ANC(SKF_AD_PROTOCOL),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = ETH_P_IP,
+	},
+	{
+		"ANC pkttype",
+		{
+			LD_ANC(SKF_AD_PKTTYPE),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_PKT_TYPE,
+	},
+	{
+		"ANC ifindex",
+		{
+			LD_ANC(SKF_AD_IFINDEX),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_DEV_IFINDEX,
+	},
+	{
+		"ANC ifindex without device",
+		{
+			LD_ANC(SKF_AD_IFINDEX),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.flags = FLAG_NO_DEV,
+		.result = 0,
+	},
+	{
+		"ANC hatype",
+		{
+			LD_ANC(SKF_AD_HATYPE),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_DEV_TYPE,
+	},
+	{
+		"ANC hatype without device",
+		{
+			LD_ANC(SKF_AD_HATYPE),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.flags = FLAG_NO_DEV,
+		.result = 0,
+	},
+	{
+		"ANC mark",
+		{
+			LD_ANC(SKF_AD_MARK),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_MARK,
+	},
+	{
+		"ANC queue",
+		{
+			LD_ANC(SKF_AD_QUEUE),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_QUEUE,
+	},
+	{
+		"ANC rxhash",
+		{
+			LD_ANC(SKF_AD_RXHASH),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.result = SKB_RXHASH,
+	},
+	{
+		"ANC cpu",
+		{
+			LD_ANC(SKF_AD_CPU),
+			BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, NR_CPUS, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.result = 1,
+	},
+	{
+		"ANC nlattr",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0),
+			BPF_STMT(BPF_LDX | BPF_IMM, 2),
+			LD_ANC(SKF_AD_NLATTR),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.data = nla_pkt,
+		.data_len = sizeof(nla_pkt),
+		.result = 8,
+	},
+	{
+		"ANC nlattr not found",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0),
+			BPF_STMT(BPF_LDX | BPF_IMM, 3),
+			LD_ANC(SKF_AD_NLATTR),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 1),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.data = nla_pkt,
+		.data_len = sizeof(nla_pkt),
+		.result = 1,
+	},
+	{
+		"ANC nlattr_nest",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 0),
+			BPF_STMT(BPF_LDX | BPF_IMM, 6),
+			LD_ANC(SKF_AD_NLATTR_NEST),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		.data = nla_nest_pkt,
+		.data_len = sizeof(nla_nest_pkt),
+		.result = 12,
+	},
+	{
+		"ANC nlattr_nest out of bounds",
+		{
+			BPF_STMT(BPF_LD | BPF_IMM, 4),
+			BPF_STMT(BPF_LDX | BPF_IMM, 6),
+			LD_ANC(SKF_AD_NLATTR_NEST),
+			BPF_STMT(BPF_RET | BPF_K, 1),
+		},
+		.data = nla_pkt,
+		.data_len = sizeof(nla_pkt),
+		.result = 0,
+	},
+	{
+		/* tcpdump -dd 'ip and udp dst port 5678' */
+		"ip and udp dst port 5678",
+		{
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 8),
+			BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 17, 0, 6),
+			BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+			BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 4, 0),
+			BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+			BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+			BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 5678, 0, 1),
+			BPF_STMT(BPF_RET | BPF_K, 0xffff),
+			BPF_STMT(BPF_RET | BPF_K, 0),
+		},
+		.result = 0xffff,
+	},
+};
+
+static struct net_device dev;
+
+static unsigned int filter_length(const struct sock_filter *insns)
+{
+	int len;
+
+	for (len = MAX_INSNS - 1; len > 0; len--)
+		if (insns[len].code || insns[len].k)
+			break;
+	return len + 1;
+}
+
+static struct sk_buff *populate_skb(const struct bpf_test *t)
+{
+	const u8 *data = t->data ? t->data : test_pkt;
+	unsigned int len = t->data ? t->data_len : sizeof(test_pkt);
+	struct sk_buff *skb;
+
+	skb = alloc_skb(MAX_DATA, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, len), data, len);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+
+	skb->protocol = htons(ETH_P_IP);
+	skb->pkt_type = SKB_PKT_TYPE;
+	skb->mark = SKB_MARK;
+	skb->queue_mapping = SKB_QUEUE;
+	skb->rxhash = SKB_RXHASH;
+	if (!(t->flags & FLAG_NO_DEV))
+		skb->dev = &dev;
+
+	return skb;
+}
+
+static u64 time_filter(const struct sk_filter *fp, const struct sk_buff *skb,
+		       bool jit)
+{
+	ktime_t start;
+	unsigned int i;
+	u64 ns;
+
+	preempt_disable();
+	start = ktime_get();
+	if (jit) {
+		for (i = 0; i < runs; i++)
+			SK_RUN_FILTER(fp, skb);
+	} else {
+		for (i = 0; i < runs; i++)
+			sk_run_filter(skb, fp->insns);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	preempt_enable();
+
+	return div_u64(ns, runs);
+}
+
+static int run_test(const struct bpf_test *t)
+{
+	struct sock_fprog fprog;
+	struct sk_filter *fp;
+	struct sk_buff *skb;
+	unsigned int ret_interp, ret_jit;
+	bool jited;
+	int err;
+
+	fprog.len = filter_length(t->insns);
+	fprog.filter = (__force struct sock_filter __user *)t->insns;
+
+	err = sk_unattached_filter_create(&fp, &fprog);
+	if (err) {
+		pr_err("%s: filter rejected: %d\n", t->descr, err);
+		return err;
+	}
+	jited = fp->bpf_func != sk_run_filter;
+
+	skb = populate_skb(t);
+	if (!skb) {
+		sk_unattached_filter_destroy(fp);
+		return -ENOMEM;
+	}
+
+	ret_interp = sk_run_filter(skb, fp->insns);
+	ret_jit = SK_RUN_FILTER(fp, skb);
+
+	if (ret_interp != t->result || ret_jit != t->result) {
+		pr_err("%s: FAIL: expected %u, interpreter %u, %s %u\n",
+		       t->descr, t->result, ret_interp,
+		       jited ? "jit" : "no jit", ret_jit);
+		err = -EINVAL;
+	} else if (runs && jited) {
+		pr_info("%s: interpreter %llu ns, jit %llu ns\n", t->descr,
+			time_filter(fp, skb, false), time_filter(fp, skb, true));
+	} else if (runs) {
+		pr_info("%s: interpreter %llu ns, not jited\n", t->descr,
+			time_filter(fp, skb, false));
+	}
+
+	kfree_skb(skb);
+	sk_unattached_filter_destroy(fp);
+	return err;
+}
+
+static int __init test_bpf_init(void)
+{
+	unsigned int i, failed = 0;
+
+	dev.ifindex = SKB_DEV_IFINDEX;
+	dev.type = SKB_DEV_TYPE;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++)
+		if (run_test(&tests[i]))
+			failed++;
+
+	if (failed) {
+		pr_err("%u of %zu tests failed\n", failed, ARRAY_SIZE(tests));
+		return -EINVAL;
+	}
+	pr_info("all %zu tests passed\n", ARRAY_SIZE(tests));
+	return 0;
+}
+
+static void __exit test_bpf_exit(void)
+{
+}
+
+module_init(test_bpf_init);
+module_exit(test_bpf_exit);
+
+MODULE_DESCRIPTION("Classic BPF interpreter and JIT tests");
+MODULE_LICENSE("GPL");
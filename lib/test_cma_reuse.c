@@ -0,0 +1,137 @@
+/*
+ * Benchmark for contiguous allocations from reusable CMA regions.
+ *
+ * The module first fills memory with movable page cache pages from a
+ * shmem file, so that the page allocator puts some of them into the
+ * MIGRATE_CMA pageblocks of the reusable regions.  It then allocates and
+ * frees a chunk from the given regions a number of times, each of which
+ * has to migrate those pages away, and reports the success rate and the
+ * allocation latency.  In QEMU, reserve a reusable region on the command
+ * line and pass its name in regions=.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2.  See the file COPYING for more details.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cma.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/shmem_fs.h>
+#include <linux/vmstat.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/errno.h>
+
+static char *regions = "ion";
+module_param(regions, charp, 0444);
+MODULE_PARM_DESC(regions, "CMA regions to allocate from");
+
+static unsigned int size_kb = 4096;
+module_param(size_kb, uint, 0444);
+MODULE_PARM_DESC(size_kb, "Size of each contiguous allocation in KiB");
+
+static unsigned int runs = 20;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Number of allocations to time");
+
+static unsigned int fill_mb;
+module_param(fill_mb, uint, 0444);
+MODULE_PARM_DESC(fill_mb,
+		 "Movable page cache to allocate first in MiB, 0 for the regions' size");
+
+/* Read pages of a shmem file into the page cache, they stay there */
+static struct file *fill_movable(unsigned long pages)
+{
+	struct file *file;
+	struct page *page;
+	unsigned long i;
+
+	file = shmem_file_setup("test_cma_reuse", (loff_t)pages << PAGE_SHIFT,
+				0);
+	if (IS_ERR(file))
+		return file;
+
+	for (i = 0; i < pages; i++) {
+		page = shmem_read_mapping_page(file->f_mapping, i);
+		if (IS_ERR(page)) {
+			pr_info("filled %lu of %lu pages\n", i, pages);
+			break;
+		}
+		page_cache_release(page);
+	}
+
+	return file;
+}
+
+static int __init test_cma_reuse_init(void)
+{
+	size_t size = (size_t)size_kb << 10;
+	unsigned long free_cma, used_cma;
+	u64 ns, total = 0, fastest = U64_MAX, slowest = 0;
+	unsigned int i, ok = 0;
+	struct cma_info info;
+	struct file *file;
+	dma_addr_t addr;
+	ktime_t start;
+	int err;
+
+	err = cma_info_about(&info, regions);
+	if (err || !info.count) {
+		pr_err("no CMA region \"%s\"\n", regions);
+		return err ?: -ENODEV;
+	}
+
+	free_cma = global_page_state(NR_FREE_CMA_PAGES);
+	file = fill_movable(fill_mb ? (unsigned long)fill_mb << (20 - PAGE_SHIFT)
+				    : info.total_size >> PAGE_SHIFT);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	used_cma = free_cma - min(free_cma,
+				  global_page_state(NR_FREE_CMA_PAGES));
+	pr_info("%s: %zu KiB in %u regions, %lu CMA pages taken by page cache\n",
+		regions, info.total_size >> 10, info.count, used_cma);
+
+	for (i = 0; i < runs; i++) {
+		start = ktime_get();
+		addr = cma_alloc_from(regions, size, 0);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (IS_ERR_VALUE(addr))
+			continue;
+		cma_free(addr);
+
+		ok++;
+		total += ns;
+		fastest = min(fastest, ns);
+		slowest = max(slowest, ns);
+	}
+
+	fput(file);
+
+	pr_info("%u of %u allocations of %u KiB succeeded\n", ok, runs,
+		size_kb);
+	if (ok)
+		pr_info("latency: min %llu us, avg %llu us, max %llu us\n",
+			div_u64(fastest, NSEC_PER_USEC),
+			div_u64(div_u64(total, ok), NSEC_PER_USEC),
+			div_u64(slowest, NSEC_PER_USEC));
+
+	return ok ? 0 : -ENOMEM;
+}
+
+static void __exit test_cma_reuse_exit(void)
+{
+}
+
+module_init(test_cma_reuse_init);
+module_exit(test_cma_reuse_exit);
+
+MODULE_DESCRIPTION("Reusable CMA region allocation benchmark");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,278 @@
+/*
+ * Testsuite and microbenchmark for the NEON LZ4 and LZO decompressors.
+ *
+ * Every sample below, the strings of the crypto testmgr vectors and page
+ * sized snapshots of kernel text, kernel data, zeroes, a repeating pattern
+ * and random bytes, is compressed with lz4_compress() and
+ * lzo1x_1_compress() and decompressed by the C and by the NEON version of
+ * the safe decompressor.  Both must agree on the return value, on the
+ * output length and, for intact input, on every byte, and must not write
+ * past the end of the output buffer.  The same is checked for truncated
+ * input and for an output buffer that is too small.  Each sample is then
+ * decompressed repeatedly to report the cost of both versions.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/lz4.h>
+#include <linux/lzo.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/errno.h>
+#include <asm/neon.h>
+
+static unsigned int runs = 1000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Runs of each sample for the timing, 0 to only test");
+
+/* Bytes after the output buffer that must come back untouched */
+#define GUARD_LEN	64
+#define GUARD_BYTE	0xa5
+
+struct lz_alg {
+	const char *name;
+	size_t (*bound)(size_t len);
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+	int (*decompress[2])(const unsigned char *src, size_t src_len,
+			     unsigned char *dst, size_t *dst_len);
+};
+
+static size_t lzo_bound(size_t len)
+{
+	return lzo1x_worst_compress(len);
+}
+
+static const struct lz_alg algs[] = {
+	{
+		.name		= "lz4",
+		.bound		= lz4_compressbound,
+		.compress	= lz4_compress,
+		.decompress	= { lz4_decompress_unknownoutputsize_generic,
+				    lz4_decompress_unknownoutputsize_neon },
+	}, {
+		.name		= "lzo",
+		.bound		= lzo_bound,
+		.compress	= lzo1x_1_compress,
+		.decompress	= { lzo1x_decompress_safe_generic,
+				    lzo1x_decompress_safe_neon },
+	},
+};
+
+struct sample {
+	const char *name;
+	const void *data;
+	size_t len;
+};
+
+/* Plaintexts of the "lzo" and "lz4" vectors in crypto/testmgr.h */
+static const char join_us[] =
+	"Join us now and share the software "
+	"Join us now and share the software ";
+static const char ubifs_doc[] =
+	"This document describes a compression method based on the LZO "
+	"compression algorithm.  This document defines the application of "
+	"the LZO algorithm used in UBIFS.";
+
+static int run_decompress(const struct lz_alg *alg, bool neon,
+			  const u8 *src, size_t src_len, u8 *dst, size_t *dst_len)
+{
+	int ret;
+
+	if (!neon)
+		return alg->decompress[0](src, src_len, dst, dst_len);
+
+	kernel_neon_begin();
+	ret = alg->decompress[1](src, src_len, dst, dst_len);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static bool guard_intact(const u8 *buf)
+{
+	unsigned int i;
+
+	for (i = 0; i < GUARD_LEN; i++)
+		if (buf[i] != GUARD_BYTE)
+			return false;
+	return true;
+}
+
+/*
+ * Decompress src_len bytes of compressed data into a cap byte buffer with
+ * both versions.  Output bytes are only compared for intact input: on a
+ * corrupted stream the result may depend on stale bytes of the buffer,
+ * which the two versions' copy loops leave behind differently.
+ */
+static int compare(const struct lz_alg *alg, const struct sample *s,
+		   const char *how, const u8 *src, size_t src_len, size_t cap,
+		   u8 *out[2], bool intact)
+{
+	size_t len[2];
+	int ret[2], i;
+
+	for (i = 0; i < 2; i++) {
+		memset(out[i], GUARD_BYTE, cap + GUARD_LEN);
+		len[i] = cap;
+		ret[i] = run_decompress(alg, i, src, src_len, out[i], &len[i]);
+	}
+
+	if (ret[0] != ret[1] || len[0] != len[1]) {
+		pr_err("%s %s %s: FAIL: C %d/%zu bytes, NEON %d/%zu bytes\n",
+		       alg->name, s->name, how, ret[0], len[0], ret[1], len[1]);
+		return -EINVAL;
+	}
+	if (!guard_intact(out[0] + cap) || !guard_intact(out[1] + cap)) {
+		pr_err("%s %s %s: FAIL: wrote past the output buffer\n",
+		       alg->name, s->name, how);
+		return -EINVAL;
+	}
+	if (intact && !ret[0] && memcmp(out[0], out[1], len[0])) {
+		pr_err("%s %s %s: FAIL: C and NEON output differ\n",
+		       alg->name, s->name, how);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static u64 time_decompress(const struct lz_alg *alg, bool neon,
+			   const u8 *src, size_t src_len, u8 *dst, size_t cap)
+{
+	unsigned int i;
+	size_t len;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < runs; i++) {
+		len = cap;
+		run_decompress(alg, neon, src, src_len, dst, &len);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return div_u64(ns, runs);
+}
+
+static int run_test(const struct lz_alg *alg, const struct sample *s,
+		    u8 *comp, u8 *out[2], void *wrkmem)
+{
+	size_t clen = alg->bound(s->len);
+	int err;
+
+	if (alg->compress(s->data, s->len, comp, &clen, wrkmem)) {
+		pr_err("%s %s: compression failed\n", alg->name, s->name);
+		return -EINVAL;
+	}
+
+	err = compare(alg, s, "intact", comp, clen, s->len, out, true);
+	if (err)
+		return err;
+	if (memcmp(out[0], s->data, s->len)) {
+		pr_err("%s %s: FAIL: output differs from the sample\n",
+		       alg->name, s->name);
+		return -EINVAL;
+	}
+
+	err = compare(alg, s, "truncated", comp, clen / 2, s->len, out, true) ?:
+	      compare(alg, s, "short output", comp, clen, s->len / 2, out,
+		      true);
+	if (err)
+		return err;
+
+	/* One flipped bit must not let either version run off the buffer */
+	comp[clen / 3] ^= 0x10;
+	err = compare(alg, s, "corrupted", comp, clen, s->len, out, false);
+	comp[clen / 3] ^= 0x10;
+	if (err)
+		return err;
+
+	if (runs)
+		pr_info("%s %s: %zu -> %zu bytes, C %llu ns, NEON %llu ns\n",
+			alg->name, s->name, s->len, clen,
+			time_decompress(alg, false, comp, clen, out[0], s->len),
+			time_decompress(alg, true, comp, clen, out[1], s->len));
+	return 0;
+}
+
+static int __init test_decompress_neon_init(void)
+{
+	struct sample samples[] = {
+		{ "testmgr join-us", join_us, sizeof(join_us) - 1 },
+		{ "testmgr ubifs", ubifs_doc, sizeof(ubifs_doc) - 1 },
+		{ "kernel text" },
+		{ "kernel data" },
+		{ "zero page" },
+		{ "pattern page" },
+		{ "random page" },
+	};
+	unsigned int i, j, tests = 0, failed = 0;
+	u8 *pages, *comp, *out[2];
+	void *wrkmem;
+	int err = -ENOMEM;
+
+	if (!cpu_has_neon()) {
+		pr_info("no NEON, nothing to test\n");
+		return -ENODEV;
+	}
+
+	pages = vmalloc(5 * PAGE_SIZE);
+	comp = vmalloc(max_t(size_t, lzo1x_worst_compress(PAGE_SIZE),
+			     lz4_compressbound(PAGE_SIZE)));
+	out[0] = vmalloc(PAGE_SIZE + GUARD_LEN);
+	out[1] = vmalloc(PAGE_SIZE + GUARD_LEN);
+	wrkmem = vmalloc(max_t(size_t, LZ4_MEM_COMPRESS, LZO1X_MEM_COMPRESS));
+	if (!pages || !comp || !out[0] || !out[1] || !wrkmem)
+		goto out;
+
+	/* Snapshots, so that nothing changes while both versions run */
+	memcpy(pages, (void *)((unsigned long)printk & PAGE_MASK), PAGE_SIZE);
+	memcpy(pages + PAGE_SIZE,
+	       (void *)((unsigned long)&jiffies_64 & PAGE_MASK), PAGE_SIZE);
+	memset(pages + 2 * PAGE_SIZE, 0, PAGE_SIZE);
+	for (i = 0; i < PAGE_SIZE; i++)
+		pages[3 * PAGE_SIZE + i] = i % 37 < 20 ? 'a' + i % 7 : i;
+	get_random_bytes(pages + 4 * PAGE_SIZE, PAGE_SIZE);
+
+	for (i = 2; i < ARRAY_SIZE(samples); i++) {
+		samples[i].data = pages + (i - 2) * PAGE_SIZE;
+		samples[i].len = PAGE_SIZE;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(algs); i++)
+		for (j = 0; j < ARRAY_SIZE(samples); j++, tests++)
+			if (run_test(&algs[i], &samples[j], comp, out, wrkmem))
+				failed++;
+
+	if (failed) {
+		pr_err("%u of %u tests failed\n", failed, tests);
+		err = -EINVAL;
+		goto out;
+	}
+	pr_info("all %u tests passed\n", tests);
+	err = 0;
+out:
+	vfree(wrkmem);
+	vfree(out[1]);
+	vfree(out[0]);
+	vfree(comp);
+	vfree(pages);
+	return err;
+}
+
+static void __exit test_decompress_neon_exit(void)
+{
+}
+
+module_init(test_decompress_neon_init);
+module_exit(test_decompress_neon_exit);
+
+MODULE_DESCRIPTION("NEON LZ4 and LZO decompressor tests");
+MODULE_LICENSE("GPL");
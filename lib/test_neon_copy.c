@@ -0,0 +1,226 @@
+/*
+ * Testsuite and microbenchmark for the NEON memcpy(), memset() and
+ * copy_page() of CONFIG_ARM_NEON_COPY.
+ *
+ * Every size below is copied and filled at a few source and destination
+ * misalignments through the kernel's memcpy() and memset(), which take
+ * the NEON path from the configured threshold on, and the result is
+ * checked byte for byte, including the guard bytes around it.  Each size
+ * is then timed against the integer versions, __memcpy_std() and
+ * __memset_std(), and the gain is reported.  Boot with a low neon_copy=
+ * threshold to see the NEON cost of the smaller sizes too.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/errno.h>
+
+static unsigned int runs = 1000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Runs of each size for the timing, 0 to only test");
+
+#define GUARD_LEN	64
+#define GUARD_BYTE	0xa5
+#define MAX_SIZE	(64 * 1024)
+
+static const size_t sizes[] = {
+	64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 65536,
+	/* odd sizes, for the head and tail handling */
+	1000, 4097, 12345,
+};
+
+static const unsigned int misalign[][2] = {
+	/* source, destination */
+	{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 3, 7 }, { 8, 8 }, { 13, 5 },
+};
+
+static u8 *src_buf, *dst_buf;
+
+static bool check(const char *what, size_t size, unsigned int soff,
+		  unsigned int doff, const u8 *expect, int fill)
+{
+	const u8 *d = dst_buf + GUARD_LEN + doff;
+	size_t i;
+
+	for (i = 0; i < GUARD_LEN + doff; i++)
+		if (dst_buf[i] != GUARD_BYTE)
+			goto fail;
+	for (i = 0; i < size; i++)
+		if (d[i] != (expect ? expect[i] : fill))
+			goto fail;
+	for (i = 0; i < GUARD_LEN; i++)
+		if (d[size + i] != GUARD_BYTE)
+			goto fail;
+	return true;
+
+fail:
+	pr_err("%s of %zu bytes, offsets %u/%u: FAIL\n", what, size, soff,
+	       doff);
+	return false;
+}
+
+static int run_test(size_t size)
+{
+	unsigned int i, soff, doff;
+	u8 *d;
+	int failed = 0;
+
+	for (i = 0; i < ARRAY_SIZE(misalign); i++) {
+		soff = misalign[i][0];
+		doff = misalign[i][1];
+		d = dst_buf + GUARD_LEN + doff;
+
+		memset(dst_buf, GUARD_BYTE, 2 * GUARD_LEN + 16 + size);
+		memcpy(d, src_buf + soff, size);
+		if (!check("memcpy", size, soff, doff, src_buf + soff, 0))
+			failed++;
+
+		memset(dst_buf, GUARD_BYTE, 2 * GUARD_LEN + 16 + size);
+		memset(d, 0x3c, size);
+		if (!check("memset", size, 0, doff, NULL, 0x3c))
+			failed++;
+
+		/* a constant zero goes to __memzero() */
+		memset(dst_buf, GUARD_BYTE, 2 * GUARD_LEN + 16 + size);
+		memset(d, 0, size);
+		if (!check("memzero", size, 0, doff, NULL, 0))
+			failed++;
+	}
+
+	return failed ? -EINVAL : 0;
+}
+
+static u64 time_copy(size_t size, bool std)
+{
+	u8 *d = dst_buf + GUARD_LEN;
+	unsigned int i;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < runs; i++) {
+		if (std)
+			__memcpy_std(d, src_buf, size);
+		else
+			memcpy(d, src_buf, size);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return div_u64(ns, runs);
+}
+
+static u64 time_set(size_t size, bool std)
+{
+	u8 *d = dst_buf + GUARD_LEN;
+	unsigned int i;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < runs; i++) {
+		if (std)
+			__memset_std(d, 0x3c, size);
+		else
+			memset(d, 0x3c, size);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return div_u64(ns, runs);
+}
+
+static u64 time_page(bool std)
+{
+	unsigned int i;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < runs; i++) {
+		if (std)
+			__copy_page_std(dst_buf, src_buf);
+		else
+			copy_page(dst_buf, src_buf);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return div_u64(ns, runs);
+}
+
+/* Percent of the integer version's time saved, negative for a loss */
+static int gain(u64 std, u64 neon)
+{
+	return std ? (int)div64_s64(((s64)std - (s64)neon) * 100, std) : 0;
+}
+
+static void report(const char *what, size_t size, u64 std, u64 neon)
+{
+	pr_info("%-9s %6zu bytes: integer %6llu ns, kernel %6llu ns, %d%% gain\n",
+		what, size, std, neon, gain(std, neon));
+}
+
+static int __init test_neon_copy_init(void)
+{
+	unsigned int i, failed = 0;
+	int err = -ENOMEM;
+
+	src_buf = vmalloc(MAX_SIZE + 16);
+	dst_buf = vmalloc(MAX_SIZE + 2 * GUARD_LEN + 16);
+	if (!src_buf || !dst_buf)
+		goto out;
+
+	for (i = 0; i < MAX_SIZE + 16; i++)
+		src_buf[i] = i * 7 + (i >> 8);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		if (run_test(sizes[i]))
+			failed++;
+
+	/* vmalloc() memory is page aligned, as copy_page() wants */
+	copy_page(dst_buf, src_buf);
+	if (memcmp(dst_buf, src_buf, PAGE_SIZE)) {
+		pr_err("copy_page: FAIL\n");
+		failed++;
+	}
+
+	if (failed) {
+		pr_err("%u of %zu tests failed\n", failed,
+		       ARRAY_SIZE(sizes) + 1);
+		err = -EINVAL;
+		goto out;
+	}
+	pr_info("all %zu tests passed\n", ARRAY_SIZE(sizes) + 1);
+
+	if (runs) {
+		for (i = 0; i < ARRAY_SIZE(sizes); i++)
+			report("memcpy", sizes[i], time_copy(sizes[i], true),
+			       time_copy(sizes[i], false));
+		for (i = 0; i < ARRAY_SIZE(sizes); i++)
+			report("memset", sizes[i], time_set(sizes[i], true),
+			       time_set(sizes[i], false));
+		report("copy_page", PAGE_SIZE, time_page(true),
+		       time_page(false));
+	}
+	err = 0;
+out:
+	vfree(dst_buf);
+	vfree(src_buf);
+	return err;
+}
+
+static void __exit test_neon_copy_exit(void)
+{
+}
+
+module_init(test_neon_copy_init);
+module_exit(test_neon_copy_exit);
+
+MODULE_DESCRIPTION("NEON memcpy, memset and copy_page tests");
+MODULE_LICENSE("GPL");
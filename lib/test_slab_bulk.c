@@ -0,0 +1,109 @@
+/*
+ * Cost per object of kmem_cache_alloc_bulk()/kmem_cache_free_bulk() next
+ * to kmem_cache_alloc()/kmem_cache_free() of the same batch, for batches
+ * of 1 to BULK_MAX objects of a private cache.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/errno.h>
+
+#define BULK_MAX	256
+
+static unsigned int loops = 10000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Rounds of allocation and freeing per batch size");
+
+static unsigned int object_size = 256;
+module_param(object_size, uint, 0444);
+MODULE_PARM_DESC(object_size, "Size of the test cache objects");
+
+static const unsigned int bulk_sizes[] = { 1, 2, 4, 8, 16, 32, 64, 128,
+					   BULK_MAX };
+
+static void *objs[BULK_MAX];
+
+static u64 bench_single(struct kmem_cache *s, unsigned int bulk)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < bulk; j++) {
+			objs[j] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[j])
+				goto fail;
+		}
+		for (j = 0; j < bulk; j++)
+			kmem_cache_free(s, objs[j]);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+
+fail:
+	while (j--)
+		kmem_cache_free(s, objs[j]);
+	return 0;
+}
+
+static u64 bench_bulk(struct kmem_cache *s, unsigned int bulk)
+{
+	ktime_t start = ktime_get();
+	unsigned int i;
+
+	for (i = 0; i < loops; i++) {
+		if (!kmem_cache_alloc_bulk(s, GFP_KERNEL, bulk, objs))
+			return 0;
+		kmem_cache_free_bulk(s, bulk, objs);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init slab_bulk_test_init(void)
+{
+	struct kmem_cache *s;
+	unsigned int i, bulk;
+	u64 single_ns, bulk_ns;
+	int ret = 0;
+
+	if (!loops)
+		return -EINVAL;
+
+	s = kmem_cache_create("slab_bulk_test", object_size, 0, 0, NULL);
+	if (!s)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(bulk_sizes); i++) {
+		bulk = bulk_sizes[i];
+
+		single_ns = bench_single(s, bulk);
+		bulk_ns = bench_bulk(s, bulk);
+		if (!single_ns || !bulk_ns) {
+			pr_err("bulk %u: allocation failed\n", bulk);
+			ret = -ENOMEM;
+			break;
+		}
+
+		pr_info("bulk %3u: single %llu ns/obj, bulk %llu ns/obj\n",
+			bulk, div_u64(single_ns, loops * bulk),
+			div_u64(bulk_ns, loops * bulk));
+	}
+
+	kmem_cache_destroy(s);
+	return ret;
+}
+
+static void __exit slab_bulk_test_exit(void)
+{
+}
+
+module_init(slab_bulk_test_init);
+module_exit(slab_bulk_test_exit);
+
+MODULE_DESCRIPTION("Slab bulk allocation microbenchmark");
+MODULE_LICENSE("GPL");
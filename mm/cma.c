@@ -31,6 +31,7 @@
 #include <linux/mm.h>          /* PAGE_ALIGN() */
 #include <linux/module.h>      /* EXPORT_SYMBOL_GPL() */
 #include <linux/mutex.h>       /* mutex */
+#include <linux/pfn.h>         /* PFN_DOWN() */
 #include <linux/slab.h>        /* kmalloc() */
 #include <linux/string.h>      /* str*() */
 
@@ -493,6 +494,12 @@ int __init cma_early_region_reserve(struct cma_region *reg)
 	    reg->reserved)
 		return -EINVAL;
 
+	if (reg->reusable) {
+		reg->alignment = max_t(dma_addr_t, reg->alignment,
+				       CMA_REUSABLE_ALIGN);
+		reg->size = ALIGN(reg->size, CMA_REUSABLE_ALIGN);
+	}
+
 #ifndef CONFIG_NO_BOOTMEM
 
 	tried = 1;
@@ -570,6 +577,45 @@ void __init cma_early_regions_reserve(int (*reserve)(struct cma_region *reg))
 }
 
 
+/*
+ * Give the pages of a reusable region to the page allocator as
+ * MIGRATE_CMA pageblocks.  If that cannot be done the region simply
+ * stays a carveout.
+ */
+static void __init __cma_region_activate(struct cma_region *reg)
+{
+	unsigned long base_pfn = PFN_DOWN(reg->start), pfn = base_pfn;
+	unsigned long end_pfn = base_pfn + PFN_DOWN(reg->size);
+	struct zone *zone;
+
+	if (!IS_ALIGNED(reg->start | reg->size, CMA_REUSABLE_ALIGN)) {
+		pr_warn("init: %s: %p@%p not aligned to %p, not reusable\n",
+			reg->name ?: "(private)", (void *)reg->size,
+			(void *)reg->start, (void *)CMA_REUSABLE_ALIGN);
+		goto err;
+	}
+
+	/* All pageblocks must be valid and in a single zone. */
+	zone = page_zone(pfn_to_page(base_pfn));
+	for (; pfn < end_pfn; ++pfn) {
+		if (!pfn_valid(pfn) || page_zone(pfn_to_page(pfn)) != zone) {
+			pr_warn("init: %s: spans several zones, not reusable\n",
+				reg->name ?: "(private)");
+			goto err;
+		}
+	}
+
+	for (pfn = base_pfn; pfn < end_pfn; pfn += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+
+	pr_debug("init: %s: %lu pages given to the page allocator\n",
+		 reg->name ?: "(private)", end_pfn - base_pfn);
+	return;
+
+err:
+	reg->reusable = 0;
+}
+
 static int __init cma_init(void)
 {
 	struct cma_region *reg, *n;
@@ -597,6 +643,10 @@ static int __init cma_init(void)
 		 */
 		if (reg->reserved && cma_region_register(reg) < 0)
 			/* ignore error */;
+		else if (reg->reserved && reg->reusable)
+			__cma_region_activate(reg);
+		else
+			reg->reusable = 0;
 	}
 
 	INIT_LIST_HEAD(&cma_early_regions);
@@ -813,6 +863,12 @@ static ssize_t cma_sysfs_region_users_show(struct cma_region *reg, char *page)
 	return snprintf(page, PAGE_SIZE, "%u\n", reg->users);
 }
 
+static ssize_t
+cma_sysfs_region_reusable_show(struct cma_region *reg, char *page)
+{
+	return snprintf(page, PAGE_SIZE, "%u\n", reg->reusable);
+}
+
 static ssize_t cma_sysfs_region_alloc_show(struct cma_region *reg, char *page)
 {
 	if (reg->alloc)
@@ -903,6 +959,7 @@ static struct kobj_type cma_sysfs_region_type = {
 		CMA_ATTR_RO_INLINE(region, size),
 		CMA_ATTR_RO_INLINE(region, free),
 		CMA_ATTR_RO_INLINE(region, users),
+		CMA_ATTR_RO_INLINE(region, reusable),
 		CMA_ATTR_INLINE(region, alloc),
 		NULL
 	},
@@ -996,6 +1053,10 @@ static void __cma_chunk_free(struct cma_chunk *chunk)
 {
 	rb_erase(&chunk->by_start, &cma_chunks_by_start);
 
+	if (chunk->reg->reusable)
+		free_contig_range(PFN_DOWN(chunk->start),
+				  PFN_DOWN(chunk->size));
+
 	chunk->reg->free_space += chunk->size;
 	--chunk->reg->users;
 
@@ -1011,11 +1072,39 @@ __cma_where_from(const struct device *dev, const char *type);
 
 /* Allocate. */
 
+/*
+ * Number of other places in a reusable region tried when pages of the
+ * chunk the allocator picked first cannot be migrated away.
+ */
+#define CMA_REUSABLE_RETRIES	4
+
+/*
+ * Takes the pages backing a chunk of a reusable region away from the
+ * page allocator, migrating whatever movable pages live there.
+ */
+static int __cma_chunk_claim(struct cma_region *reg, struct cma_chunk *chunk)
+{
+	unsigned long pfn = PFN_DOWN(chunk->start);
+	int ret;
+
+	if (!reg->reusable)
+		return 0;
+
+	ret = alloc_contig_range(pfn, pfn + PFN_DOWN(chunk->size));
+	if (ret)
+		pr_debug("%s: unable to claim %p@%p: %d\n",
+			 reg->name ?: "(private)", (void *)chunk->size,
+			 (void *)chunk->start, ret);
+	return ret;
+}
+
 static dma_addr_t __must_check
 __cma_alloc_from_region(struct cma_region *reg,
 			size_t size, dma_addr_t alignment)
 {
+	struct cma_chunk *busy[CMA_REUSABLE_RETRIES];
 	struct cma_chunk *chunk;
+	unsigned nr_busy = 0;
 
 	pr_debug("allocate %p/%p from %s\n",
 		 (void *)size, (void *)alignment,
@@ -1031,12 +1120,34 @@ __cma_alloc_from_region(struct cma_region *reg,
 			return -ENOMEM;
 	}
 
-	chunk = reg->alloc->alloc(reg, size, alignment);
+	/*
+	 * In a reusable region some page of the chunk may be pinned
+	 * for a while.  Keep such chunks allocated so that the
+	 * allocator picks another place, and give them back at the end.
+	 */
+	for (;;) {
+		chunk = reg->alloc->alloc(reg, size, alignment);
+		if (!chunk || !__cma_chunk_claim(reg, chunk))
+			break;
+		if (nr_busy == ARRAY_SIZE(busy)) {
+			reg->alloc->free(chunk);
+			chunk = NULL;
+			break;
+		}
+		busy[nr_busy++] = chunk;
+	}
+
+	while (nr_busy)
+		reg->alloc->free(busy[--nr_busy]);
+
 	if (!chunk)
 		return -ENOMEM;
 
 	if (unlikely(__cma_chunk_insert(chunk) < 0)) {
 		/* We should *never* be here. */
+		if (reg->reusable)
+			free_contig_range(PFN_DOWN(chunk->start),
+					  PFN_DOWN(chunk->size));
 		chunk->reg->alloc->free(chunk);
 		kfree(chunk);
 		return -EADDRINUSE;
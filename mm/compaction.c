@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -38,6 +40,8 @@ struct compact_control {
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool proactive;			/* Proactive run from kcompactd */
+	unsigned long nr_migrated;	/* Pages successfully migrated */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -105,6 +109,11 @@ static unsigned long isolate_freepages_block(struct zone *zone,
 	return total_isolated;
 }
 
+static inline bool migrate_async_suitable(int migratetype)
+{
+	return is_migrate_cma(migratetype) || migratetype == MIGRATE_MOVABLE;
+}
+
 /* Returns true if the page is within a block suitable for migration to */
 static bool suitable_migration_target(struct page *page)
 {
@@ -119,8 +128,8 @@ static bool suitable_migration_target(struct page *page)
 	if (PageBuddy(page) && page_order(page) >= pageblock_order)
 		return true;
 
-	/* If the block is MIGRATE_MOVABLE, allow migration */
-	if (migratetype == MIGRATE_MOVABLE)
+	/* If the block is MIGRATE_MOVABLE or MIGRATE_CMA, allow migration */
+	if (migrate_async_suitable(migratetype))
 		return true;
 
 	/* Otherwise skip the block */
@@ -351,7 +360,7 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 		 */
 		pageblock_nr = low_pfn >> pageblock_order;
 		if (!cc->sync && last_pageblock_nr != pageblock_nr &&
-				get_pageblock_migratetype(page) != MIGRATE_MOVABLE) {
+		    !migrate_async_suitable(get_pageblock_migratetype(page))) {
 			low_pfn += pageblock_nr_pages;
 			low_pfn = ALIGN(low_pfn, pageblock_nr_pages) - 1;
 			last_pageblock_nr = pageblock_nr;
@@ -449,6 +458,91 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+/*
+ * Proactive compaction.
+ *
+ * Direct compaction only starts once a high-order allocation has already
+ * failed, so after long uptimes large allocations such as camera and ION
+ * buffers stall in it.  kcompactd is woken by kswapd when it goes back to
+ * sleep and by allocations entering direct compaction, and compacts the
+ * zones of its node whose free memory is too fragmented for allocations of
+ * sysctl_compaction_proactive_order.  It only works while the system is
+ * idle, checking back twice a second until then, and backs off from a
+ * zone in which a pass makes no progress.
+ *
+ * sysctl_compaction_proactiveness (0 to disable, up to 100) sets the
+ * target: compaction starts when more than (100 - proactiveness) + 10
+ * percent of the free memory is in blocks too small for that order, and
+ * stops once it is below 100 - proactiveness percent.
+ */
+int sysctl_compaction_proactiveness = 20;
+int sysctl_compaction_proactive_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+
+#define KCOMPACTD_INTERVAL	(HZ / 2)
+
+/*
+ * Nothing but us is runnable, and the one minute load average is below one
+ * cpu, which kcompactd running alone never pushes it to.
+ */
+static bool kcompactd_system_idle(void)
+{
+	return nr_running() <= 1 && avenrun[0] < FIXED_1;
+}
+
+/*
+ * kcompactd backs off from a zone where it makes no progress like direct
+ * compaction does, but on its own counters: an unproductive background
+ * pass must not defer the allocations it is meant to help.
+ */
+static void kcompactd_defer(struct zone *zone)
+{
+	zone->kcompactd_considered = 0;
+	if (zone->kcompactd_defer_shift < COMPACT_MAX_DEFER_SHIFT)
+		zone->kcompactd_defer_shift++;
+}
+
+static bool kcompactd_deferred(struct zone *zone)
+{
+	unsigned int defer_limit = 1U << zone->kcompactd_defer_shift;
+
+	if (zone->kcompactd_considered < defer_limit)
+		zone->kcompactd_considered++;
+	return zone->kcompactd_considered < defer_limit;
+}
+
+static int kcompactd_wmark(bool high)
+{
+	int wmark = max(100 - sysctl_compaction_proactiveness, 5);
+
+	return high ? min(wmark + 10, 100) : wmark;
+}
+
+/* Percentage of the zone's free memory unusable at the target order */
+static int kcompactd_zone_score(struct zone *zone)
+{
+	return extfrag_for_order(zone, sysctl_compaction_proactive_order) / 10;
+}
+
+static bool kcompactd_zone_done(struct zone *zone)
+{
+	return fatal_signal_pending(current) || kthread_should_stop() ||
+		!kcompactd_system_idle() ||
+		kcompactd_zone_score(zone) <= kcompactd_wmark(false);
+}
+
+static bool kcompactd_zone_needed(struct zone *zone)
+{
+	int order = sysctl_compaction_proactive_order;
+	unsigned long watermark;
+
+	/* Too little free memory to migrate into is a job for reclaim */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	return kcompactd_zone_score(zone) > kcompactd_wmark(true);
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -462,6 +556,10 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	if (cc->proactive)
+		return kcompactd_zone_done(zone) ? COMPACT_PARTIAL :
+						   COMPACT_CONTINUE;
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -583,6 +681,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
+		cc->nr_migrated += nr_migrate - nr_remaining;
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
 		if (nr_remaining)
@@ -747,6 +846,170 @@ static void compact_nodes(void)
 		compact_node(nid);
 }
 
+static bool kcompactd_node_needed(pg_data_t *pgdat)
+{
+	struct zone *zone;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (populated_zone(zone) && kcompactd_zone_needed(zone))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Returns true if some zone still needs compacting but the system was too
+ * busy, so that kcompactd looks again after KCOMPACTD_INTERVAL.
+ */
+static bool kcompactd_do_work(pg_data_t *pgdat)
+{
+	struct compact_control cc = {
+		.order = -1,
+		.sync = true,
+		.proactive = true,
+	};
+	unsigned long start = jiffies;
+	unsigned long nr_migrated;
+	struct zone *zone;
+	int zoneid;
+
+	if (!sysctl_compaction_proactiveness)
+		return false;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone) || !kcompactd_zone_needed(zone))
+			continue;
+		if (kthread_should_stop())
+			break;
+		if (!kcompactd_system_idle())
+			return true;
+		if (kcompactd_deferred(zone))
+			continue;
+
+		cc.nr_freepages = 0;
+		cc.nr_migratepages = 0;
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		count_vm_event(KCOMPACTD_WAKE);
+		nr_migrated = cc.nr_migrated;
+		compact_zone(zone, &cc);
+
+		/* Migrating nothing, another pass soon would not do better */
+		if (cc.nr_migrated == nr_migrated)
+			kcompactd_defer(zone);
+		else
+			zone->kcompactd_defer_shift = 0;
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+
+	if (cc.nr_migrated) {
+		count_vm_events(KCOMPACTD_MIGRATED, cc.nr_migrated);
+		count_vm_events(KCOMPACTD_MSECS,
+				jiffies_to_msecs(jiffies - start));
+	}
+	return false;
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return kthread_should_stop() || pgdat->kcompactd_requested;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	bool busy = false;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		if (busy)
+			wait_event_freezable_timeout(pgdat->kcompactd_wait,
+					kcompactd_work_requested(pgdat),
+					KCOMPACTD_INTERVAL);
+		else
+			wait_event_freezable(pgdat->kcompactd_wait,
+					kcompactd_work_requested(pgdat));
+		pgdat->kcompactd_requested = false;
+		if (kthread_should_stop())
+			break;
+		busy = kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+/*
+ * Called by kswapd when the node is balanced and it goes to sleep, and by
+ * allocations about to compact directly: kick kcompactd if some zone of the
+ * node is too fragmented for sysctl_compaction_proactive_order.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat)
+{
+	if (!sysctl_compaction_proactiveness)
+		return;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_needed(pgdat))
+		return;
+
+	pgdat->kcompactd_requested = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * Start the kcompactd thread of a node.  Called at boot and when memory
+ * is onlined, under lock_memory_hotplug() in the latter case.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+/* Called with lock_memory_hotplug() held, when a node goes offline */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init);
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
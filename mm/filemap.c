@@ -1630,14 +1630,20 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-#if CONFIG_MMAP_READAROUND_LIMIT == 0
-	ra_pages = max_sane_readahead(ra->ra_pages);
-#else
-	if (ra->ra_pages > CONFIG_MMAP_READAROUND_LIMIT)
-		ra_pages = max_sane_readahead(CONFIG_MMAP_READAROUND_LIMIT);
-	else
-		ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = ra_adaptive_pages(ra);
+#if CONFIG_MMAP_READAROUND_LIMIT != 0
+	if (ra_pages > CONFIG_MMAP_READAROUND_LIMIT)
+		ra_pages = CONFIG_MMAP_READAROUND_LIMIT;
 #endif
+	ra_pages = max_sane_readahead(ra_pages);
+
+	/*
+	 * The previous window was used as far as faults found its pages
+	 * in the cache.
+	 */
+	ra_retire_window(ra, mapping, ra->mmap_hit);
+	ra->mmap_hit = 1;
+
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
 	ra->async_size = ra_pages / 4;
@@ -1661,6 +1667,8 @@ static void do_async_mmap_readahead(struct vm_area_struct *vma,
 		return;
 	if (ra->mmap_miss > 0)
 		ra->mmap_miss--;
+	if (ra_has_index(ra, offset))
+		ra->mmap_hit++;
 	if (PageReadahead(page))
 		page_cache_async_readahead(mapping, ra, file,
 					   page, offset, ra->ra_pages);
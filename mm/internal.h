@@ -361,3 +361,19 @@ static inline int swap_cache_skip_readahead(struct vm_area_struct *vma)
 	return 0;
 }
 #endif	/* CONFIG_ZSWAP */
+
+#ifdef CONFIG_BATCHED_UNMAP_TLB_FLUSH
+void try_to_unmap_flush(void);
+void try_to_unmap_flush_dirty(void);
+void flush_tlb_batched_pending(struct mm_struct *mm);
+#else
+static inline void try_to_unmap_flush(void)
+{
+}
+static inline void try_to_unmap_flush_dirty(void)
+{
+}
+static inline void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+}
+#endif /* CONFIG_BATCHED_UNMAP_TLB_FLUSH */
@@ -3688,20 +3688,16 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
  * *And* this routine doesn't reclaim page itself, just removes page_cgroup.
  */
 static int mem_cgroup_force_empty_list(struct mem_cgroup *memcg,
-				int node, int zid, enum lru_list lru)
+				int node, int zid, struct list_head *list,
+				unsigned long loop)
 {
-	struct mem_cgroup_per_zone *mz;
-	unsigned long flags, loop;
-	struct list_head *list;
+	unsigned long flags;
 	struct page *busy;
 	struct zone *zone;
 	int ret = 0;
 
 	zone = &NODE_DATA(node)->node_zones[zid];
-	mz = mem_cgroup_zoneinfo(memcg, node, zid);
-	list = &mz->lruvec.lists[lru];
 
-	loop = mz->lru_size[lru];
 	/* give some margin against EBUSY etc...*/
 	loop += 256;
 	busy = NULL;
@@ -3743,6 +3739,36 @@ static int mem_cgroup_force_empty_list(struct mem_cgroup *memcg,
 	return ret;
 }
 
+static int mem_cgroup_force_empty_lru(struct mem_cgroup *memcg,
+				int node, int zid, enum lru_list lru)
+{
+	struct mem_cgroup_per_zone *mz;
+
+	mz = mem_cgroup_zoneinfo(memcg, node, zid);
+#ifdef CONFIG_LRU_GEN
+	/*
+	 * The multi-generation LRU links active and inactive pages of
+	 * a type on the same generation lists: empty them all at once.
+	 */
+	if (lru_gen_enabled() && !is_unevictable_lru(lru)) {
+		unsigned long nr;
+		int gen, ret = 0;
+
+		if (is_active_lru(lru))
+			return 0;
+		nr = mz->lru_size[lru] + mz->lru_size[lru + LRU_ACTIVE];
+		for (gen = 0; !ret && gen < MAX_NR_GENS; gen++)
+			ret = mem_cgroup_force_empty_list(memcg, node, zid,
+				&mz->lruvec.lrugen.lists[gen][is_file_lru(lru)],
+				nr);
+		return ret;
+	}
+#endif
+	return mem_cgroup_force_empty_list(memcg, node, zid,
+					   &mz->lruvec.lists[lru],
+					   mz->lru_size[lru]);
+}
+
 /*
  * make mem_cgroup's charge to be 0 if there is no task.
  * This enables deleting this mem_cgroup.
@@ -3777,7 +3803,7 @@ move_account:
 			for (zid = 0; !ret && zid < MAX_NR_ZONES; zid++) {
 				enum lru_list lru;
 				for_each_lru(lru) {
-					ret = mem_cgroup_force_empty_list(memcg,
+					ret = mem_cgroup_force_empty_lru(memcg,
 							node, zid, lru);
 					if (ret)
 						break;
@@ -4838,6 +4864,7 @@ static int alloc_mem_cgroup_per_zone_info(struct mem_cgroup *memcg, int node)
 		mz = &pn->zoneinfo[zone];
 		for_each_lru(lru)
 			INIT_LIST_HEAD(&mz->lruvec.lists[lru]);
+		lru_gen_init_lruvec(&mz->lruvec);
 		mz->usage_in_excess = 0;
 		mz->on_tree = false;
 		mz->memcg = memcg;
@@ -58,6 +58,8 @@
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
 #include <linux/page-debug-flags.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -579,7 +581,8 @@ static inline void __free_one_page(struct page *page,
 		if (page_is_guard(buddy)) {
 			clear_page_guard_flag(buddy);
 			set_page_private(page, 0);
-			__mod_zone_page_state(zone, NR_FREE_PAGES, 1 << order);
+			__mod_zone_freepage_state(zone, 1 << order,
+						  migratetype);
 		} else {
 			list_del(&buddy->lru);
 			zone->free_area[order].nr_free--;
@@ -655,12 +658,13 @@ static inline int free_pages_check(struct page *page)
  * And clear the zone's pages_scanned counter, to hold off the "all pages are
  * pinned" detection logic.
  */
-static void free_pcppages_bulk(struct zone *zone, int count,
-					struct per_cpu_pages *pcp)
+static int __free_pcppages_bulk(struct zone *zone, int count, int nr,
+				struct list_head *lists, unsigned int order)
 {
 	int migratetype = 0;
 	int batch_free = 0;
-	int to_free = count;
+	int to_free;
+	int nr_cma = 0;
 
 	spin_lock(&zone->lock);
 	zone->all_unreclaimable = 0;
@@ -670,7 +674,8 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	 * Ensure proper count is passed which otherwise would stuck in the
 	 * below while (list_empty(list)) loop.
 	 */
-	count = min(pcp->count, count);
+	count = min(nr, count);
+	to_free = count;
 	while (to_free) {
 		struct page *page;
 		struct list_head *list;
@@ -686,7 +691,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			batch_free++;
 			if (++migratetype == MIGRATE_PCPTYPES)
 				migratetype = 0;
-			list = &pcp->lists[migratetype];
+			list = &lists[migratetype];
 		} while (list_empty(list));
 
 		/* This is the only non-empty list. Free them all. */
@@ -694,18 +699,151 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			batch_free = to_free;
 
 		do {
+			int mt;
+
 			page = list_entry(list->prev, struct page, lru);
 			/* must delete as __free_one_page list manipulates */
 			list_del(&page->lru);
-			/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
-			__free_one_page(page, zone, 0, page_private(page));
-			trace_mm_page_pcpu_drain(page, 0, page_private(page));
+			/*
+			 * MIGRATE_MOVABLE list may include MIGRATE_RESERVEs
+			 * and MIGRATE_CMA pages.  A CMA pageblock may have
+			 * been isolated by alloc_contig_range() while the
+			 * page sat on the pcp list; keep it off the CMA
+			 * free list in that case.
+			 */
+			mt = page_private(page);
+			if (is_migrate_cma(mt)) {
+				if (get_pageblock_migratetype(page) ==
+							MIGRATE_ISOLATE)
+					mt = MIGRATE_ISOLATE;
+				else
+					nr_cma++;
+			}
+			__free_one_page(page, zone, order, mt);
+			trace_mm_page_pcpu_drain(page, order, mt);
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
-	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count << order);
+	if (nr_cma)
+		__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, nr_cma << order);
 	spin_unlock(&zone->lock);
+
+	return count;
+}
+
+static void free_pcppages_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	__free_pcppages_bulk(zone, count, pcp->count, pcp->lists, 0);
+}
+
+#if PCP_HIGH_ORDER > 0
+static inline struct per_cpu_order_pages *
+pcp_order(struct per_cpu_pages *pcp, unsigned int order)
+{
+	return &pcp->orders[order - 1];
+}
+
+/* Free all high order blocks on the pcp lists, with interrupts disabled */
+static void drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	struct per_cpu_order_pages *pcpo;
+	unsigned int order;
+
+	for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+		pcpo = pcp_order(pcp, order);
+		if (!pcpo->count)
+			continue;
+		pcpo->count -= __free_pcppages_bulk(zone, pcpo->count,
+					pcpo->count, pcpo->lists, order);
+	}
+}
+
+static bool pcp_has_pages(struct per_cpu_pages *pcp)
+{
+	unsigned int order;
+
+	if (pcp->count)
+		return true;
+	for (order = 1; order <= PCP_HIGH_ORDER; order++)
+		if (pcp_order(pcp, order)->count)
+			return true;
+	return false;
+}
+
+/*
+ * Free a block of order 1 .. PCP_HIGH_ORDER to this cpu's lists.  Called
+ * with interrupts disabled.  Returns false if the block should go to the
+ * buddy allocator instead, which is the case while the zone is short of
+ * free memory: merging blocks back matters more than the lock then.
+ */
+static bool free_pcp_order_page(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_order_pages *pcpo;
+
+	if (order > PCP_HIGH_ORDER)
+		return false;
+	if (unlikely(migratetype == MIGRATE_ISOLATE))
+		return false;
+	if (zone_page_state(zone, NR_FREE_PAGES) < low_wmark_pages(zone))
+		return false;
+
+	/* __free_one_page() would do this for us, the pcp lists must too */
+	if (unlikely(PageCompound(page)) && destroy_compound_page(page, order))
+		return true;
+
+	/* As for order-0 pages, see free_hot_cold_page() */
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+
+	pcpo = pcp_order(&this_cpu_ptr(zone->pageset)->pcp, order);
+	list_add(&page->lru, &pcpo->lists[migratetype]);
+	pcpo->count++;
+	if (pcpo->count >= pcpo->high)
+		pcpo->count -= __free_pcppages_bulk(zone, pcpo->batch,
+					pcpo->count, pcpo->lists, order);
+	return true;
+}
+
+/*
+ * Each order gets a share of the order-0 limits that shrinks with the
+ * order, so that every list holds a similar, smaller number of pages.
+ */
+static void setup_pcp_orders(struct per_cpu_pages *pcp)
+{
+	struct per_cpu_order_pages *pcpo;
+	unsigned int order;
+
+	for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+		pcpo = pcp_order(pcp, order);
+		pcpo->high = pcp->high >> (order + 2);
+		pcpo->batch = max(1, pcp->batch >> (order + 2));
+	}
+}
+#else
+static inline void drain_pcp_orders(struct zone *zone,
+				    struct per_cpu_pages *pcp)
+{
+}
+
+static inline bool pcp_has_pages(struct per_cpu_pages *pcp)
+{
+	return pcp->count;
 }
 
+static inline bool free_pcp_order_page(struct zone *zone, struct page *page,
+				       unsigned int order, int migratetype)
+{
+	return false;
+}
+
+static inline void setup_pcp_orders(struct per_cpu_pages *pcp)
+{
+}
+#endif
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -714,7 +852,7 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	zone->pages_scanned = 0;
 
 	__free_one_page(page, zone, order, migratetype);
-	__mod_zone_page_state(zone, NR_FREE_PAGES, 1 << order);
+	__mod_zone_freepage_state(zone, 1 << order, migratetype);
 	spin_unlock(&zone->lock);
 }
 
@@ -747,6 +885,7 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
@@ -756,8 +895,9 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	migratetype = get_pageblock_migratetype(page);
+	if (!free_pcp_order_page(page_zone(page), page, order, migratetype))
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -780,6 +920,29 @@ void __meminit __free_pages_bootmem(struct page *page, unsigned int order)
 	__free_pages(page, order);
 }
 
+#ifdef CONFIG_CMA
+/* Free whole pageblock and set it's migration type to MIGRATE_CMA. */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+#endif
+
 
 /*
  * The order of subdivision here is critical for the IO subsystem.
@@ -819,7 +982,8 @@ static inline void expand(struct zone *zone, struct page *page,
 			set_page_guard_flag(&page[size]);
 			set_page_private(&page[size], high);
 			/* Guard pages are not available for any usage */
-			__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << high));
+			__mod_zone_freepage_state(zone, -(1 << high),
+						  migratetype);
 			continue;
 		}
 #endif
@@ -905,11 +1069,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -1004,12 +1174,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -1023,13 +1193,19 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * aggressive about taking ownership of free pages
+			 * aggressive about taking ownership of free pages.
+			 *
+			 * On the other hand, never change migration type of
+			 * MIGRATE_CMA pageblocks nor move CMA pages to
+			 * different free lists. We don't want unmovable pages
+			 * to be allocated from MIGRATE_CMA areas.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
 					start_migratetype == MIGRATE_UNMOVABLE ||
 					start_migratetype == MIGRATE_MOVABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -1049,11 +1225,14 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
-			expand(zone, page, order, current_order, area, migratetype);
+			expand(zone, page, order, current_order, area,
+			       is_migrate_cma(migratetype)
+			     ? migratetype : start_migratetype);
 
 			trace_mm_page_alloc_extfrag(page, order, current_order,
 				start_migratetype, migratetype);
@@ -1104,7 +1283,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			unsigned long count, struct list_head *list,
 			int migratetype, int cold)
 {
-	int i;
+	int mt = migratetype, i, nr_cma = 0;
 	
 	spin_lock(&zone->lock);
 	for (i = 0; i < count; ++i) {
@@ -1125,14 +1304,59 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		if (IS_ENABLED(CONFIG_CMA)) {
+			mt = get_pageblock_migratetype(page);
+			if (is_migrate_cma(mt))
+				nr_cma++;
+			else if (mt != MIGRATE_ISOLATE)
+				mt = migratetype;
+		}
+		set_page_private(page, mt);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
+	if (nr_cma)
+		__mod_zone_page_state(zone, NR_FREE_CMA_PAGES,
+				      -(nr_cma << order));
 	spin_unlock(&zone->lock);
 	return i;
 }
 
+#if PCP_HIGH_ORDER > 0
+/* Take a block of order 1 .. PCP_HIGH_ORDER, with interrupts disabled */
+static struct page *rmqueue_pcp_order(struct zone *zone, unsigned int order,
+				      int migratetype, int cold)
+{
+	struct per_cpu_order_pages *pcpo;
+	struct list_head *list;
+	struct page *page;
+
+	pcpo = pcp_order(&this_cpu_ptr(zone->pageset)->pcp, order);
+	list = &pcpo->lists[migratetype];
+	if (list_empty(list)) {
+		pcpo->count += rmqueue_bulk(zone, order, pcpo->batch, list,
+					    migratetype, cold);
+		if (unlikely(list_empty(list)))
+			return NULL;
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pcpo->count--;
+	return page;
+}
+#else
+static inline struct page *rmqueue_pcp_order(struct zone *zone,
+				unsigned int order, int migratetype, int cold)
+{
+	return NULL;
+}
+#endif
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -1154,6 +1378,7 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	drain_pcp_orders(zone, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1182,6 +1407,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1225,7 +1451,7 @@ void drain_all_pages(void)
 		bool has_pcps = false;
 		for_each_populated_zone(zone) {
 			pcp = per_cpu_ptr(zone->pageset, cpu);
-			if (pcp->pcp.count) {
+			if (pcp_has_pages(&pcp->pcp)) {
 				has_pcps = true;
 				break;
 			}
@@ -1393,11 +1619,13 @@ int split_free_page(struct page *page)
 	unsigned int order;
 	unsigned long watermark;
 	struct zone *zone;
+	int mt;
 
 	BUG_ON(!PageBuddy(page));
 
 	zone = page_zone(page);
 	order = page_order(page);
+	mt = get_pageblock_migratetype(page);
 
 	/* Obey watermarks as if the page was being allocated */
 	watermark = low_wmark_pages(zone) + (1 << order);
@@ -1408,13 +1636,14 @@ int split_free_page(struct page *page)
 	list_del(&page->lru);
 	zone->free_area[order].nr_free--;
 	rmv_page_order(page);
-	__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+	__mod_zone_freepage_state(zone, -(1UL << order), mt);
 
 	/* Split into individual pages */
 	set_page_refcounted(page);
 	split_page(page, order);
 
-	if (order >= pageblock_order - 1) {
+	if (order >= pageblock_order - 1 &&
+	    !is_migrate_cma(mt) && mt != MIGRATE_ISOLATE) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
@@ -1437,6 +1666,18 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	struct page *page;
 	int cold = !!(gfp_flags & __GFP_COLD);
 
+	/*
+	 * __GFP_NOFAIL is not to be used in new code.
+	 *
+	 * All __GFP_NOFAIL callers should be fixed so that they
+	 * properly detect and handle allocation failures.
+	 *
+	 * We most definitely don't want callers attempting to
+	 * allocate greater than order-1 page units with
+	 * __GFP_NOFAIL, whether or not the per-cpu lists serve them.
+	 */
+	WARN_ON_ONCE((gfp_flags & __GFP_NOFAIL) && (order > 1));
+
 again:
 	if (likely(order == 0)) {
 		struct per_cpu_pages *pcp;
@@ -1460,26 +1701,19 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= PCP_HIGH_ORDER) {
+		local_irq_save(flags);
+		page = rmqueue_pcp_order(zone, order, migratetype, cold);
+		if (unlikely(!page))
+			goto failed;
 	} else {
-		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
-			/*
-			 * __GFP_NOFAIL is not to be used in new code.
-			 *
-			 * All __GFP_NOFAIL callers should be fixed so that they
-			 * properly detect and handle allocation failures.
-			 *
-			 * We most definitely don't want callers attempting to
-			 * allocate greater than order-1 page units with
-			 * __GFP_NOFAIL.
-			 */
-			WARN_ON_ONCE(order > 1);
-		}
 		spin_lock_irqsave(&zone->lock, flags);
 		page = __rmqueue(zone, order, migratetype);
 		spin_unlock(&zone->lock);
 		if (!page)
 			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		__mod_zone_freepage_state(zone, -(1 << order),
+					  get_pageblock_migratetype(page));
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -1508,6 +1742,7 @@ failed:
 #define ALLOC_HARDER		0x10 /* try to alloc harder */
 #define ALLOC_HIGH		0x20 /* __GFP_HIGH set */
 #define ALLOC_CPUSET		0x40 /* check for correct cpuset */
+#define ALLOC_CMA		0x80 /* allow allocations from CMA areas */
 
 #ifdef CONFIG_FAIL_PAGE_ALLOC
 
@@ -1602,6 +1837,11 @@ static bool __zone_watermark_ok(struct zone *z, int order, unsigned long mark,
 		min -= min / 2;
 	if (alloc_flags & ALLOC_HARDER)
 		min -= min / 4;
+#ifdef CONFIG_CMA
+	/* If allocation can't use CMA areas don't use free CMA pages */
+	if (!(alloc_flags & ALLOC_CMA))
+		free_pages -= zone_page_state(z, NR_FREE_CMA_PAGES);
+#endif
 
 	if (free_pages <= min + z->lowmem_reserve[classzone_idx])
 		return false;
@@ -2086,6 +2326,9 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	if (!order)
 		return NULL;
 
+	/* Have kcompactd get the node ready for the next such allocation */
+	wakeup_kcompactd(preferred_zone->zone_pgdat);
+
 	if (compaction_deferred(preferred_zone, order)) {
 		*deferred_compaction = true;
 		return NULL;
@@ -2274,7 +2517,10 @@ gfp_to_alloc_flags(gfp_t gfp_mask)
 		     unlikely(test_thread_flag(TIF_MEMDIE))))
 			alloc_flags |= ALLOC_NO_WATERMARKS;
 	}
-
+#ifdef CONFIG_CMA
+	if (allocflags_to_migratetype(gfp_mask) == MIGRATE_MOVABLE)
+		alloc_flags |= ALLOC_CMA;
+#endif
 	return alloc_flags;
 }
 
@@ -2501,6 +2747,7 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 	struct page *page = NULL;
 	int migratetype = allocflags_to_migratetype(gfp_mask);
 	unsigned int cpuset_mems_cookie;
+	int alloc_flags = ALLOC_WMARK_LOW|ALLOC_CPUSET;
 
 	gfp_mask &= gfp_allowed_mask;
 
@@ -2529,9 +2776,13 @@ retry_cpuset:
 	if (!preferred_zone)
 		goto out;
 
+#ifdef CONFIG_CMA
+	if (migratetype == MIGRATE_MOVABLE)
+		alloc_flags |= ALLOC_CMA;
+#endif
 	/* First allocation attempt */
 	page = get_page_from_freelist(gfp_mask|__GFP_HARDWALL, nodemask, order,
-			zonelist, high_zoneidx, ALLOC_WMARK_LOW|ALLOC_CPUSET,
+			zonelist, high_zoneidx, alloc_flags,
 			preferred_zone, migratetype);
 	if (unlikely(!page))
 		page = __alloc_pages_slowpath(gfp_mask, order,
@@ -3822,6 +4073,9 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int migratetype;
+#if PCP_HIGH_ORDER > 0
+	unsigned int order;
+#endif
 
 	memset(p, 0, sizeof(*p));
 
@@ -3831,6 +4085,16 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+#if PCP_HIGH_ORDER > 0
+	for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+		struct per_cpu_order_pages *pcpo = pcp_order(pcp, order);
+
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcpo->lists[migratetype]);
+	}
+#endif
+	setup_pcp_orders(pcp);
 }
 
 /*
@@ -3848,6 +4112,7 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	setup_pcp_orders(pcp);
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -3938,6 +4203,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4377,7 +4643,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat_resize_init(pgdat);
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
-	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4435,6 +4703,7 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 		zone_pcp_init(zone);
 		for_each_lru(lru)
 			INIT_LIST_HEAD(&zone->lruvec.lists[lru]);
+		lru_gen_init_lruvec(&zone->lruvec);
 		zone->reclaim_stat.recent_rotated[0] = 0;
 		zone->reclaim_stat.recent_rotated[1] = 0;
 		zone->reclaim_stat.recent_scanned[0] = 0;
@@ -5503,6 +5772,8 @@ static int
 __count_immobile_pages(struct zone *zone, struct page *page, int count)
 {
 	unsigned long pfn, iter, found;
+	int mt;
+
 	/*
 	 * For avoiding noise data, lru_add_drain_all() should be called
 	 * If ZONE_MOVABLE, the zone never contains immobile pages
@@ -5510,7 +5781,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	mt = get_pageblock_migratetype(page);
+	if (mt == MIGRATE_MOVABLE || is_migrate_cma(mt))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5617,8 +5889,14 @@ int set_migratetype_isolate(struct page *page)
 
 out:
 	if (!ret) {
+		int mt = get_pageblock_migratetype(page);
+		int nr_pages;
+
 		set_pageblock_migratetype(page, MIGRATE_ISOLATE);
-		move_freepages_block(zone, page, MIGRATE_ISOLATE);
+		nr_pages = move_freepages_block(zone, page, MIGRATE_ISOLATE);
+		if (is_migrate_cma(mt))
+			__mod_zone_page_state(zone, NR_FREE_CMA_PAGES,
+					      -nr_pages);
 	}
 
 	spin_unlock_irqrestore(&zone->lock, flags);
@@ -5627,20 +5905,271 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
+	int nr_pages;
+
 	zone = page_zone(page);
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	nr_pages = move_freepages_block(zone, page, migratetype);
+	if (is_migrate_cma(migratetype))
+		__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, nr_pages);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+
+static unsigned long pfn_max_align_down(unsigned long pfn)
+{
+	return pfn & ~(max_t(unsigned long, MAX_ORDER_NR_PAGES,
+			     pageblock_nr_pages) - 1);
+}
+
+static unsigned long pfn_max_align_up(unsigned long pfn)
+{
+	return ALIGN(pfn, max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				pageblock_nr_pages));
+}
+
+static struct page *
+__alloc_contig_migrate_alloc(struct page *page, unsigned long private,
+			     int **resultp)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/*
+ * Isolate the in-use pages of [start, end) from the LRU and migrate them
+ * somewhere else.  This is do_migrate_range() from memory_hotplug.c,
+ * except that we retry pages that are temporarily pinned a few times
+ * before giving up on the range.
+ */
+static int __alloc_contig_migrate_range(unsigned long start,
+					unsigned long end)
+{
+	unsigned long pfn = start;
+	unsigned int tries = 0;
+	unsigned int nr_isolated;
+	LIST_HEAD(source);
+	int ret = 0;
+
+	migrate_prep();
+
+	while (pfn < end || !list_empty(&source)) {
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+
+		if (list_empty(&source)) {
+			for (nr_isolated = 0; pfn < end &&
+			     nr_isolated < COMPACT_CLUSTER_MAX; pfn++) {
+				struct page *page;
+
+				if (!pfn_valid(pfn))
+					continue;
+				page = pfn_to_page(pfn);
+				if (PageBuddy(page) ||
+				    !get_page_unless_zero(page))
+					continue;
+				if (!isolate_lru_page(page)) {
+					list_add_tail(&page->lru, &source);
+					inc_zone_page_state(page,
+						NR_ISOLATED_ANON +
+						page_is_file_cache(page));
+					nr_isolated++;
+				}
+				put_page(page);
+			}
+			tries = 0;
+			if (list_empty(&source))
+				continue;
+		} else if (++tries == 5) {
+			ret = ret < 0 ? ret : -EBUSY;
+			break;
+		}
+
+		ret = migrate_pages(&source, __alloc_contig_migrate_alloc,
+				    0, false, MIGRATE_SYNC);
+	}
+
+	putback_lru_pages(&source);
+	return ret > 0 ? 0 : ret;
+}
+
+/*
+ * Take the free pages of [start, end) off the buddy lists and split them
+ * into order-0 pages.  The range must be isolated and all of its pages
+ * must be free.  Returns the pfn one past the last page taken, which may
+ * be beyond @end if the last free page straddled it, or 0 on failure.
+ */
+static unsigned long
+__isolate_freepages_range(struct zone *zone, unsigned long start,
+			  unsigned long end)
+{
+	unsigned long flags, pfn = start;
+
+	spin_lock_irqsave(&zone->lock, flags);
+	while (pfn < end) {
+		struct page *page;
+		unsigned int order;
+
+		if (!pfn_valid_within(pfn)) {
+			pfn++;
+			continue;
+		}
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			break;
+
+		order = page_order(page);
+		list_del(&page->lru);
+		zone->free_area[order].nr_free--;
+		rmv_page_order(page);
+		/* isolated pages are not accounted as free CMA pages */
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+
+		set_page_refcounted(page);
+		split_page(page, order);
+		pfn += 1UL << order;
+	}
+	spin_unlock_irqrestore(&zone->lock, flags);
+
+	if (pfn < end) {
+		/* Give back what we took so far. */
+		free_contig_range(start, pfn - start);
+		return 0;
+	}
+
+	/* The buddy allocator does not map free pages, see split_free_page */
+	for (end = pfn, pfn = start; pfn < end; pfn++) {
+		arch_alloc_page(pfn_to_page(pfn), 0);
+		kernel_map_pages(pfn_to_page(pfn), 1, 1);
+	}
+
+	return end;
+}
+
+/**
+ * alloc_contig_range() -- tries to allocate given range of pages
+ * @start:	start PFN to allocate
+ * @end:	one-past-the-last PFN to allocate
+ *
+ * The PFN range does not have to be pageblock or MAX_ORDER_NR_PAGES
+ * aligned, however it's the caller's responsibility to guarantee that
+ * we are the only thread that changes migrate type of pageblocks the
+ * pages fall in, and that all of them are MIGRATE_CMA.
+ *
+ * The PFN range must belong to a single zone.
+ *
+ * Returns zero on success or negative error code.  On success all
+ * pages which PFN is in [start, end) are allocated for the caller and
+ * need to be freed with free_contig_range().
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	struct zone *zone = page_zone(pfn_to_page(start));
+	unsigned long outer_start, outer_end;
+	int ret = 0, order;
+
+	/*
+	 * What we do here is we mark all pageblocks in range as
+	 * MIGRATE_ISOLATE.  Because pageblock and max order pages may
+	 * have different sizes, and due to the way page allocator
+	 * work, we align the range to biggest of the two pages so
+	 * that page allocator won't try to merge buddies from
+	 * different pageblocks and change MIGRATE_ISOLATE to some
+	 * other migration type.
+	 *
+	 * Once the pageblocks are marked as MIGRATE_ISOLATE, we
+	 * migrate the pages from an unaligned range (ie. pages that
+	 * we are interested in).  This will put all the pages in
+	 * range back to page allocator as MIGRATE_ISOLATE.
+	 *
+	 * When this is done, we take the pages in range from page
+	 * allocator removing them from the buddy system.  This way
+	 * page allocator will never consider using them.
+	 *
+	 * This lets us mark the pageblocks back as MIGRATE_CMA so
+	 * that free pages in the MAX_ORDER aligned range but not in
+	 * the unaligned, original range are put back to page
+	 * allocator so that buddy can use them.
+	 */
+	ret = start_isolate_page_range(pfn_max_align_down(start),
+				       pfn_max_align_up(end), MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	ret = __alloc_contig_migrate_range(start, end);
+	if (ret)
+		goto done;
+
+	/*
+	 * Pages from [start, end) are within MAX_ORDER_NR_PAGES aligned
+	 * blocks that are in MIGRATE_ISOLATE.  Because of that, the
+	 * page allocator will not allocate them, but pages freed while
+	 * they sat on per-cpu or LRU lists still need to reach the
+	 * buddy lists before we can take them.
+	 */
+	lru_add_drain_all();
+	drain_all_pages();
+
+	/*
+	 * The first page of the range may sit in the middle of a free
+	 * buddy; find its head so that the whole buddy can be taken.
+	 */
+	order = 0;
+	outer_start = start;
+	while (!PageBuddy(pfn_to_page(outer_start)) ||
+	       outer_start + (1UL << page_order(pfn_to_page(outer_start)))
+								<= start) {
+		if (++order >= MAX_ORDER) {
+			ret = -EBUSY;
+			goto done;
+		}
+		outer_start &= ~0UL << order;
+	}
+
+	/* Make sure the range is really isolated. */
+	if (test_pages_isolated(outer_start, end)) {
+		pr_debug("%s: [%lx, %lx) PFNs busy\n",
+			 __func__, outer_start, end);
+		ret = -EBUSY;
+		goto done;
+	}
+
+	outer_end = __isolate_freepages_range(zone, outer_start, end);
+	if (!outer_end) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* Free head and tail (if any) */
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(pfn_max_align_down(start),
+				pfn_max_align_up(end), MIGRATE_CMA);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned nr_pages)
+{
+	for (; nr_pages--; ++pfn)
+		__free_page(pfn_to_page(pfn));
+}
+
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
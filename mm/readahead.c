@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/vmstat.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -27,6 +28,7 @@ file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = mapping->backing_dev_info->ra_pages;
 	ra->prev_pos = -1;
+	ra->ra_evicted = mapping->nr_ra_evicted;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
@@ -266,6 +268,7 @@ unsigned long ra_submit(struct file_ra_state *ra,
 {
 	int actual;
 
+	ra->ra_retired = 0;
 	actual = __do_page_cache_readahead(mapping, filp,
 					ra->start, ra->size, ra->async_size);
 
@@ -310,6 +313,90 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
 	return min(newsize, max);
 }
 
+/*
+ * Adaptive window sizing.
+ *
+ * Whenever a readahead window is replaced, ra_retire_window() is told how
+ * many of its pages were used.  Pages count as wasted only when reclaim
+ * actually evicted them unread: the PG_readahead marker of a window is
+ * cleared when the reader gets to it, so reclaim counts the markers it
+ * frees in mapping->nr_ra_evicted, and each one stands for the async part
+ * of a window.  The counter is per file, so readers sharing it share the
+ * blame.  Once about a window's worth of pages has been seen, the window
+ * is halved if more than a quarter of them were wasted, and doubled again,
+ * up to ra_pages, if almost none were.
+ */
+#define RA_MIN_PAGES	((VM_MIN_READAHEAD * 1024) / PAGE_CACHE_SIZE)
+
+unsigned long ra_adaptive_pages(struct file_ra_state *ra)
+{
+	unsigned long pages = ra->ra_pages;
+
+	if (ra->adapt_pages && ra->adapt_pages < pages)
+		pages = ra->adapt_pages;
+	return pages;
+}
+
+void ra_retire_window(struct file_ra_state *ra, struct address_space *mapping,
+		      unsigned long used)
+{
+	unsigned long size = ra->size;
+	unsigned long evicted, wasted;
+	unsigned long window, total;
+
+	if (!size || ra->ra_retired)
+		return;
+	ra->ra_retired = 1;
+	if (used > size)
+		used = size;
+
+	evicted = mapping->nr_ra_evicted - ra->ra_evicted;
+	ra->ra_evicted += evicted;
+	wasted = min(evicted * max_t(unsigned long, ra->async_size, 1),
+		     size - used);
+
+	ra->ra_used += used;
+	ra->ra_wasted += wasted;
+	count_vm_events(READAHEAD_USED, used);
+	count_vm_events(READAHEAD_WASTED, wasted);
+
+	window = ra_adaptive_pages(ra);
+	total = ra->ra_used + ra->ra_wasted;
+	if (total < window)
+		return;
+
+	if (ra->ra_wasted * 4 > total) {
+		if (window > RA_MIN_PAGES) {
+			window = max_t(unsigned long, window / 2, RA_MIN_PAGES);
+			count_vm_event(READAHEAD_SHRINK);
+		}
+	} else if (ra->ra_wasted * 16 < total && window < ra->ra_pages) {
+		window = min_t(unsigned long, window * 2, ra->ra_pages);
+		count_vm_event(READAHEAD_GROW);
+	}
+	ra->adapt_pages = window;
+	ra->ra_used = 0;
+	ra->ra_wasted = 0;
+}
+
+/*
+ * A read outside the expected readahead sequence ends the current window,
+ * which was used up to that read if it lies inside, or else up to the
+ * previous read position.
+ */
+static void ra_retire_at(struct file_ra_state *ra,
+			 struct address_space *mapping, pgoff_t offset)
+{
+	pgoff_t prev = ra->prev_pos >> PAGE_CACHE_SHIFT;
+	unsigned long used = 0;
+
+	if (ra_has_index(ra, offset))
+		used = offset - ra->start;
+	else if (ra->prev_pos >= 0 && ra_has_index(ra, prev))
+		used = prev - ra->start + 1;
+	ra_retire_window(ra, mapping, used);
+}
+
 /*
  * On-demand readahead design.
  *
@@ -411,13 +498,23 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = max_sane_readahead(ra_adaptive_pages(ra));
+
+	/*
+	 * The adaptive limit only trims speculation: never read less than
+	 * the caller asked for, up to the usual maximum.
+	 */
+	if (req_size > max)
+		max = min_t(unsigned long, req_size,
+			    max_sane_readahead(ra->ra_pages));
 
 	/*
 	 * start of file
 	 */
-	if (!offset)
+	if (!offset) {
+		ra_retire_at(ra, mapping, offset);
 		goto initial_readahead;
+	}
 
 	/*
 	 * It's the expected callback offset, assume sequential access.
@@ -425,6 +522,7 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		ra_retire_window(ra, mapping, ra->size);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -447,6 +545,7 @@ ondemand_readahead(struct address_space *mapping,
 		if (!start || start - offset > max)
 			return 0;
 
+		ra_retire_at(ra, mapping, offset);
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
@@ -455,6 +554,11 @@ ondemand_readahead(struct address_space *mapping,
 		goto readit;
 	}
 
+	/*
+	 * Everything below is a cache miss outside the readahead sequence.
+	 */
+	ra_retire_at(ra, mapping, offset);
+
 	/*
 	 * oversize read
 	 */
@@ -476,7 +580,9 @@ ondemand_readahead(struct address_space *mapping,
 
 	/*
 	 * standalone, small random read
-	 * Read as is, and do not pollute the readahead state.
+	 * Read as is, and do not pollute the readahead state.  The window
+	 * stays for a stream to come back to; ra_retired keeps it from
+	 * being accounted for twice.
 	 */
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
@@ -1284,6 +1284,91 @@ out:
 		mem_cgroup_end_update_page_stat(page, &locked, &flags);
 }
 
+#ifdef CONFIG_BATCHED_UNMAP_TLB_FLUSH
+/*
+ * Flush the TLB entries left behind by ptes that try_to_unmap() cleared
+ * with TTU_BATCH_FLUSH.  On SMP every flush is broadcast to all cpus, so
+ * reclaim unmapping many pages of one mm flushes the whole mm once rather
+ * than each page as it goes.
+ */
+void try_to_unmap_flush(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	int i;
+
+	for (i = 0; i < tlb_ubc->nr_mm; i++) {
+		flush_tlb_mm(tlb_ubc->mm[i]);
+		mmdrop(tlb_ubc->mm[i]);
+		tlb_ubc->mm[i] = NULL;
+	}
+	tlb_ubc->nr_mm = 0;
+	tlb_ubc->writable = false;
+}
+
+/*
+ * A dirty pte may still be cached writable: flush before the page is
+ * written back, or writes made through the stale entry could be lost.
+ */
+void try_to_unmap_flush_dirty(void)
+{
+	if (current->tlb_ubc.writable)
+		try_to_unmap_flush();
+}
+
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+	int i;
+
+	for (i = 0; i < tlb_ubc->nr_mm; i++)
+		if (tlb_ubc->mm[i] == mm)
+			goto found;
+
+	if (tlb_ubc->nr_mm == TLB_UBC_NR_MM)
+		try_to_unmap_flush();
+	atomic_inc(&mm->mm_count);
+	tlb_ubc->mm[tlb_ubc->nr_mm++] = mm;
+found:
+	/*
+	 * Set under the pte lock, so that whoever next changes ptes of
+	 * this mm under that lock sees it and flushes first: see
+	 * flush_tlb_batched_pending().
+	 */
+	mm->tlb_flush_batched = true;
+	if (writable)
+		tlb_ubc->writable = true;
+}
+
+/*
+ * Reclaim may have cleared ptes of this mm and not yet flushed the TLB.
+ * Called with the pte lock held, before changing ptes (munmap, mprotect,
+ * mremap) in a way that must not leave stale entries mapping the old pages.
+ */
+void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+	if (mm->tlb_flush_batched) {
+		flush_tlb_mm(mm);
+
+		/*
+		 * Do not allow the compiler to move the clearing of
+		 * tlb_flush_batched before the flush.
+		 */
+		barrier();
+		mm->tlb_flush_batched = false;
+	}
+}
+#else
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
+{
+}
+#endif /* CONFIG_BATCHED_UNMAP_TLB_FLUSH */
+
+static inline bool should_defer_flush(enum ttu_flags flags)
+{
+	return IS_ENABLED(CONFIG_BATCHED_UNMAP_TLB_FLUSH) &&
+		(flags & TTU_BATCH_FLUSH);
+}
+
 /*
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from try_to_unmap_ksm, try_to_unmap_anon or try_to_unmap_file.
@@ -1322,7 +1407,16 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
-	pteval = ptep_clear_flush_notify(vma, address, pte);
+	if (should_defer_flush(flags)) {
+		/*
+		 * Leave the TLB flush to the caller's try_to_unmap_flush().
+		 * Secondary MMUs are still invalidated right away.
+		 */
+		pteval = ptep_get_and_clear(mm, address, pte);
+		mmu_notifier_invalidate_page(mm, address);
+		set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+	} else
+		pteval = ptep_clear_flush_notify(vma, address, pte);
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -975,6 +975,28 @@ static inline void slab_free_hook(struct kmem_cache *s, void *x)
 		debug_check_no_obj_freed(x, s->objsize);
 }
 
+/*
+ * Run slab_free_hook() on each object of a detached freelist running from
+ * head to tail (tail is NULL for a single object).  The list is only walked
+ * when one of the hooks can actually do something.
+ */
+static inline void slab_free_freelist_hook(struct kmem_cache *s,
+					   void *head, void *tail)
+{
+#if defined(CONFIG_KMEMCHECK) || defined(CONFIG_LOCKDEP) ||	\
+	defined(CONFIG_DEBUG_KMEMLEAK) || defined(CONFIG_DEBUG_OBJECTS_FREE)
+	void *object = head;
+	void *tail_obj = tail ? : head;
+
+	do {
+		slab_free_hook(s, object);
+	} while (object != tail_obj &&
+		 (object = get_freepointer(s, object)));
+#else
+	slab_free_hook(s, head);
+#endif
+}
+
 /*
  * Tracking of fully allocated slabs for debugging purposes.
  *
@@ -1264,6 +1286,9 @@ static inline void slab_post_alloc_hook(struct kmem_cache *s, gfp_t flags,
 
 static inline void slab_free_hook(struct kmem_cache *s, void *x) {}
 
+static inline void slab_free_freelist_hook(struct kmem_cache *s,
+					   void *head, void *tail) {}
+
 #endif /* CONFIG_SLUB_DEBUG */
 
 /*
@@ -2415,10 +2440,10 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
  * handling required then we can return immediately.
  */
 static void __slab_free(struct kmem_cache *s, struct page *page,
-			void *x, unsigned long addr)
+			void *head, void *tail, int cnt, unsigned long addr)
 {
 	void *prior;
-	void **object = (void *)x;
+	void *tail_obj = tail ? : head;
 	int was_frozen;
 	int inuse;
 	struct page new;
@@ -2428,16 +2453,17 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	stat(s, FREE_SLOWPATH);
 
-	if (kmem_cache_debug(s) && !free_debug_processing(s, page, x, addr))
+	/* Debug caches never see detached freelists, see kmem_cache_free_bulk */
+	if (kmem_cache_debug(s) && !free_debug_processing(s, page, head, addr))
 		return;
 
 	do {
 		prior = page->freelist;
 		counters = page->counters;
-		set_freepointer(s, object, prior);
+		set_freepointer(s, tail_obj, prior);
 		new.counters = counters;
 		was_frozen = new.frozen;
-		new.inuse--;
+		new.inuse -= cnt;
 		if ((!new.inuse || !prior) && !was_frozen && !n) {
 
 			if (!kmem_cache_debug(s) && !prior)
@@ -2467,7 +2493,7 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	} while (!cmpxchg_double_slab(s, page,
 		prior, counters,
-		object, new.counters,
+		head, new.counters,
 		"__slab_free"));
 
 	if (likely(!n)) {
@@ -2538,15 +2564,20 @@ slab_empty:
  *
  * If fastpath is not possible then fall back to __slab_free where we deal
  * with all sorts of special processing.
+ *
+ * Bulk freeing passes a detached freelist of cnt objects from the same slab,
+ * linked from head to tail, which is spliced in with a single cmpxchg.  For
+ * a single object tail is NULL and cnt is 1.
  */
 static __always_inline void slab_free(struct kmem_cache *s,
-			struct page *page, void *x, unsigned long addr)
+			struct page *page, void *head, void *tail, int cnt,
+			unsigned long addr)
 {
-	void **object = (void *)x;
+	void *tail_obj = tail ? : head;
 	struct kmem_cache_cpu *c;
 	unsigned long tid;
 
-	slab_free_hook(s, x);
+	slab_free_freelist_hook(s, head, tail);
 
 redo:
 	/*
@@ -2563,19 +2594,19 @@ redo:
 	if (likely(page == c->page)) {
 		void **freelist = READ_ONCE(c->freelist);
 
-		set_freepointer(s, object, freelist);
+		set_freepointer(s, tail_obj, freelist);
 
 		if (unlikely(!this_cpu_cmpxchg_double(
 				s->cpu_slab->freelist, s->cpu_slab->tid,
 				freelist, tid,
-				object, next_tid(tid)))) {
+				head, next_tid(tid)))) {
 
 			note_cmpxchg_failure("slab_free", s, tid);
 			goto redo;
 		}
 		stat(s, FREE_FASTPATH);
 	} else
-		__slab_free(s, page, x, addr);
+		__slab_free(s, page, head, tail, cnt, addr);
 
 }
 
@@ -2585,12 +2616,180 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 
 	page = virt_to_head_page(x);
 
-	slab_free(s, page, x, _RET_IP_);
+	slab_free(s, page, x, NULL, 1, _RET_IP_);
 
 	trace_kmem_cache_free(_RET_IP_, x);
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+struct detached_freelist {
+	struct page *page;
+	void *tail;
+	void *freelist;
+	int cnt;
+};
+
+/*
+ * Collect objects of the same slab page, starting from the end of the array,
+ * into a detached freelist.  Processed entries are cleared in the array.
+ * The scan gives up after a few objects from other slabs, so it stays cheap
+ * when the array is not sorted by slab at all.
+ *
+ * Returns the number of array entries that are left to process.
+ */
+static size_t build_detached_freelist(struct kmem_cache *s, size_t size,
+				      void **p, struct detached_freelist *df)
+{
+	size_t first_skipped_index = 0;
+	int lookahead = 3;
+	void *object;
+
+	df->page = NULL;
+
+	do {
+		object = p[--size];
+	} while (!object && size);
+
+	if (!object)
+		return 0;
+
+	set_freepointer(s, object, NULL);
+	df->page = virt_to_head_page(object);
+	df->tail = object;
+	df->freelist = object;
+	df->cnt = 1;
+	p[size] = NULL;
+
+	while (size) {
+		object = p[--size];
+		if (!object)
+			continue;
+
+		if (df->page == virt_to_head_page(object)) {
+			set_freepointer(s, object, df->freelist);
+			df->freelist = object;
+			df->cnt++;
+			p[size] = NULL;
+			continue;
+		}
+
+		if (!--lookahead)
+			break;
+
+		if (!first_skipped_index)
+			first_skipped_index = size + 1;
+	}
+
+	return first_skipped_index;
+}
+
+/*
+ * Free an array of objects.  Objects belonging to the same slab are handed
+ * back together, so a remote free takes the node's list_lock at most once
+ * per slab instead of once per object.  The array is clobbered.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	size_t i;
+
+	if (WARN_ON(!size))
+		return;
+
+	if (unlikely(kmem_cache_debug(s))) {
+		for (i = 0; i < size; i++) {
+			if (p[i])
+				kmem_cache_free(s, p[i]);
+		}
+		return;
+	}
+
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (unlikely(!df.page))
+			continue;
+
+		slab_free(s, df.page, df.freelist, df.tail, df.cnt, _RET_IP_);
+	} while (likely(size));
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/*
+ * Allocate size objects into p.  The per cpu freelist is drained with
+ * interrupts disabled once for the whole batch instead of a cmpxchg per
+ * object; __slab_alloc copes with being called with interrupts off.  The
+ * caller may already have them off, so save and restore the state.
+ *
+ * Returns the number of objects allocated, which is either size or 0.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	size_t i;
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	local_irq_save(irqflags);
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < size; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/*
+			 * The slow path may enable interrupts for a page
+			 * allocation: bump the tid so that a fastpath we
+			 * interrupted cannot use the freelist we consumed,
+			 * and reload c since we may come back on another cpu.
+			 */
+			c->tid = next_tid(c->tid);
+			p[i] = __slab_alloc(s, flags, NUMA_NO_NODE,
+					    _RET_IP_, c);
+			if (unlikely(!p[i]))
+				goto error;
+
+			c = this_cpu_ptr(s->cpu_slab);
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[i] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_restore(irqflags);
+
+	for (i = 0; i < size; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->objsize);
+		slab_post_alloc_hook(s, flags, p[i]);
+	}
+	return size;
+
+error:
+	c->tid = next_tid(c->tid);
+	local_irq_restore(irqflags);
+	while (i--) {
+		slab_post_alloc_hook(s, flags, p[i]);
+		slab_free(s, virt_to_head_page(p[i]), p[i], NULL, 1, _RET_IP_);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
+bool kmem_cache_debugged(struct kmem_cache *s)
+{
+#ifdef CONFIG_DEBUG_KMEMLEAK
+	if (!(s->flags & SLAB_NOLEAKTRACE))
+		return true;
+#endif
+	return kmem_cache_debug(s);
+}
+EXPORT_SYMBOL(kmem_cache_debugged);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
@@ -3458,7 +3657,7 @@ void kfree(const void *x)
 		put_page(page);
 		return;
 	}
-	slab_free(page->slab, page, object, _RET_IP_);
+	slab_free(page->slab, page, object, NULL, 1, _RET_IP_);
 }
 EXPORT_SYMBOL(kfree);
 
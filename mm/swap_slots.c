@@ -0,0 +1,253 @@
+/*
+ *  linux/mm/swap_slots.c
+ *
+ * Per cpu caches of swap entries.
+ *
+ * Allocating a swap entry used to take swap_lock and the swap area's lock
+ * for every page swapped out, and freeing one took the area's lock again.
+ * Instead, each cpu keeps a small array of entries allocated in one batch
+ * by get_swap_pages(), and another array collecting entries being freed,
+ * which swapcache_free_entries() releases in one batch.
+ *
+ * The caches are bypassed while free swap is scarce, so that entries
+ * parked on other cpus do not make get_swap_page() fail, and during
+ * swapoff, so that try_to_unuse() sees every entry of the area.
+ */
+
+#include <linux/swap_slots.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swp_slots);
+static bool	swap_slot_cache_active;
+static bool	swap_slot_cache_enabled;
+static bool	swap_slot_cache_initialized;
+static DEFINE_MUTEX(swap_slots_cache_mutex);
+/* Serialize enabling and disabling against swapon and swapoff */
+static DEFINE_MUTEX(swap_slots_cache_enable_mutex);
+
+#define use_swap_slot_cache (swap_slot_cache_active && swap_slot_cache_enabled)
+
+#define SLOTS_CACHE		0x1
+#define SLOTS_CACHE_RET		0x2
+
+static void drain_slots_cache_cpu(unsigned int cpu, unsigned int type)
+{
+	struct swap_slots_cache *cache = &per_cpu(swp_slots, cpu);
+
+	if ((type & SLOTS_CACHE) && cache->slots) {
+		mutex_lock(&cache->alloc_lock);
+		swapcache_free_entries(cache->slots + cache->cur, cache->nr);
+		cache->cur = 0;
+		cache->nr = 0;
+		mutex_unlock(&cache->alloc_lock);
+	}
+	if ((type & SLOTS_CACHE_RET) && cache->slots_ret) {
+		spin_lock(&cache->free_lock);
+		swapcache_free_entries(cache->slots_ret, cache->n_ret);
+		cache->n_ret = 0;
+		spin_unlock(&cache->free_lock);
+	}
+}
+
+static void __drain_swap_slots_cache(unsigned int type)
+{
+	unsigned int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		drain_slots_cache_cpu(cpu, type);
+	put_online_cpus();
+}
+
+static void deactivate_swap_slots_cache(void)
+{
+	mutex_lock(&swap_slots_cache_mutex);
+	swap_slot_cache_active = false;
+	__drain_swap_slots_cache(SLOTS_CACHE | SLOTS_CACHE_RET);
+	mutex_unlock(&swap_slots_cache_mutex);
+}
+
+static void reactivate_swap_slots_cache(void)
+{
+	mutex_lock(&swap_slots_cache_mutex);
+	swap_slot_cache_active = true;
+	mutex_unlock(&swap_slots_cache_mutex);
+}
+
+/*
+ * Turn the caches off when free swap runs low, and back on once there is
+ * plenty again; the gap between the two thresholds avoids flapping.
+ */
+static bool check_cache_active(void)
+{
+	long pages;
+
+	if (!swap_slot_cache_enabled)
+		return false;
+
+	pages = get_nr_swap_pages();
+	if (!swap_slot_cache_active) {
+		if (pages > num_online_cpus() *
+			    THRESHOLD_ACTIVATE_SWAP_SLOTS_CACHE)
+			reactivate_swap_slots_cache();
+	} else if (pages < num_online_cpus() *
+			   THRESHOLD_DEACTIVATE_SWAP_SLOTS_CACHE)
+		deactivate_swap_slots_cache();
+
+	return swap_slot_cache_active;
+}
+
+static int alloc_swap_slot_cache(unsigned int cpu)
+{
+	struct swap_slots_cache *cache = &per_cpu(swp_slots, cpu);
+	swp_entry_t *slots, *slots_ret;
+
+	slots = kcalloc(SWAP_SLOTS_CACHE_SIZE, sizeof(swp_entry_t),
+			GFP_KERNEL);
+	if (!slots)
+		return -ENOMEM;
+
+	slots_ret = kcalloc(SWAP_SLOTS_CACHE_SIZE, sizeof(swp_entry_t),
+			    GFP_KERNEL);
+	if (!slots_ret) {
+		kfree(slots);
+		return -ENOMEM;
+	}
+
+	mutex_init(&cache->alloc_lock);
+	spin_lock_init(&cache->free_lock);
+	cache->nr = 0;
+	cache->cur = 0;
+	cache->n_ret = 0;
+	cache->slots = slots;
+	cache->slots_ret = slots_ret;
+	return 0;
+}
+
+/*
+ * Called from swapon: the caches of all possible cpus are allocated on
+ * first use, so cpu hotplug only ever has to drain them.  A cpu whose
+ * cache could not be allocated just allocates and frees directly.
+ */
+void enable_swap_slots_cache(void)
+{
+	unsigned int cpu;
+
+	mutex_lock(&swap_slots_cache_enable_mutex);
+	if (!swap_slot_cache_initialized) {
+		for_each_possible_cpu(cpu) {
+			if (alloc_swap_slot_cache(cpu)) {
+				printk(KERN_WARNING "swap_slots: cannot "
+				       "allocate cache for cpu %u\n", cpu);
+				break;
+			}
+		}
+		swap_slot_cache_initialized = true;
+	}
+	swap_slot_cache_enabled = true;
+	mutex_unlock(&swap_slots_cache_enable_mutex);
+}
+
+/*
+ * Called from swapoff, before try_to_unuse(): drain and bypass the caches
+ * until reenable_swap_slots_cache().
+ */
+void disable_swap_slots_cache(void)
+{
+	mutex_lock(&swap_slots_cache_enable_mutex);
+	swap_slot_cache_enabled = false;
+	if (swap_slot_cache_initialized)
+		__drain_swap_slots_cache(SLOTS_CACHE | SLOTS_CACHE_RET);
+}
+
+void reenable_swap_slots_cache(void)
+{
+	swap_slot_cache_enabled = swap_slot_cache_initialized;
+	mutex_unlock(&swap_slots_cache_enable_mutex);
+}
+
+static int refill_swap_slots_cache(struct swap_slots_cache *cache)
+{
+	if (!use_swap_slot_cache || cache->nr)
+		return 0;
+
+	cache->cur = 0;
+	cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE, cache->slots);
+
+	return cache->nr;
+}
+
+void free_swap_slot(swp_entry_t entry)
+{
+	struct swap_slots_cache *cache;
+
+	cache = __this_cpu_ptr(&swp_slots);
+	if (use_swap_slot_cache && cache->slots_ret) {
+		spin_lock(&cache->free_lock);
+		/* The cache may have been deactivated before we got the lock */
+		if (!use_swap_slot_cache) {
+			spin_unlock(&cache->free_lock);
+			goto direct_free;
+		}
+		if (cache->n_ret >= SWAP_SLOTS_CACHE_SIZE) {
+			swapcache_free_entries(cache->slots_ret, cache->n_ret);
+			cache->n_ret = 0;
+		}
+		cache->slots_ret[cache->n_ret++] = entry;
+		spin_unlock(&cache->free_lock);
+	} else {
+direct_free:
+		swapcache_free_entries(&entry, 1);
+	}
+}
+
+swp_entry_t get_swap_page(void)
+{
+	swp_entry_t entry;
+	struct swap_slots_cache *cache;
+
+	entry.val = 0;
+
+	/*
+	 * The cache of whichever cpu we started on is used even if we get
+	 * preempted and migrated meanwhile: alloc_lock keeps that safe, and
+	 * taking it sleeps, so we cannot pin ourselves to the cpu anyway.
+	 */
+	cache = __this_cpu_ptr(&swp_slots);
+	if (check_cache_active() && cache->slots) {
+		mutex_lock(&cache->alloc_lock);
+repeat:
+		if (cache->nr) {
+			entry = cache->slots[cache->cur];
+			cache->slots[cache->cur++].val = 0;
+			cache->nr--;
+		} else if (refill_swap_slots_cache(cache))
+			goto repeat;
+		mutex_unlock(&cache->alloc_lock);
+		if (entry.val)
+			return entry;
+	}
+
+	get_swap_pages(1, &entry);
+	return entry;
+}
+
+static int __cpuinit swap_slots_cpu_notify(struct notifier_block *self,
+					   unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		drain_slots_cache_cpu(cpu, SLOTS_CACHE | SLOTS_CACHE_RET);
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_init(void)
+{
+	hotcpu_notifier(swap_slots_cpu_notify, 0);
+	return 0;
+}
+subsys_initcall(swap_slots_init);
@@ -49,6 +49,32 @@ struct address_space swapper_spaces[MAX_SWAPFILES] = {
 
 #define INC_CACHE_INFO(x)	do { swap_cache_info.x++; } while (0)
 
+/* Use the vma based swap readahead for page faults, see swapin_readahead() */
+int sysctl_swap_vma_readahead __read_mostly = 1;
+
+/*
+ * The vma based readahead state lives in vma->swap_readahead_info: the
+ * address of the last fault, the readahead window size used then, and the
+ * number of readahead hits since, packed in the bits below PAGE_SHIFT.
+ */
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* Upper bound of the readahead window, still limited by page_cluster */
+#define SWAP_RA_ORDER_CEILING	4
+#define SWAP_RA_WIN_MAX		(1 << SWAP_RA_ORDER_CEILING)
+
 static struct {
 	unsigned long add_total;
 	unsigned long del_total;
@@ -287,31 +313,55 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+				unsigned long addr)
 {
 	struct page *page;
+	unsigned long ra_val;
+	unsigned int hits;
 
 	page = find_get_page(swap_address_space(entry), entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		/*
+		 * PG_readahead doubles as PG_reclaim, which only has its
+		 * write meaning while the page is under writeback.
+		 */
+		if (!PageWriteback(page) && TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma) {
+				ra_val = atomic_long_read(
+						&vma->swap_readahead_info);
+				hits = SWAP_RA_HITS(ra_val);
+				if (hits < SWAP_RA_HITS_MAX)
+					hits++;
+				atomic_long_set(&vma->swap_readahead_info,
+					SWAP_RA_VAL(SWAP_RA_ADDR(ra_val),
+						    SWAP_RA_WIN(ra_val), hits));
+			}
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-/* 
+/*
  * Locate a page of swap in physical memory, reserving swap cache space
- * and reading the disk if it is not already cached.
+ * if it is not already cached.  A newly allocated page is returned locked,
+ * with *new_page_allocated set, and the caller must start the read into it.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -375,10 +425,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		if (likely(!err)) {
 			radix_tree_preload_end();
 			/*
-			 * Initiate read into locked page and return.
+			 * Caller initiates read into locked page.
 			 */
 			lru_cache_add_anon(new_page);
-			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -396,8 +446,57 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Locate a page of swap in physical memory, reserving swap cache space
+ * and reading the disk if it is not already cached.
+ * A failure return means that either the page allocation failed or that
+ * the swap entry is no longer in use.
+ */
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_was_allocated;
+	struct page *page = __read_swap_cache_async(entry, gfp_mask,
+					vma, addr, &page_was_allocated);
+
+	if (page_was_allocated)
+		swap_readpage(page);
+	return page;
+}
+
+/*
+ * Start a readahead read of a swap entry which nobody has faulted on yet,
+ * marking the page so that lookup_swap_cache() can count it as a hit.
+ */
+static void swap_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_was_allocated;
+	struct page *page;
+
+	/*
+	 * Skip entries nobody refers to: they may be sitting unused in
+	 * a swap slots cache, marked SWAP_HAS_CACHE with no page, and
+	 * __read_swap_cache_async() would then spin on -EEXIST until
+	 * somebody else gets to use them.
+	 */
+	if (!__swp_swapcount(entry))
+		return;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_was_allocated);
+	if (!page)
+		return;
+	if (page_was_allocated) {
+		SetPageReadahead(page);
+		swap_readpage(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+}
+
 /**
- * swapin_readahead - swap in pages in hope we need them soon
+ * swap_cluster_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
  * @gfp_mask: memory allocation flags
  * @vma: user vma this address belongs to
@@ -411,24 +510,19 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * the 'original' request together with the readahead ones...
  *
  * This has been extended to use the NUMA policies from the mm triggering
- * the readahead.
+ * the readahead.  It is used for shmem, whose swap entries have no page
+ * table neighbours to go by, and for faults when the vma based readahead
+ * is disabled.
  *
  * Caller must hold down_read on the vma->vm_mm if vma is not NULL.
  */
-struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
+struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 #ifdef CONFIG_SWAP_ENABLE_READAHEAD
-	struct page *page;
 	unsigned long offset = swp_offset(entry);
 	unsigned long start_offset, end_offset;
-	unsigned long mask = is_swap_fast(entry) ? 0 : (1UL << page_cluster) - 1;
-
-#ifdef CONFIG_ZSWAP
-	swap_cache_miss(vma);
-	if (swap_cache_skip_readahead(vma))
-		goto skip;
-#endif
+	unsigned long mask = (1UL << page_cluster) - 1;
 
 	/* Read a page_cluster sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
@@ -437,17 +531,166 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 		start_offset++;
 
 	for (offset = start_offset; offset <= end_offset ; offset++) {
+		if (offset == swp_offset(entry))
+			continue;
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		swap_readahead_one(swp_entry(swp_type(entry), offset),
+				   gfp_mask, vma, addr);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+#endif /* CONFIG_SWAP_ENABLE_READAHEAD */
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
+
+#ifdef CONFIG_SWAP_ENABLE_READAHEAD
+/*
+ * Size the next readahead window from the hits of the previous one: grow
+ * it to the next power of two above hits + 2, but when nothing hit, keep
+ * reading a couple of pages for a sequential fault, rather than getting
+ * stuck at single page reads.  Never shrink by more than half at a time.
+ */
+static unsigned int swapin_nr_pages(unsigned long prev_pfn, unsigned long pfn,
+				    unsigned int hits, unsigned int max_pages,
+				    unsigned int prev_win)
+{
+	unsigned int pages, roundup;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		if (pfn != prev_pfn + 1 && pfn != prev_pfn - 1)
+			pages = 1;
+	} else {
+		roundup = 4;
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+	if (pages < prev_win / 2)
+		pages = prev_win / 2;
+
+	return pages;
+}
+
+/*
+ * Read ahead the swap entries found in the page table around the faulting
+ * address, in the direction the faults are going, rather than whatever
+ * happens to neighbour the faulting entry in the swap area.
+ */
+static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long faddr)
+{
+	pte_t ptes[SWAP_RA_WIN_MAX];
+	unsigned long ra_val, fpfn, prev_pfn, lpfn, rpfn, start, end, pfn;
+	unsigned int max_win, hits, prev_win, win, left, i;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+	swp_entry_t entry;
+
+	max_win = 1 << min_t(unsigned int, page_cluster,
+			     SWAP_RA_ORDER_CEILING);
+	if (max_win == 1)
+		goto out;
+
+	faddr &= PAGE_MASK;
+	fpfn = PFN_DOWN(faddr);
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	prev_pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	prev_win = SWAP_RA_WIN(ra_val);
+	hits = SWAP_RA_HITS(ra_val);
+	win = swapin_nr_pages(prev_pfn, fpfn, hits, max_win, prev_win);
+	atomic_long_set(&vma->swap_readahead_info, SWAP_RA_VAL(faddr, win, 0));
+	if (win == 1)
+		goto out;
+
+	if (fpfn == prev_pfn + 1) {
+		lpfn = fpfn;
+		rpfn = fpfn + win;
+	} else if (fpfn == prev_pfn - 1) {
+		lpfn = fpfn + 1 > win ? fpfn + 1 - win : 0;
+		rpfn = fpfn + 1;
+	} else {
+		left = (win - 1) / 2;
+		lpfn = fpfn > left ? fpfn - left : 0;
+		rpfn = lpfn + win;
+	}
+	/* Stay inside the vma and the page table of the faulting address */
+	start = max3(lpfn, PFN_DOWN(vma->vm_start), PFN_DOWN(faddr & PMD_MASK));
+	end = min3(rpfn, PFN_DOWN(vma->vm_end),
+		   PFN_DOWN(faddr & PMD_MASK) + PTRS_PER_PTE);
+	if (end - start <= 1)
+		goto out;
+
+	pgd = pgd_offset(vma->vm_mm, faddr);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		goto out;
+	pud = pud_offset(pgd, faddr);
+	if (pud_none(*pud) || pud_bad(*pud))
+		goto out;
+	pmd = pmd_offset(pud, faddr);
+	if (pmd_none(*pmd) || pmd_bad(*pmd) || pmd_trans_huge(*pmd))
+		goto out;
+
+	/*
+	 * The ptes are only hints: copy them without the page table lock,
+	 * read_swap_cache_async() copes with entries freed meanwhile.
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < end - start; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0, pfn = start; pfn < end; i++, pfn++) {
+		if (pfn == fpfn)
 			continue;
-		page_cache_release(page);
+		if (pte_none(ptes[i]) || pte_present(ptes[i]) ||
+		    pte_file(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		swap_readahead_one(entry, gfp_mask, vma, pfn << PAGE_SHIFT);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+out:
+	return read_swap_cache_async(fentry, gfp_mask, vma, faddr);
+}
+#endif /* CONFIG_SWAP_ENABLE_READAHEAD */
+
+/**
+ * swapin_readahead - swap in pages in hope we need them soon
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: address of the page fault
+ *
+ * Returns the struct page for entry and addr, after queueing swapin.
+ *
+ * Called on a page fault.  Pages that neighbour each other in swap often
+ * have nothing to do with each other in the faulting address space, so by
+ * default this reads ahead the swap entries mapped around the faulting
+ * address instead, with a window sized by how many of the previously read
+ * ahead pages of this vma did get used (see the swap_ra and swap_ra_hit
+ * counters in /proc/vmstat).  vm.swap_vma_readahead = 0 reverts to
+ * swap_cluster_readahead().
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+#ifdef CONFIG_SWAP_ENABLE_READAHEAD
 #ifdef CONFIG_ZSWAP
-skip:
+	swap_cache_miss(vma);
+	if (swap_cache_skip_readahead(vma))
+		return read_swap_cache_async(entry, gfp_mask, vma, addr);
 #endif
-#endif /* CONFIG_SWAP_ENABLE_READAHEAD */
-	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+	if (sysctl_swap_vma_readahead)
+		return swap_vma_readahead(entry, gfp_mask, vma, addr);
+#endif
+	return swap_cluster_readahead(entry, gfp_mask, vma, addr);
 }
@@ -11,6 +11,7 @@
 #include <linux/slab.h>
 #include <linux/kernel_stat.h>
 #include <linux/swap.h>
+#include <linux/swap_slots.h>
 #include <linux/vmalloc.h>
 #include <linux/pagemap.h>
 #include <linux/namei.h>
@@ -86,26 +87,6 @@ static inline unsigned char swap_count(unsigned char ent)
 	return ent & ~SWAP_HAS_CACHE;	/* may include SWAP_HAS_CONT flag */
 }
 
-bool is_swap_fast(swp_entry_t entry)
-{
-	struct swap_info_struct *p;
-	unsigned long type;
-
-	if (non_swap_entry(entry))
-		return false;
-
-	type = swp_type(entry);
-	if (type >= nr_swapfiles)
-		return false;
-
-	p = swap_info[type];
-
-	if (p->flags & SWP_FAST)
-		return true;
-
-	return false;
-}
-
 /* returns 1 if swap entry is freed */
 static int
 __try_to_reclaim_swap(struct swap_info_struct *si, unsigned long offset)
@@ -217,9 +198,71 @@ static int wait_for_discard(void *word)
 #define SWAPFILE_CLUSTER	256
 #define LATENCY_LIMIT		256
 
+static inline struct swap_cluster_info *lock_cluster(struct swap_info_struct *si,
+						     unsigned long offset)
+{
+	struct swap_cluster_info *ci;
+
+	ci = si->cluster_info;
+	if (ci) {
+		ci += offset / SWAPFILE_CLUSTER;
+		spin_lock(&ci->lock);
+	}
+	return ci;
+}
+
+static inline void unlock_cluster(struct swap_cluster_info *ci)
+{
+	if (ci)
+		spin_unlock(&ci->lock);
+}
+
+/*
+ * Try to allocate from this cpu's current cluster of a solid state swap
+ * area, moving on to a completely free cluster when that one is used up.
+ * Different cpus thus fill different clusters, instead of all of them
+ * chasing the same cluster_next.  Called with si->lock held; returns false
+ * when no free cluster is left, and scan_swap_map() then does its usual
+ * first-free scan.
+ */
+static bool scan_swap_map_try_ssd_cluster(struct swap_info_struct *si,
+					  unsigned long *offset)
+{
+	struct percpu_cluster *cluster;
+	unsigned long nr_clusters = DIV_ROUND_UP(si->max, SWAPFILE_CLUSTER);
+	unsigned long idx, n, tmp;
+
+	cluster = this_cpu_ptr(si->percpu_cluster);
+	for (;;) {
+		for (tmp = cluster->next; tmp < cluster->end; tmp++) {
+			if (!si->swap_map[tmp]) {
+				cluster->next = tmp + 1;
+				*offset = tmp;
+				return true;
+			}
+		}
+
+		idx = si->cluster_next / SWAPFILE_CLUSTER;
+		for (n = 0; n < nr_clusters; n++, idx++) {
+			if (idx >= nr_clusters)
+				idx = 0;
+			if (!si->cluster_info[idx].count)
+				break;
+		}
+		if (n == nr_clusters) {
+			cluster->end = 0;
+			return false;
+		}
+		cluster->next = idx * SWAPFILE_CLUSTER;
+		cluster->end = min_t(unsigned long,
+				     cluster->next + SWAPFILE_CLUSTER, si->max);
+	}
+}
+
 static unsigned long scan_swap_map(struct swap_info_struct *si,
 				   unsigned char usage)
 {
+	struct swap_cluster_info *ci;
 	unsigned long offset;
 	unsigned long scan_base;
 	unsigned long last_in_cluster = 0;
@@ -240,7 +283,12 @@ static unsigned long scan_swap_map(struct swap_info_struct *si,
 	si->flags += SWP_SCANNING;
 	scan_base = offset = si->cluster_next;
 
-	if (unlikely(!si->cluster_nr--)) {
+	if (si->percpu_cluster) {
+		if (scan_swap_map_try_ssd_cluster(si, &offset)) {
+			scan_base = offset;
+			goto checks;
+		}
+	} else if (unlikely(!si->cluster_nr--)) {
 		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER) {
 			si->cluster_nr = SWAPFILE_CLUSTER - 1;
 			goto checks;
@@ -337,8 +385,15 @@ checks:
 		goto scan; /* check next one */
 	}
 
-	if (si->swap_map[offset])
+	ci = lock_cluster(si, offset);
+	if (si->swap_map[offset]) {
+		unlock_cluster(ci);
 		goto scan;
+	}
+	si->swap_map[offset] = usage;
+	if (ci)
+		ci->count++;
+	unlock_cluster(ci);
 
 	if (offset == si->lowest_bit)
 		si->lowest_bit++;
@@ -349,7 +404,6 @@ checks:
 		si->lowest_bit = si->max;
 		si->highest_bit = 0;
 	}
-	si->swap_map[offset] = usage;
 	si->cluster_next = offset + 1;
 	si->flags -= SWP_SCANNING;
 
@@ -449,18 +503,28 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Allocate up to @n swap entries for the swap cache, all from the same swap
+ * area, taking swap_lock and the area's lock once for the whole batch.
+ * Returns the number of entries stored in @swp_entries.
+ */
+int get_swap_pages(int n, swp_entry_t swp_entries[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
 	int hp_index;
+	long avail;
+	int n_ret = 0;
 
 	spin_lock(&swap_lock);
-	if (atomic_long_read(&nr_swap_pages) <= 0)
+	avail = atomic_long_read(&nr_swap_pages);
+	if (avail <= 0)
 		goto noswap;
-	atomic_long_dec(&nr_swap_pages);
+	if (n > avail)
+		n = avail;
+	atomic_long_sub(n, &nr_swap_pages);
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		hp_index = atomic_xchg(&highest_priority_index, -1);
@@ -504,19 +568,28 @@ swp_entry_t get_swap_page(void)
 		swap_list.next = next;
 
 		spin_unlock(&swap_lock);
-		/* This is called for allocating swap entry for cache */
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
+		/* This is called for allocating swap entries for cache */
+		while (n_ret < n) {
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			swp_entries[n_ret++] = swp_entry(type, offset);
+		}
 		spin_unlock(&si->lock);
-		if (offset)
-			return swp_entry(type, offset);
+		if (n_ret)
+			goto out;
 		spin_lock(&swap_lock);
 		next = swap_list.next;
 	}
+	spin_unlock(&swap_lock);
+out:
+	if (n_ret < n)
+		atomic_long_add(n - n_ret, &nr_swap_pages);
+	return n_ret;
 
-	atomic_long_inc(&nr_swap_pages);
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return 0;
 }
 
 /* The only caller of this function is now susupend routine */
@@ -541,7 +614,7 @@ swp_entry_t get_swap_page_of_type(int type)
 	return (swp_entry_t) {0};
 }
 
-static struct swap_info_struct *swap_info_get(swp_entry_t entry)
+static struct swap_info_struct *_swap_info_get(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
 	unsigned long offset, type;
@@ -559,7 +632,6 @@ static struct swap_info_struct *swap_info_get(swp_entry_t entry)
 		goto bad_offset;
 	if (!p->swap_map[offset])
 		goto bad_free;
-	spin_lock(&p->lock);
 	return p;
 
 bad_free:
@@ -577,6 +649,16 @@ out:
 	return NULL;
 }
 
+static struct swap_info_struct *swap_info_get(swp_entry_t entry)
+{
+	struct swap_info_struct *p;
+
+	p = _swap_info_get(entry);
+	if (p)
+		spin_lock(&p->lock);
+	return p;
+}
+
 /*
  * This swap type frees swap entry, check if it is the highest priority swap
  * type which just frees swap entry. get_swap_page() uses
@@ -598,13 +680,21 @@ static void set_highest_priority_index(int type)
 		old_hp_index, new_hp_index) != old_hp_index);
 }
 
-static unsigned char swap_entry_free(struct swap_info_struct *p,
-				     swp_entry_t entry, unsigned char usage)
+/*
+ * Drop one reference of the given @usage from a swap entry, under its
+ * cluster lock.  When no reference is left, the entry is not freed but
+ * marked SWAP_MAP_FREEING and 0 is returned: the caller then hands it to
+ * free_swap_slot(), which batches the final swap_entry_free() calls.
+ */
+static unsigned char __swap_entry_free(struct swap_info_struct *p,
+				       swp_entry_t entry, unsigned char usage)
 {
+	struct swap_cluster_info *ci;
 	unsigned long offset = swp_offset(entry);
 	unsigned char count;
 	unsigned char has_cache;
 
+	ci = lock_cluster(p, offset);
 	count = p->swap_map[offset];
 	has_cache = count & SWAP_HAS_CACHE;
 	count &= ~SWAP_HAS_CACHE;
@@ -632,29 +722,46 @@ static unsigned char swap_entry_free(struct swap_info_struct *p,
 		mem_cgroup_uncharge_swap(entry);
 
 	usage = count | has_cache;
-	p->swap_map[offset] = usage;
-
-	/* free if no reference */
-	if (!usage) {
-		struct gendisk *disk = p->bdev->bd_disk;
-		if (offset < p->lowest_bit)
-			p->lowest_bit = offset;
-		if (offset > p->highest_bit)
-			p->highest_bit = offset;
-		set_highest_priority_index(p->type);
-		atomic_long_inc(&nr_swap_pages);
-		p->inuse_pages--;
-#ifdef CONFIG_FRONTSWAP
-		frontswap_invalidate_page(p->type, offset);
-#endif
-		if ((p->flags & SWP_BLKDEV) &&
-				disk->fops->swap_slot_free_notify)
-			disk->fops->swap_slot_free_notify(p->bdev, offset);
-	}
+	p->swap_map[offset] = usage ? : SWAP_MAP_FREEING;
+	unlock_cluster(ci);
 
 	return usage;
 }
 
+/*
+ * Really free a swap entry which __swap_entry_free() left unreferenced.
+ * Called with p->lock held.
+ */
+static void swap_entry_free(struct swap_info_struct *p, swp_entry_t entry)
+{
+	struct swap_cluster_info *ci;
+	struct gendisk *disk = p->bdev->bd_disk;
+	unsigned long offset = swp_offset(entry);
+	unsigned char count;
+
+	ci = lock_cluster(p, offset);
+	count = p->swap_map[offset];
+	VM_BUG_ON(count != SWAP_MAP_FREEING && count != SWAP_HAS_CACHE);
+	p->swap_map[offset] = 0;
+	if (ci)
+		ci->count--;
+	unlock_cluster(ci);
+
+	if (offset < p->lowest_bit)
+		p->lowest_bit = offset;
+	if (offset > p->highest_bit)
+		p->highest_bit = offset;
+	set_highest_priority_index(p->type);
+	atomic_long_inc(&nr_swap_pages);
+	p->inuse_pages--;
+#ifdef CONFIG_FRONTSWAP
+	frontswap_invalidate_page(p->type, offset);
+#endif
+	if ((p->flags & SWP_BLKDEV) &&
+			disk->fops->swap_slot_free_notify)
+		disk->fops->swap_slot_free_notify(p->bdev, offset);
+}
+
 /*
  * Caller has made sure that the swapdevice corresponding to entry
  * is still around or has not been recycled.
@@ -663,10 +770,10 @@ void swap_free(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
 
-	p = swap_info_get(entry);
+	p = _swap_info_get(entry);
 	if (p) {
-		swap_entry_free(p, entry, 1);
-		spin_unlock(&p->lock);
+		if (!__swap_entry_free(p, entry, 1))
+			free_swap_slot(entry);
 	}
 }
 
@@ -678,15 +785,44 @@ void swapcache_free(swp_entry_t entry, struct page *page)
 	struct swap_info_struct *p;
 	unsigned char count;
 
-	p = swap_info_get(entry);
+	p = _swap_info_get(entry);
 	if (p) {
-		count = swap_entry_free(p, entry, SWAP_HAS_CACHE);
+		count = __swap_entry_free(p, entry, SWAP_HAS_CACHE);
 		if (page)
 			mem_cgroup_uncharge_swapcache(page, entry, count != 0);
-		spin_unlock(&p->lock);
+		if (!count)
+			free_swap_slot(entry);
 	}
 }
 
+/*
+ * Free a batch of unreferenced swap entries, as collected by the swap
+ * slots caches: the swap area lock is only retaken when the batch moves
+ * on to another swap area.
+ */
+void swapcache_free_entries(swp_entry_t *entries, int n)
+{
+	struct swap_info_struct *p, *prev;
+	int i;
+
+	prev = NULL;
+	p = NULL;
+	for (i = 0; i < n; i++) {
+		p = _swap_info_get(entries[i]);
+		if (p != prev) {
+			if (prev)
+				spin_unlock(&prev->lock);
+			if (p)
+				spin_lock(&p->lock);
+		}
+		if (p)
+			swap_entry_free(p, entries[i]);
+		prev = p;
+	}
+	if (p)
+		spin_unlock(&p->lock);
+}
+
 /*
  * How many references to page are currently swapped out?
  * This does not give an exact answer when swap count is continued,
@@ -696,17 +832,47 @@ int page_swapcount(struct page *page)
 {
 	int count = 0;
 	struct swap_info_struct *p;
+	struct swap_cluster_info *ci;
 	swp_entry_t entry;
+	unsigned long offset;
 
 	entry.val = page_private(page);
-	p = swap_info_get(entry);
+	p = _swap_info_get(entry);
 	if (p) {
-		count = swap_count(p->swap_map[swp_offset(entry)]);
-		spin_unlock(&p->lock);
+		offset = swp_offset(entry);
+		ci = lock_cluster(p, offset);
+		count = swap_count(p->swap_map[offset]);
+		unlock_cluster(ci);
 	}
 	return count;
 }
 
+/*
+ * Like page_swapcount(), but for a swap entry which may not be in use:
+ * returns 0 for free, bad and freeing entries.  Used to skip readahead
+ * of entries which nobody will ever fault on.
+ */
+int __swp_swapcount(swp_entry_t entry)
+{
+	int count = 0;
+	struct swap_info_struct *p;
+	struct swap_cluster_info *ci;
+	unsigned long offset;
+
+	if (non_swap_entry(entry) || swp_type(entry) >= nr_swapfiles)
+		return 0;
+	p = swap_info[swp_type(entry)];
+	offset = swp_offset(entry);
+	if (!(p->flags & SWP_WRITEOK) || offset >= p->max)
+		return 0;
+	ci = lock_cluster(p, offset);
+	count = swap_count(p->swap_map[offset]);
+	unlock_cluster(ci);
+	if (count == SWAP_MAP_BAD)
+		count = 0;
+	return count;
+}
+
 /*
  * How many references to @entry are currently swapped out?
  * This considers COUNT_CONTINUED so it returns exact answer.
@@ -715,14 +881,16 @@ int swp_swapcount(swp_entry_t entry)
 {
 	int count, tmp_count, n;
 	struct swap_info_struct *p;
+	struct swap_cluster_info *ci;
 	struct page *page;
 	pgoff_t offset;
 	unsigned char *map;
 
-	p = swap_info_get(entry);
+	p = _swap_info_get(entry);
 	if (!p)
 		return 0;
 
+	ci = lock_cluster(p, swp_offset(entry));
 	count = swap_count(p->swap_map[swp_offset(entry)]);
 	if (!(count & COUNT_CONTINUED))
 		goto out;
@@ -735,6 +903,11 @@ int swp_swapcount(swp_entry_t entry)
 	offset &= ~PAGE_MASK;
 	VM_BUG_ON(page_private(page) != SWP_CONTINUED);
 
+	/*
+	 * The continuation list is shared with the other clusters of this
+	 * swap_map page, add_swap_count_continuation() may be extending it.
+	 */
+	spin_lock(&p->cont_lock);
 	do {
 		page = list_entry(page->lru.next, struct page, lru);
 		map = kmap_atomic(page);
@@ -744,8 +917,9 @@ int swp_swapcount(swp_entry_t entry)
 		count += (tmp_count & ~COUNT_CONTINUED) * n;
 		n *= (SWAP_CONT_MAX + 1);
 	} while (tmp_count & COUNT_CONTINUED);
+	spin_unlock(&p->cont_lock);
 out:
-	spin_unlock(&swap_lock);
+	unlock_cluster(ci);
 	return count;
 }
 
@@ -819,21 +993,23 @@ int free_swap_and_cache(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
 	struct page *page = NULL;
+	unsigned char count;
 
 	if (non_swap_entry(entry))
 		return 1;
 
-	p = swap_info_get(entry);
+	p = _swap_info_get(entry);
 	if (p) {
-		if (swap_entry_free(p, entry, 1) == SWAP_HAS_CACHE) {
+		count = __swap_entry_free(p, entry, 1);
+		if (count == SWAP_HAS_CACHE) {
 			page = find_get_page(swap_address_space(entry),
 						entry.val);
 			if (page && !trylock_page(page)) {
 				page_cache_release(page);
 				page = NULL;
 			}
-		}
-		spin_unlock(&p->lock);
+		} else if (!count)
+			free_swap_slot(entry);
 	}
 	if (page) {
 		/*
@@ -1244,8 +1420,10 @@ static int try_to_unuse(unsigned int type)
 			 * has been freed independently, and will not be
 			 * reused since sys_swapoff() already disabled
 			 * allocation from here, or alloc_page() failed.
+			 * A freed entry may also still be waiting in a
+			 * swap slots cache for its final release.
 			 */
-			if (!*swap_map)
+			if (!*swap_map || *swap_map == SWAP_MAP_FREEING)
 				continue;
 			retval = -ENOMEM;
 			break;
@@ -1700,6 +1878,8 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 {
 	struct swap_info_struct *p = NULL;
 	unsigned char *swap_map;
+	struct swap_cluster_info *cluster_info;
+	struct percpu_cluster __percpu *percpu_cluster;
 	struct file *swap_file, *victim;
 	struct address_space *mapping;
 	struct inode *inode;
@@ -1767,6 +1947,11 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	spin_unlock(&p->lock);
 	spin_unlock(&swap_lock);
 
+	/*
+	 * Return the entries held in the swap slots caches, and keep them
+	 * bypassed, so that none of ours stays out of try_to_unuse()'s reach.
+	 */
+	disable_swap_slots_cache();
 	oom_score_adj = test_set_oom_score_adj(OOM_SCORE_ADJ_MAX);
 #ifdef CONFIG_FRONTSWAP
 	err = try_to_unuse(type, false, 0); /* force all pages to be unused */
@@ -1774,6 +1959,7 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	err = try_to_unuse(type);
 #endif
 	compare_swap_oom_score_adj(OOM_SCORE_ADJ_MAX, oom_score_adj);
+	reenable_swap_slots_cache();
 
 	if (err) {
 		/*
@@ -1815,6 +2001,10 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->max = 0;
 	swap_map = p->swap_map;
 	p->swap_map = NULL;
+	cluster_info = p->cluster_info;
+	p->cluster_info = NULL;
+	percpu_cluster = p->percpu_cluster;
+	p->percpu_cluster = NULL;
 	p->flags = 0;
 	spin_unlock(&p->lock);
 #ifdef CONFIG_FRONTSWAP
@@ -1823,6 +2013,8 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	spin_unlock(&swap_lock);
 	mutex_unlock(&swapon_mutex);
 	vfree(swap_map);
+	vfree(cluster_info);
+	free_percpu(percpu_cluster);
 #ifdef CONFIG_FRONTSWAP
 	vfree(frontswap_map_get(p));
 #endif
@@ -2027,6 +2219,7 @@ static struct swap_info_struct *alloc_swap_info(void)
 	p->next = -1;
 	spin_unlock(&swap_lock);
 	spin_lock_init(&p->lock);
+	spin_lock_init(&p->cont_lock);
 
 	return p;
 }
@@ -2172,6 +2365,39 @@ static int setup_swap_map_and_extents(struct swap_info_struct *p,
 	return nr_extents;
 }
 
+/*
+ * Allocate the cluster locks and usage counts once p->max is final, plus
+ * the per cpu cluster cursors on solid state swap without discard (the
+ * discard logic of scan_swap_map() relies on a single shared cluster).
+ * The header, bad pages and the tail of a partial last cluster are counted
+ * as in use, so that such clusters are never taken for free ones.
+ */
+static int setup_swap_clusters(struct swap_info_struct *p,
+			       unsigned char *swap_map)
+{
+	unsigned long nr_clusters = DIV_ROUND_UP(p->max, SWAPFILE_CLUSTER);
+	unsigned long i;
+
+	p->cluster_info = vzalloc(nr_clusters * sizeof(*p->cluster_info));
+	if (!p->cluster_info)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_clusters; i++)
+		spin_lock_init(&p->cluster_info[i].lock);
+	for (i = 0; i < p->max; i++)
+		if (swap_map[i])
+			p->cluster_info[i / SWAPFILE_CLUSTER].count++;
+	p->cluster_info[nr_clusters - 1].count +=
+				nr_clusters * SWAPFILE_CLUSTER - p->max;
+
+	if ((p->flags & SWP_SOLIDSTATE) && !(p->flags & SWP_DISCARDABLE)) {
+		p->percpu_cluster = alloc_percpu(struct percpu_cluster);
+		if (!p->percpu_cluster)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
 SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 {
 	struct swap_info_struct *p;
@@ -2292,6 +2518,10 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	if (p->bdev && blk_queue_fast(bdev_get_queue(p->bdev)))
 		p->flags |= SWP_FAST;
 
+	error = setup_swap_clusters(p, swap_map);
+	if (error)
+		goto bad_swap;
+
 	mutex_lock(&swapon_mutex);
 	prio = -1;
 	if (swap_flags & SWAP_FLAG_PREFER)
@@ -2324,6 +2554,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	atomic_inc(&proc_poll_event);
 	wake_up_interruptible(&proc_poll_wait);
 
+	enable_swap_slots_cache();
+
 	if (S_ISREG(inode->i_mode))
 		inode->i_flags |= S_SWAPFILE;
 	error = 0;
@@ -2335,6 +2567,10 @@ bad_swap:
 	}
 	destroy_swap_extents(p);
 	swap_cgroup_swapoff(p->type);
+	free_percpu(p->percpu_cluster);
+	p->percpu_cluster = NULL;
+	vfree(p->cluster_info);
+	p->cluster_info = NULL;
 	spin_lock(&swap_lock);
 	p->swap_file = NULL;
 	p->flags = 0;
@@ -2390,6 +2626,7 @@ void si_swapinfo(struct sysinfo *val)
 static int __swap_duplicate(swp_entry_t entry, unsigned char usage)
 {
 	struct swap_info_struct *p;
+	struct swap_cluster_info *ci;
 	unsigned long offset, type;
 	unsigned char count;
 	unsigned char has_cache;
@@ -2403,12 +2640,21 @@ static int __swap_duplicate(swp_entry_t entry, unsigned char usage)
 		goto bad_file;
 	p = swap_info[type];
 	offset = swp_offset(entry);
-
-	spin_lock(&p->lock);
 	if (unlikely(offset >= p->max))
-		goto unlock_out;
+		goto out;
 
+	ci = lock_cluster(p, offset);
 	count = p->swap_map[offset];
+
+	/*
+	 * A bad entry, or a freed one still parked in a swap slots cache,
+	 * cannot be duplicated nor given a swap cache page.
+	 */
+	if (unlikely(swap_count(count) == SWAP_MAP_BAD)) {
+		err = -ENOENT;
+		goto unlock_out;
+	}
+
 	has_cache = count & SWAP_HAS_CACHE;
 	count &= ~SWAP_HAS_CACHE;
 	err = 0;
@@ -2439,7 +2685,7 @@ static int __swap_duplicate(swp_entry_t entry, unsigned char usage)
 	p->swap_map[offset] = count | has_cache;
 
 unlock_out:
-	spin_unlock(&p->lock);
+	unlock_cluster(ci);
 out:
 	return err;
 
@@ -2529,6 +2775,7 @@ EXPORT_SYMBOL_GPL(__page_file_index);
 int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 {
 	struct swap_info_struct *si;
+	struct swap_cluster_info *ci;
 	struct page *head;
 	struct page *page;
 	struct page *list_page;
@@ -2552,6 +2799,7 @@ int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 	}
 
 	offset = swp_offset(entry);
+	ci = lock_cluster(si, offset);
 	count = si->swap_map[offset] & ~SWAP_HAS_CACHE;
 
 	if ((count & ~COUNT_CONTINUED) != SWAP_MAP_MAX) {
@@ -2564,6 +2812,7 @@ int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 	}
 
 	if (!page) {
+		unlock_cluster(ci);
 		spin_unlock(&si->lock);
 		return -ENOMEM;
 	}
@@ -2576,6 +2825,7 @@ int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 	head = vmalloc_to_page(si->swap_map + offset);
 	offset &= ~PAGE_MASK;
 
+	spin_lock(&si->cont_lock);
 	/*
 	 * Page allocation does not initialize the page's lru field,
 	 * but it does always reset its private field.
@@ -2595,7 +2845,7 @@ int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 		 * a continuation page, free our allocation and use this one.
 		 */
 		if (!(count & COUNT_CONTINUED))
-			goto out;
+			goto out_unlock_cont;
 
 		map = kmap_atomic(list_page) + offset;
 		count = *map;
@@ -2606,12 +2856,15 @@ int add_swap_count_continuation(swp_entry_t entry, gfp_t gfp_mask)
 		 * free our allocation and use this one.
 		 */
 		if ((count & ~COUNT_CONTINUED) != SWAP_CONT_MAX)
-			goto out;
+			goto out_unlock_cont;
 	}
 
 	list_add_tail(&page->lru, &head->lru);
 	page = NULL;			/* now it's attached, don't free it */
+out_unlock_cont:
+	spin_unlock(&si->cont_lock);
 out:
+	unlock_cluster(ci);
 	spin_unlock(&si->lock);
 outer:
 	if (page)
@@ -2625,7 +2878,9 @@ outer:
  * into, carry if so, or else fail until a new continuation page is allocated;
  * when the original swap_map count is decremented from 0 with continuation,
  * borrow from the continuation and report whether it still holds more.
- * Called while __swap_duplicate() or swap_entry_free() holds swap_lock.
+ * Called while __swap_duplicate() or __swap_entry_free() holds the cluster
+ * lock; the continuation pages of a swap_map page are shared with the
+ * other clusters it covers, so their list is guarded by si->cont_lock.
  */
 static bool swap_count_continued(struct swap_info_struct *si,
 				 pgoff_t offset, unsigned char count)
@@ -2633,6 +2888,7 @@ static bool swap_count_continued(struct swap_info_struct *si,
 	struct page *head;
 	struct page *page;
 	unsigned char *map;
+	bool ret;
 
 	head = vmalloc_to_page(si->swap_map + offset);
 	if (page_private(head) != SWP_CONTINUED) {
@@ -2640,6 +2896,7 @@ static bool swap_count_continued(struct swap_info_struct *si,
 		return false;		/* need to add count continuation */
 	}
 
+	spin_lock(&si->cont_lock);
 	offset &= ~PAGE_MASK;
 	page = list_entry(head->lru.next, struct page, lru);
 	map = kmap_atomic(page) + offset;
@@ -2660,8 +2917,10 @@ static bool swap_count_continued(struct swap_info_struct *si,
 		if (*map == SWAP_CONT_MAX) {
 			kunmap_atomic(map);
 			page = list_entry(page->lru.next, struct page, lru);
-			if (page == head)
-				return false;	/* add count continuation */
+			if (page == head) {
+				ret = false;	/* add count continuation */
+				goto out;
+			}
 			map = kmap_atomic(page) + offset;
 init_map:		*map = 0;		/* we didn't zero the page */
 		}
@@ -2674,7 +2933,7 @@ init_map:		*map = 0;		/* we didn't zero the page */
 			kunmap_atomic(map);
 			page = list_entry(page->lru.prev, struct page, lru);
 		}
-		return true;			/* incremented */
+		ret = true;			/* incremented */
 
 	} else {				/* decrementing */
 		/*
@@ -2700,8 +2959,11 @@ init_map:		*map = 0;		/* we didn't zero the page */
 			kunmap_atomic(map);
 			page = list_entry(page->lru.prev, struct page, lru);
 		}
-		return count == COUNT_CONTINUED;
+		ret = count == COUNT_CONTINUED;
 	}
+out:
+	spin_unlock(&si->cont_lock);
+	return ret;
 }
 
 /*
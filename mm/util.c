@@ -192,6 +192,45 @@ void kzfree(const void *p)
 }
 EXPORT_SYMBOL(kzfree);
 
+#ifndef CONFIG_SLUB
+/*
+ * Generic bulk interface for the allocators that have no batched fast path
+ * of their own: fall back to handling one object at a time.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (p[i])
+			kmem_cache_free(s, p[i]);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		p[i] = kmem_cache_alloc(s, flags);
+		if (!p[i]) {
+			kmem_cache_free_bulk(s, i, p);
+			return 0;
+		}
+	}
+	return size;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
+bool kmem_cache_debugged(struct kmem_cache *s)
+{
+	return IS_ENABLED(CONFIG_DEBUG_SLAB) ||
+	       IS_ENABLED(CONFIG_DEBUG_KMEMLEAK);
+}
+EXPORT_SYMBOL(kmem_cache_debugged);
+#endif
+
 /*
  * strndup_user - duplicate an existing string from user space
  * @s: The string to duplicate
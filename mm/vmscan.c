@@ -44,6 +44,7 @@
 #include <linux/oom.h>
 #include <linux/prefetch.h>
 #include <linux/debugfs.h>
+#include <linux/memory_hotplug.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -100,6 +101,13 @@ struct scan_control {
 	 * are scanned.
 	 */
 	nodemask_t	*nodemask;
+
+	/*
+	 * The kswapd threads of a node share out the LRU scanning, this
+	 * is thread kswapd_id of kswapd_nr.  Below 2, scan everything.
+	 */
+	int kswapd_id;
+	int kswapd_nr;
 };
 
 struct mem_cgroup_zone {
@@ -577,6 +585,10 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		/* A readahead marker nobody reached, see ra_retire_window() */
+		if (PageReadahead(page))
+			mapping->nr_ra_evicted++;
+
 		__delete_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -834,7 +846,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, TTU_UNMAP)) {
+			switch (try_to_unmap(page,
+					TTU_UNMAP | TTU_BATCH_FLUSH)) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -876,7 +889,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
-			/* Page is dirty, try to write it out here */
+			/*
+			 * Page is dirty.  Flush the TLB if a writable entry
+			 * may still exist, so the cpu cannot write to the
+			 * page once IO has started, and write it out here.
+			 */
+			try_to_unmap_flush_dirty();
 			switch (pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
 				nr_congested++;
@@ -996,6 +1014,7 @@ keep:
 	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc))
 		zone_set_flag(mz->zone, ZONE_CONGESTED);
 
+	try_to_unmap_flush();
 	free_hot_cold_page_list(&free_pages, 1);
 
 	list_splice(&ret_pages, page_list);
@@ -1147,6 +1166,417 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 	return nr_taken;
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-generation LRU
+ *
+ * Instead of an active and an inactive list, the evictable pages of each
+ * lruvec are kept on generation lists, one per generation and type (anon
+ * or file).  Generations are numbered by sequence: max_seq is the youngest
+ * and min_seq[type] the oldest that still holds pages of that type.
+ *
+ * Activated pages (faulted in, or used twice through mark_page_accessed())
+ * start in the youngest generation and other pages in the one after the
+ * oldest.  Reclaim evicts from the oldest generation, through the usual
+ * shrink_page_list(); pages it finds referenced are activated and so move
+ * to the youngest.  Once only the MIN_NR_GENS youngest generations are
+ * left, the lruvec is aged: a new generation is created, and kswapd walks
+ * the page tables of all processes, moving every page mapped by a young
+ * pte into it.  One walk clears the accessed bits of a whole page table
+ * under a single lru_lock and flushes the TLB once per mm, where the
+ * two-list LRU looked up the mappings of each page through rmap in
+ * shrink_active_list() and flushed them one at a time.
+ *
+ * The generation of a page is only recorded by the list it is on, so the
+ * per-zone and per-memcg LRU sizes still follow PG_active.
+ */
+bool lru_gen_on __read_mostly = IS_ENABLED(CONFIG_LRU_GEN_ENABLED);
+
+static int __init setup_lru_gen(char *str)
+{
+	if (!str)
+		return -EINVAL;
+	return strtobool(str, &lru_gen_on);
+}
+early_param("lru_gen", setup_lru_gen);
+
+void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+	struct lru_gen *lrugen = &lruvec->lrugen;
+	int gen, type;
+
+	lrugen->max_seq = MIN_NR_GENS;
+	lrugen->min_seq[0] = 0;
+	lrugen->min_seq[1] = 0;
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		lrugen->timestamps[gen] = jiffies;
+		for (type = 0; type < 2; type++)
+			INIT_LIST_HEAD(&lrugen->lists[gen][type]);
+	}
+}
+
+/* Every user mm, for the page table walks of aging */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	INIT_LIST_HEAD(&mm->lru_gen_list);
+	if (!lru_gen_enabled())
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	if (list_empty(&mm->lru_gen_list))
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_del_init(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/* Retire the oldest generations of @type once eviction emptied them. */
+static void lru_gen_inc_min_seq(struct lru_gen *lrugen, int type)
+{
+	while (lrugen->min_seq[type] + MIN_NR_GENS <= lrugen->max_seq) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		if (!list_empty(&lrugen->lists[gen][type]))
+			break;
+		lrugen->min_seq[type]++;
+	}
+}
+
+/*
+ * Open a new youngest generation.  A type still using all MAX_NR_GENS
+ * generations has its oldest folded into the next one to make room, at
+ * the tail so that those pages are still evicted first.
+ */
+static void lru_gen_inc_max_seq(struct lru_gen *lrugen)
+{
+	int type, gen;
+
+	for (type = 0; type < 2; type++) {
+		int next;
+
+		lru_gen_inc_min_seq(lrugen, type);
+		if (lrugen->max_seq + 1 - lrugen->min_seq[type] < MAX_NR_GENS)
+			continue;
+
+		gen = lru_gen_from_seq(lrugen->min_seq[type]);
+		next = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+		list_splice_tail_init(&lrugen->lists[gen][type],
+				      &lrugen->lists[next][type]);
+		lrugen->min_seq[type]++;
+	}
+
+	lrugen->max_seq++;
+	gen = lru_gen_from_seq(lrugen->max_seq);
+	lrugen->timestamps[gen] = jiffies;
+}
+
+struct lru_gen_walk {
+	struct vm_area_struct *vma;
+	struct zone *zone;
+	unsigned long nr_young;
+};
+
+/*
+ * Clear the accessed bits of the ptes mapping pages of the zone being
+ * aged, and move those pages to the youngest generation of their lruvec.
+ * The lru_lock is taken once per page table; the TLB is flushed once per
+ * mm by lru_gen_walk_mm().
+ */
+static int lru_gen_walk_pmd(pmd_t *pmd, unsigned long addr,
+			    unsigned long end, struct mm_walk *walk)
+{
+	struct lru_gen_walk *args = walk->private;
+	struct vm_area_struct *vma = args->vma;
+	struct zone *zone = args->zone;
+	bool locked = false;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+
+	split_huge_page_pmd(walk->mm, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct lruvec *lruvec;
+		struct lru_gen *lrugen;
+		struct page *page;
+		enum lru_list lru;
+		int gen;
+
+		if (!pte_present(ptent) || !pte_young(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || page_zone(page) != zone)
+			continue;
+
+		if (!ptep_test_and_clear_young(vma, addr, pte))
+			continue;
+		args->nr_young++;
+
+		if (!locked) {
+			spin_lock_irq(&zone->lru_lock);
+			locked = true;
+		}
+		if (!PageLRU(page) || PageUnevictable(page))
+			continue;
+
+		lru = page_lru(page);
+		lruvec = mem_cgroup_lru_move_lists(zone, page, lru, lru);
+		lrugen = &lruvec->lrugen;
+		gen = lru_gen_from_seq(lrugen->max_seq);
+		list_move(&page->lru, &lrugen->lists[gen][is_file_lru(lru)]);
+	}
+	if (locked)
+		spin_unlock_irq(&zone->lru_lock);
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct zone *zone)
+{
+	struct lru_gen_walk args = {
+		.zone = zone,
+	};
+	struct mm_walk walk = {
+		.pmd_entry = lru_gen_walk_pmd,
+		.mm = mm,
+		.private = &args,
+	};
+	struct vm_area_struct *vma;
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma) ||
+		    (vma->vm_flags & (VM_LOCKED | VM_IO | VM_PFNMAP)))
+			continue;
+		args.vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &walk);
+	}
+
+	if (args.nr_young)
+		flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Age the lruvec of @mz if evicting pages of @type would otherwise reach
+ * into its MIN_NR_GENS youngest generations.  Only kswapd walks the page
+ * tables: direct reclaimers just open a new generation, and leave finding
+ * the pages still in use to shrink_page_list().
+ */
+static void lru_gen_age(struct mem_cgroup_zone *mz, int type)
+{
+	struct zone *zone = mz->zone;
+	struct lru_gen *lrugen;
+	struct mm_struct *mm, *prev = NULL;
+	struct list_head *pos;
+
+	lrugen = &mem_cgroup_zone_lruvec(zone, mz->mem_cgroup)->lrugen;
+
+	spin_lock_irq(&zone->lru_lock);
+	lru_gen_inc_min_seq(lrugen, type);
+	if (lrugen->min_seq[type] + MIN_NR_GENS <= lrugen->max_seq) {
+		spin_unlock_irq(&zone->lru_lock);
+		return;
+	}
+	lru_gen_inc_max_seq(lrugen);
+	spin_unlock_irq(&zone->lru_lock);
+
+	if (!current_is_kswapd())
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	pos = &lru_gen_mm_list;
+	while (pos->next != &lru_gen_mm_list) {
+		pos = pos->next;
+		mm = list_entry(pos, struct mm_struct, lru_gen_list);
+		/* A pinned mm stays on the list while the lock is dropped */
+		if (!atomic_inc_not_zero(&mm->mm_users))
+			continue;
+		spin_unlock(&lru_gen_mm_lock);
+
+		if (prev)
+			mmput(prev);
+		lru_gen_walk_mm(mm, zone);
+		prev = mm;
+
+		spin_lock(&lru_gen_mm_lock);
+	}
+	spin_unlock(&lru_gen_mm_lock);
+
+	if (prev)
+		mmput(prev);
+}
+
+/*
+ * Take up to @nr_to_scan pages of the type of @lru from the oldest
+ * generations of the lruvec of @mz that may be evicted.  The counterpart
+ * of isolate_lru_pages(), whose arguments and return value it shares.
+ */
+static unsigned long lru_gen_isolate_pages(unsigned long nr_to_scan,
+		struct mem_cgroup_zone *mz, struct list_head *dst,
+		unsigned long *nr_scanned, struct scan_control *sc,
+		isolate_mode_t mode, enum lru_list lru)
+{
+	struct lru_gen *lrugen;
+	unsigned long nr_taken = 0;
+	unsigned long scan;
+	int file = is_file_lru(lru);
+
+	lrugen = &mem_cgroup_zone_lruvec(mz->zone, mz->mem_cgroup)->lrugen;
+
+	for (scan = 0; scan < nr_to_scan; scan++) {
+		struct list_head *src;
+		struct page *page;
+		int gen;
+
+		lru_gen_inc_min_seq(lrugen, file);
+		if (lrugen->min_seq[file] + MIN_NR_GENS > lrugen->max_seq)
+			break;
+
+		gen = lru_gen_from_seq(lrugen->min_seq[file]);
+		src = &lrugen->lists[gen][file];
+		page = lru_to_page(src);
+		prefetchw_prev_lru_page(page, src, flags);
+
+		VM_BUG_ON(!PageLRU(page));
+
+		switch (__isolate_lru_page(page, mode)) {
+		case 0:
+			mem_cgroup_lru_del_list(page, page_lru(page));
+			list_move(&page->lru, dst);
+			nr_taken += hpage_nr_pages(page);
+			break;
+
+		case -EBUSY:
+			/* else it is being freed elsewhere */
+			list_move(&page->lru, src);
+			continue;
+
+		default:
+			BUG();
+		}
+	}
+
+	*nr_scanned = scan;
+
+	trace_mm_vmscan_lru_isolate(sc->order,
+			nr_to_scan, scan,
+			nr_taken,
+			mode, file);
+	return nr_taken;
+}
+
+static unsigned short lru_gen_memcg_id(struct mem_cgroup *memcg)
+{
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	if (memcg)
+		return css_id(mem_cgroup_css(memcg));
+#endif
+	return 0;
+}
+
+/*
+ * /sys/kernel/debug/lru_gen: for each lruvec, the sequence number, age
+ * and number of anon and file pages of every live generation.  Pages are
+ * counted by walking the lists, so this is for debugging only.
+ */
+static int lru_gen_show(struct seq_file *s, void *unused)
+{
+	struct zone *zone;
+
+	seq_printf(s, "# %8s %10s %10s %10s\n", "seq", "age_ms", "anon",
+		   "file");
+	for_each_populated_zone(zone) {
+		struct mem_cgroup *memcg = mem_cgroup_iter(NULL, NULL, NULL);
+
+		do {
+			struct lru_gen *lrugen;
+			unsigned long seq;
+
+			lrugen = &mem_cgroup_zone_lruvec(zone, memcg)->lrugen;
+			seq_printf(s, "memcg %hu node %d zone %s\n",
+				   lru_gen_memcg_id(memcg), zone_to_nid(zone),
+				   zone->name);
+
+			spin_lock_irq(&zone->lru_lock);
+			for (seq = min(lrugen->min_seq[0], lrugen->min_seq[1]);
+			     seq <= lrugen->max_seq; seq++) {
+				int gen = lru_gen_from_seq(seq);
+				unsigned long nr[2] = { 0, 0 };
+				struct page *page;
+				int type;
+
+				for (type = 0; type < 2; type++) {
+					if (seq < lrugen->min_seq[type])
+						continue;
+					list_for_each_entry(page,
+						&lrugen->lists[gen][type], lru)
+						nr[type] += hpage_nr_pages(page);
+				}
+				seq_printf(s, "  %8lu %10u %10lu %10lu\n", seq,
+					   jiffies_to_msecs(jiffies -
+						lrugen->timestamps[gen]),
+					   nr[0], nr[1]);
+			}
+			spin_unlock_irq(&zone->lru_lock);
+
+			memcg = mem_cgroup_iter(NULL, memcg, NULL);
+		} while (memcg);
+	}
+	return 0;
+}
+
+static int lru_gen_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_show, inode->i_private);
+}
+
+static const struct file_operations lru_gen_fops = {
+	.open = lru_gen_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init lru_gen_debug_init(void)
+{
+	if (lru_gen_enabled())
+		debugfs_create_file("lru_gen", 0444, NULL, NULL,
+				    &lru_gen_fops);
+	return 0;
+}
+late_initcall(lru_gen_debug_init);
+#else
+static inline void lru_gen_age(struct mem_cgroup_zone *mz, int type)
+{
+}
+
+static inline unsigned long lru_gen_isolate_pages(unsigned long nr_to_scan,
+		struct mem_cgroup_zone *mz, struct list_head *dst,
+		unsigned long *nr_scanned, struct scan_control *sc,
+		isolate_mode_t mode, enum lru_list lru)
+{
+	return 0;
+}
+#endif /* CONFIG_LRU_GEN */
+
 /**
  * isolate_lru_page - tries to isolate a page from its LRU list
  * @page: page to isolate from its LRU list
@@ -1361,8 +1791,12 @@ shrink_inactive_list(unsigned long nr_to_scan, struct mem_cgroup_zone *mz,
 
 	spin_lock_irq(&zone->lru_lock);
 
-	nr_taken = isolate_lru_pages(nr_to_scan, mz, &page_list, &nr_scanned,
-				     sc, isolate_mode, lru);
+	if (lru_gen_enabled())
+		nr_taken = lru_gen_isolate_pages(nr_to_scan, mz, &page_list,
+					&nr_scanned, sc, isolate_mode, lru);
+	else
+		nr_taken = isolate_lru_pages(nr_to_scan, mz, &page_list,
+					&nr_scanned, sc, isolate_mode, lru);
 	if (global_reclaim(sc)) {
 		zone->pages_scanned += nr_scanned;
 		if (current_is_kswapd())
@@ -1698,6 +2132,9 @@ static unsigned long shrink_list(enum lru_list lru, unsigned long nr_to_scan,
 		return 0;
 	}
 
+	if (lru_gen_enabled())
+		lru_gen_age(mz, file);
+
 	return shrink_inactive_list(nr_to_scan, mz, sc, lru);
 }
 
@@ -1832,6 +2269,38 @@ out:
 	}
 }
 
+/*
+ * With several kswapd threads on a node, even threads scan the file lists
+ * and odd ones the anon lists, where compressing pages for zram is the cost
+ * worth spreading.  The threads on the same lists each take an equal part
+ * of the targets, so that together they put the pressure of one kswapd on
+ * the zone.  A thread with nothing to scan on its own lists, without swap
+ * say, takes its part of all the targets instead of spinning.
+ */
+static void kswapd_split_scan(struct scan_control *sc, unsigned long *nr)
+{
+	int file = !(sc->kswapd_id & 1);
+	int share = (sc->kswapd_nr + file) / 2;
+	unsigned long own = 0;
+	enum lru_list lru;
+
+	if (sc->kswapd_nr < 2)
+		return;
+
+	for_each_evictable_lru(lru)
+		if (is_file_lru(lru) == file)
+			own += nr[lru];
+
+	for_each_evictable_lru(lru) {
+		if (!own)
+			nr[lru] = DIV_ROUND_UP(nr[lru], sc->kswapd_nr);
+		else if (is_file_lru(lru) == file)
+			nr[lru] = DIV_ROUND_UP(nr[lru], share);
+		else
+			nr[lru] = 0;
+	}
+}
+
 /* Use reclaim/compaction for costly allocs or under memory pressure */
 static bool in_reclaim_compaction(struct scan_control *sc)
 {
@@ -1924,6 +2393,15 @@ restart:
 	nr_reclaimed = 0;
 	nr_scanned = sc->nr_scanned;
 	get_scan_count(mz, sc, nr);
+	kswapd_split_scan(sc, nr);
+
+	/* Generations replace the active lists: scan each type as a whole */
+	if (lru_gen_enabled()) {
+		nr[LRU_INACTIVE_ANON] += nr[LRU_ACTIVE_ANON];
+		nr[LRU_INACTIVE_FILE] += nr[LRU_ACTIVE_FILE];
+		nr[LRU_ACTIVE_ANON] = 0;
+		nr[LRU_ACTIVE_FILE] = 0;
+	}
 
 	blk_start_plug(&plug);
 	while (nr[LRU_INACTIVE_ANON] || nr[LRU_ACTIVE_FILE] ||
@@ -1957,7 +2435,7 @@ restart:
 	 * Even if we did not try to evict anon pages at all, we want to
 	 * rebalance the anon lru active/inactive ratio.
 	 */
-	if (inactive_anon_is_low(mz))
+	if (!lru_gen_enabled() && inactive_anon_is_low(mz))
 		shrink_active_list(SWAP_CLUSTER_MAX, mz,
 				   sc, LRU_ACTIVE_ANON);
 
@@ -2411,7 +2889,7 @@ static void age_active_anon(struct zone *zone, struct scan_control *sc)
 {
 	struct mem_cgroup *memcg;
 
-	if (!total_swap_pages)
+	if (!total_swap_pages || lru_gen_enabled())
 		return;
 
 	memcg = mem_cgroup_iter(NULL, NULL, NULL);
@@ -2543,9 +3021,10 @@ static bool sleeping_prematurely(pg_data_t *pgdat, int order, long remaining,
  * interoperates with the page allocator fallback scheme to ensure that aging
  * of pages is balanced across the zones.
  */
-static unsigned long balance_pgdat(pg_data_t *pgdat, int order,
+static unsigned long balance_pgdat(struct kswapd_thread *kt, int order,
 							int *classzone_idx)
 {
+	pg_data_t *pgdat = kt->pgdat;
 	struct zone *unbalanced_zone;
 	unsigned long balanced;
 	int i;
@@ -2566,6 +3045,7 @@ static unsigned long balance_pgdat(pg_data_t *pgdat, int order,
 		.order = order,
 		.swappiness = vm_swappiness,
 		.target_mem_cgroup = NULL,
+		.kswapd_id = kt->id,
 	};
 	struct shrink_control shrink = {
 		.gfp_mask = sc.gfp_mask,
@@ -2575,6 +3055,7 @@ loop_again:
 	sc.priority = DEF_PRIORITY;
 	sc.nr_reclaimed = 0;
 	sc.may_writepage = !laptop_mode;
+	sc.kswapd_nr = max(ACCESS_ONCE(kswapd_threads), kt->id + 1);
 	count_vm_event(PAGEOUTRUN);
 
 	do {
@@ -2601,8 +3082,10 @@ loop_again:
 			/*
 			 * Do some background aging of the anon list, to give
 			 * pages a chance to be referenced before reclaiming.
+			 * The other kswapd threads leave it to the first.
 			 */
-			age_active_anon(zone, &sc);
+			if (!kt->id)
+				age_active_anon(zone, &sc);
 
 			/*
 			 * If the number of buffer_heads in the machine
@@ -2657,13 +3140,16 @@ loop_again:
 
 			nr_soft_scanned = 0;
 			/*
-			 * Call soft limit reclaim before calling shrink_zone.
+			 * Call soft limit reclaim before calling shrink_zone,
+			 * from the first kswapd thread only.
 			 */
-			nr_soft_reclaimed = mem_cgroup_soft_limit_reclaim(zone,
-							order, sc.gfp_mask,
+			if (!kt->id) {
+				nr_soft_reclaimed = mem_cgroup_soft_limit_reclaim(
+							zone, order, sc.gfp_mask,
 							&nr_soft_scanned);
-			sc.nr_reclaimed += nr_soft_reclaimed;
-			total_scanned += nr_soft_scanned;
+				sc.nr_reclaimed += nr_soft_reclaimed;
+				total_scanned += nr_soft_scanned;
+			}
 
 			/*
 			 * We put equal pressure on every zone, unless
@@ -2837,7 +3323,7 @@ out:
 			zone_clear_flag(zone, ZONE_CONGESTED);
 		}
 
-		if (zones_need_compaction)
+		if (zones_need_compaction && !kt->id)
 			compact_pgdat(pgdat, order);
 	}
 
@@ -2851,9 +3337,101 @@ out:
 	return order;
 }
 
-static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
+/*
+ * Number of kswapd threads per node.  Each keeps its own copy of the
+ * wakeup_kswapd() requests and scans its part of the LRU lists, see
+ * kswapd_split_scan(), so that when compressing pages for zram dominates
+ * the cost of reclaim it is spread over cpus instead of leaving allocators
+ * to fall into direct reclaim.  Changed under lock_memory_hotplug().
+ */
+int kswapd_threads = 1;
+
+/*
+ * Free memory, in kbytes, that the first kswapd thread of each node keeps
+ * reclaiming towards while the system is idle, split between nodes by
+ * size.  0 disables proactive reclaim.
+ */
+int proactive_free_kbytes;
+
+#define PROACTIVE_RECLAIM_INTERVAL	HZ
+
+static bool kswapd_is_proactive(struct kswapd_thread *kt)
+{
+	return proactive_free_kbytes && !kt->id;
+}
+
+/* No task would wait for a cpu while we reclaim; nr_running() counts us */
+static bool reclaim_is_idle(void)
 {
+	return nr_running() <= num_online_cpus();
+}
+
+static unsigned long pgdat_free_pages(pg_data_t *pgdat)
+{
+	unsigned long nr_free = 0;
+	int i;
+
+	for (i = 0; i < pgdat->nr_zones; i++)
+		nr_free += zone_page_state(pgdat->node_zones + i,
+					   NR_FREE_PAGES);
+	return nr_free;
+}
+
+/*
+ * Reclaim towards the node's share of proactive_free_kbytes, gently: only
+ * at the lowest priorities, SWAP_CLUSTER_MAX pages at a time, and stopping
+ * as soon as the target is met or there is other work for the cpus.
+ */
+static void kswapd_proactive_reclaim(pg_data_t *pgdat)
+{
+	unsigned long target, nr_reclaimed = 0;
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.nr_to_reclaim = SWAP_CLUSTER_MAX,
+		.order = 0,
+		.swappiness = vm_swappiness,
+		.target_mem_cgroup = NULL,
+	};
+	int i;
+
+	target = mult_frac((unsigned long)proactive_free_kbytes >>
+			   (PAGE_SHIFT - 10), pgdat->node_present_pages,
+			   totalram_pages);
+
+	for (sc.priority = DEF_PRIORITY; sc.priority >= DEF_PRIORITY - 2;
+	     sc.priority--) {
+		for (i = pgdat->nr_zones - 1; i >= 0; i--) {
+			struct zone *zone = pgdat->node_zones + i;
+
+			if (!populated_zone(zone) || zone->all_unreclaimable)
+				continue;
+
+			do {
+				if (pgdat_free_pages(pgdat) >= target ||
+				    !reclaim_is_idle() ||
+				    kthread_should_stop() || freezing(current))
+					goto out;
+
+				sc.nr_reclaimed = 0;
+				shrink_zone(zone, &sc);
+				nr_reclaimed += sc.nr_reclaimed;
+				cond_resched();
+			} while (sc.nr_reclaimed);
+		}
+	}
+out:
+	count_vm_events(KSWAPD_PROACTIVE_STEAL, nr_reclaimed);
+}
+
+static void kswapd_try_to_sleep(struct kswapd_thread *kt, int order,
+				int classzone_idx)
+{
+	pg_data_t *pgdat = kt->pgdat;
 	long remaining = 0;
+	bool proactive = false;
 	DEFINE_WAIT(wait);
 
 	if (freezing(current) || kthread_should_stop())
@@ -2885,8 +3463,26 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 		 */
 		set_pgdat_percpu_threshold(pgdat, calculate_normal_threshold);
 
-		if (!kthread_should_stop())
-			schedule();
+		/*
+		 * Reclaim is done with the node for now: a good time for
+		 * kcompactd to defragment what it freed.
+		 */
+		if (!kt->id)
+			wakeup_kcompactd(pgdat);
+
+		/*
+		 * With proactive reclaim, wake up now and then to see if
+		 * the system is idle.  Requests from wakeup_kswapd() that
+		 * arrive meanwhile are still picked up by balance_pgdat()
+		 * on the way back to sleep.
+		 */
+		if (!kthread_should_stop()) {
+			if (kswapd_is_proactive(kt))
+				proactive = !schedule_timeout(
+						PROACTIVE_RECLAIM_INTERVAL);
+			else
+				schedule();
+		}
 
 		set_pgdat_percpu_threshold(pgdat, calculate_pressure_threshold);
 	} else {
@@ -2896,6 +3492,9 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 			count_vm_event(KSWAPD_HIGH_WMARK_HIT_QUICKLY);
 	}
 	finish_wait(&pgdat->kswapd_wait, &wait);
+
+	if (proactive && reclaim_is_idle())
+		kswapd_proactive_reclaim(pgdat);
 }
 
 /*
@@ -2917,7 +3516,8 @@ static int kswapd(void *p)
 	unsigned balanced_order;
 	int classzone_idx, new_classzone_idx;
 	int balanced_classzone_idx;
-	pg_data_t *pgdat = (pg_data_t*)p;
+	struct kswapd_thread *kt = p;
+	pg_data_t *pgdat = kt->pgdat;
 	struct task_struct *tsk = current;
 
 	struct reclaim_state reclaim_state = {
@@ -2960,10 +3560,10 @@ static int kswapd(void *p)
 		 */
 		if (balanced_classzone_idx >= new_classzone_idx &&
 					balanced_order == new_order) {
-			new_order = pgdat->kswapd_max_order;
-			new_classzone_idx = pgdat->classzone_idx;
-			pgdat->kswapd_max_order =  0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			new_order = kt->max_order;
+			new_classzone_idx = kt->classzone_idx;
+			kt->max_order =  0;
+			kt->classzone_idx = pgdat->nr_zones - 1;
 		}
 
 		if (order < new_order || classzone_idx > new_classzone_idx) {
@@ -2974,14 +3574,14 @@ static int kswapd(void *p)
 			order = new_order;
 			classzone_idx = new_classzone_idx;
 		} else {
-			kswapd_try_to_sleep(pgdat, balanced_order,
+			kswapd_try_to_sleep(kt, balanced_order,
 						balanced_classzone_idx);
-			order = pgdat->kswapd_max_order;
-			classzone_idx = pgdat->classzone_idx;
+			order = kt->max_order;
+			classzone_idx = kt->classzone_idx;
 			new_order = order;
 			new_classzone_idx = classzone_idx;
-			pgdat->kswapd_max_order = 0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			kt->max_order = 0;
+			kt->classzone_idx = pgdat->nr_zones - 1;
 		}
 
 		ret = try_to_freeze();
@@ -2995,7 +3595,7 @@ static int kswapd(void *p)
 		if (!ret) {
 			trace_mm_vmscan_kswapd_wake(pgdat->node_id, order);
 			balanced_classzone_idx = classzone_idx;
-			balanced_order = balance_pgdat(pgdat, order,
+			balanced_order = balance_pgdat(kt, order,
 						&balanced_classzone_idx);
 		}
 	}
@@ -3013,6 +3613,7 @@ static int kswapd(void *p)
 void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 {
 	pg_data_t *pgdat;
+	int i;
 
 	if (!populated_zone(zone))
 		return;
@@ -3020,9 +3621,15 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 	if (!cpuset_zone_allowed_hardwall(zone, GFP_KERNEL))
 		return;
 	pgdat = zone->zone_pgdat;
-	if (pgdat->kswapd_max_order < order) {
-		pgdat->kswapd_max_order = order;
-		pgdat->classzone_idx = min(pgdat->classzone_idx, classzone_idx);
+	/* Every thread takes the request, the wakeup below reaches them all */
+	for (i = 0; i < MAX_KSWAPD_THREADS; i++) {
+		struct kswapd_thread *kt = &pgdat->kswapd[i];
+
+		if (kt->task && kt->max_order < order) {
+			kt->max_order = order;
+			kt->classzone_idx = min(kt->classzone_idx,
+						classzone_idx);
+		}
 	}
 	if (!waitqueue_active(&pgdat->kswapd_wait))
 		return;
@@ -3126,12 +3733,17 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 		for_each_node_state(nid, N_HIGH_MEMORY) {
 			pg_data_t *pgdat = NODE_DATA(nid);
 			const struct cpumask *mask;
+			int i;
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
-				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+			if (cpumask_any_and(cpu_online_mask, mask) >= nr_cpu_ids)
+				continue;
+			/* One of our CPUs online: restore mask */
+			for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+				if (pgdat->kswapd[i].task)
+					set_cpus_allowed_ptr(pgdat->kswapd[i].task,
+							     mask);
 		}
 	}
 	return NOTIFY_OK;
@@ -3144,19 +3756,45 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 int kswapd_run(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	int ret = 0;
+	struct task_struct *tsk;
+	int i;
 
-	if (pgdat->kswapd)
-		return 0;
+	for (i = 0; i < kswapd_threads; i++) {
+		struct kswapd_thread *kt = &pgdat->kswapd[i];
+
+		if (kt->task)
+			continue;
 
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
-		/* failure at boot is fatal */
-		BUG_ON(system_state == SYSTEM_BOOTING);
-		printk("Failed to start kswapd on node %d\n",nid);
-		ret = -1;
+		kt->pgdat = pgdat;
+		kt->id = i;
+		kt->max_order = 0;
+		kt->classzone_idx = pgdat->nr_zones - 1;
+		if (i)
+			tsk = kthread_run(kswapd, kt, "kswapd%d:%d", nid, i);
+		else
+			tsk = kthread_run(kswapd, kt, "kswapd%d", nid);
+		if (IS_ERR(tsk)) {
+			/* failure at boot is fatal */
+			BUG_ON(system_state == SYSTEM_BOOTING);
+			printk("Failed to start kswapd on node %d\n",nid);
+			return -1;
+		}
+		kt->task = tsk;
+	}
+	return 0;
+}
+
+static void kswapd_stop_from(int nid, int first)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
+
+	for (i = first; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i].task) {
+			kthread_stop(pgdat->kswapd[i].task);
+			pgdat->kswapd[i].task = NULL;
+		}
 	}
-	return ret;
 }
 
 /*
@@ -3165,12 +3803,31 @@ int kswapd_run(int nid)
  */
 void kswapd_stop(int nid)
 {
-	struct task_struct *kswapd = NODE_DATA(nid)->kswapd;
+	kswapd_stop_from(nid, 0);
+}
 
-	if (kswapd) {
-		kthread_stop(kswapd);
-		NODE_DATA(nid)->kswapd = NULL;
+int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *length,
+				  loff_t *ppos)
+{
+	struct ctl_table t = *table;
+	int nid, threads, ret;
+
+	/* Parse into a copy: node hot-add reads kswapd_threads under the lock */
+	threads = kswapd_threads;
+	t.data = &threads;
+	ret = proc_dointvec_minmax(&t, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	lock_memory_hotplug();
+	kswapd_threads = threads;
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		kswapd_stop_from(nid, kswapd_threads);
+		kswapd_run(nid);
 	}
+	unlock_memory_hotplug();
+	return 0;
 }
 
 static int __init kswapd_init(void)
@@ -3467,7 +4124,7 @@ void check_move_unevictable_pages(struct page **pages, int nr_pages)
 			__dec_zone_state(zone, NR_UNEVICTABLE);
 			lruvec = mem_cgroup_lru_move_lists(zone, page,
 						LRU_UNEVICTABLE, lru);
-			list_move(&page->lru, &lruvec->lists[lru]);
+			list_move(&page->lru, lruvec_add_list(lruvec, lru));
 			__inc_zone_state(zone, NR_INACTIVE_ANON + lru);
 			pgrescued++;
 		}
@@ -602,6 +602,24 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * Share of the free memory, between 0 and 1000, that sits in blocks too
+ * small for an allocation of the given order.  Unlike the fragmentation
+ * index it is meaningful while suitable blocks are still available.
+ */
+int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (!info.free_pages)
+		return 0;
+
+	return div_u64((info.free_pages -
+			(info.free_blocks_suitable << order)) * 1000ULL,
+		       info.free_pages);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -613,6 +631,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -719,6 +740,7 @@ const char * const vmstat_text[] = {
 	"numa_other",
 #endif
 	"nr_anon_transparent_hugepages",
+	"nr_free_cma",
 	"nr_dirty_threshold",
 	"nr_dirty_background_threshold",
 
@@ -752,11 +774,22 @@ const char * const vmstat_text[] = {
 	"kswapd_low_wmark_hit_quickly",
 	"kswapd_high_wmark_hit_quickly",
 	"kswapd_skip_congestion_wait",
+	"kswapd_proactive_steal",
 	"pageoutrun",
 	"allocstall",
 
 	"pgrotated",
 
+	"readahead_used",
+	"readahead_wasted",
+	"readahead_grow",
+	"readahead_shrink",
+
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -764,6 +797,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_migrated",
+	"compact_daemon_msecs",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1010,6 +1046,20 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+#if PCP_HIGH_ORDER > 0
+		{
+			struct per_cpu_order_pages *pcpo;
+			int order;
+
+			for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+				pcpo = &pageset->pcp.orders[order - 1];
+				seq_printf(m, "\n       order %i: count: %i"
+					   " high: %i batch: %i",
+					   order, pcpo->count, pcpo->high,
+					   pcpo->batch);
+			}
+		}
+#endif
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -60,6 +60,7 @@
 #include <linux/scatterlist.h>
 #include <linux/errqueue.h>
 #include <linux/prefetch.h>
+#include <linux/cpu.h>
 
 #include <net/protocol.h>
 #include <net/dst.h>
@@ -75,6 +76,99 @@
 static struct kmem_cache *skbuff_head_cache __read_mostly;
 static struct kmem_cache *skbuff_fclone_cache __read_mostly;
 
+/*
+ * Per cpu cache of sk_buff heads used from softirq context, where most
+ * packets are received and freed: heads are allocated from and returned
+ * to skbuff_head_cache in batches, so the slab allocator is entered once
+ * per batch instead of once per packet.
+ */
+#define SKB_HEAD_CACHE_SIZE	64
+#define SKB_HEAD_CACHE_BULK	16
+
+struct skb_head_cache {
+	unsigned int	count;
+	void		*heads[SKB_HEAD_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct skb_head_cache, skb_head_cache);
+
+/*
+ * Heads parked in the cache skip the slab's allocation and free hooks, so
+ * the cache is off when those poison, check or track objects.
+ */
+static bool skb_head_cache_enabled __read_mostly;
+
+/*
+ * Softirqs do not nest on a cpu, so the cache needs no locking as long as
+ * it is left alone by hard interrupts and by bh-disabled process context.
+ */
+static inline bool skb_head_cache_usable(void)
+{
+	return skb_head_cache_enabled && in_serving_softirq() && !in_irq();
+}
+
+static struct sk_buff *skb_head_cache_get(gfp_t gfp_mask)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(!hc->count)) {
+		if (!kmem_cache_alloc_bulk(skbuff_head_cache, gfp_mask,
+					   SKB_HEAD_CACHE_BULK, hc->heads))
+			return NULL;
+		hc->count = SKB_HEAD_CACHE_BULK;
+	}
+	return hc->heads[--hc->count];
+}
+
+static void skb_head_cache_put(struct sk_buff *skb)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(hc->count == SKB_HEAD_CACHE_SIZE)) {
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_HEAD_CACHE_SIZE / 2,
+				     hc->heads + SKB_HEAD_CACHE_SIZE / 2);
+		hc->count = SKB_HEAD_CACHE_SIZE / 2;
+	}
+	hc->heads[hc->count++] = skb;
+}
+
+static struct sk_buff *skb_head_alloc(gfp_t gfp_mask, int node)
+{
+	struct sk_buff *skb;
+
+	if (node == NUMA_NO_NODE && skb_head_cache_usable()) {
+		skb = skb_head_cache_get(gfp_mask);
+		if (likely(skb))
+			return skb;
+	}
+	return kmem_cache_alloc_node(skbuff_head_cache, gfp_mask, node);
+}
+
+static void skb_head_free(struct sk_buff *skb)
+{
+	if (skb_head_cache_usable())
+		skb_head_cache_put(skb);
+	else
+		kmem_cache_free(skbuff_head_cache, skb);
+}
+
+/* Give the heads cached by a cpu that went offline back to the slab */
+static int skb_cpu_callback(struct notifier_block *nfb,
+			    unsigned long action, void *hcpu)
+{
+	struct skb_head_cache *hc;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN) {
+		hc = &per_cpu(skb_head_cache, (unsigned long)hcpu);
+		if (hc->count) {
+			kmem_cache_free_bulk(skbuff_head_cache, hc->count,
+					     hc->heads);
+			hc->count = 0;
+		}
+	}
+	return NOTIFY_OK;
+}
+
 static void sock_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
@@ -180,7 +274,10 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	cache = fclone ? skbuff_fclone_cache : skbuff_head_cache;
 
 	/* Get the HEAD */
-	skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	if (fclone)
+		skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	else
+		skb = skb_head_alloc(gfp_mask & ~__GFP_DMA, node);
 	if (!skb)
 		goto out;
 	prefetchw(skb);
@@ -239,12 +336,48 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 out:
 	return skb;
 nodata:
-	kmem_cache_free(cache, skb);
+	if (fclone)
+		kmem_cache_free(cache, skb);
+	else
+		skb_head_free(skb);
 	skb = NULL;
 	goto out;
 }
 EXPORT_SYMBOL(__alloc_skb);
 
+/**
+ *	__alloc_skb_head - allocate a network buffer without data
+ *	@gfp_mask: allocation mask
+ *	@node: numa node to allocate memory on
+ *
+ *	Allocate a new &sk_buff with a NULL head. The owner attaches its own
+ *	data area and must reset skb->head to %NULL again from the skb
+ *	destructor, so that freeing the skb leaves the data area alone.
+ */
+struct sk_buff *__alloc_skb_head(gfp_t gfp_mask, int node)
+{
+	struct sk_buff *skb;
+
+	skb = skb_head_alloc(gfp_mask & ~__GFP_DMA, node);
+	if (!skb)
+		return NULL;
+
+	/*
+	 * Only clear those fields we need to clear, not those that we will
+	 * actually initialise below. Hence, don't put any more fields after
+	 * the tail pointer in struct sk_buff!
+	 */
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->head = NULL;
+	skb->truesize = sizeof(struct sk_buff);
+	atomic_set(&skb->users, 1);
+#ifdef NET_SKBUFF_DATA_USES_OFFSET
+	skb->mac_header = ~0U;
+#endif
+	return skb;
+}
+EXPORT_SYMBOL(__alloc_skb_head);
+
 /**
  * build_skb - build a network buffer
  * @data: data buffer provided by caller
@@ -267,7 +400,7 @@ struct sk_buff *build_skb(void *data)
 	struct sk_buff *skb;
 	unsigned int size;
 
-	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+	skb = skb_head_alloc(GFP_ATOMIC, NUMA_NO_NODE);
 	if (!skb)
 		return NULL;
 
@@ -419,7 +552,7 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		skb_head_free(skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -475,7 +608,8 @@ static void skb_release_head_state(struct sk_buff *skb)
 static void skb_release_all(struct sk_buff *skb)
 {
 	skb_release_head_state(skb);
-	skb_release_data(skb);
+	if (likely(skb->head))
+		skb_release_data(skb);
 }
 
 /**
@@ -2968,6 +3102,8 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	skb_head_cache_enabled = !kmem_cache_debugged(skbuff_head_cache);
+	hotcpu_notifier(skb_cpu_callback, 0);
 }
 
 /**
@@ -486,6 +486,7 @@ relookup:
 		p->pmtu_expires = 0;
 		p->pmtu_orig = 0;
 		memset(&p->redirect_learned, 0, sizeof(p->redirect_learned));
+		memset(&p->tcp_fastopen, 0, sizeof(p->tcp_fastopen));
 		INIT_LIST_HEAD(&p->gc_list);
 
 		/* Link the node. */
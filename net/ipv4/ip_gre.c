@@ -680,7 +680,7 @@ static int ipgre_rcv(struct sk_buff *skb)
 		skb_reset_network_header(skb);
 		ipgre_ecn_decapsulate(iph, skb);
 
-		netif_rx(skb);
+		gro_cells_receive(&tunnel->gro_cells, skb);
 
 		rcu_read_unlock();
 		return 0;
@@ -1258,6 +1258,9 @@ static const struct net_device_ops ipgre_netdev_ops = {
 
 static void ipgre_dev_free(struct net_device *dev)
 {
+	struct ip_tunnel *tunnel = netdev_priv(dev);
+
+	gro_cells_destroy(&tunnel->gro_cells);
 	free_percpu(dev->tstats);
 	free_netdev(dev);
 }
@@ -1307,7 +1310,7 @@ static int ipgre_tunnel_init(struct net_device *dev)
 	if (!dev->tstats)
 		return -ENOMEM;
 
-	return 0;
+	return gro_cells_init(&tunnel->gro_cells, dev);
 }
 
 static void ipgre_fb_tunnel_init(struct net_device *dev)
@@ -1497,7 +1500,7 @@ static int ipgre_tap_init(struct net_device *dev)
 	if (!dev->tstats)
 		return -ENOMEM;
 
-	return 0;
+	return gro_cells_init(&tunnel->gro_cells, dev);
 }
 
 static const struct net_device_ops ipgre_tap_netdev_ops = {
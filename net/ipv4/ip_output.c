@@ -824,7 +824,8 @@ static int __ip_append_data(struct sock *sk,
 	skb = skb_peek_tail(queue);
 
 	exthdrlen = !skb ? rt->dst.header_len : 0;
-	mtu = cork->fragsize;
+	/* A UDP GSO send is built as one skb and segmented on the way out */
+	mtu = cork->gso_size ? IP_MAX_MTU : cork->fragsize;
 
 	hh_len = LL_RESERVED_SPACE(rt->dst.dev);
 
@@ -898,6 +899,14 @@ alloc_new_skb:
 			datalen = length + fraggap;
 			if (datalen > mtu - fragheaderlen)
 				datalen = maxfraglen - fragheaderlen;
+			/*
+			 * Past the first segment, put a GSO payload in page
+			 * frags instead of one high-order linear buffer.
+			 */
+			if (cork->gso_size &&
+			    (rt->dst.dev->features & NETIF_F_SG) &&
+			    datalen > transhdrlen + cork->gso_size)
+				datalen = transhdrlen + cork->gso_size;
 			fraglen = datalen + fragheaderlen;
 
 			if ((flags & MSG_MORE) &&
@@ -1091,6 +1100,7 @@ static int ip_setup_cork(struct sock *sk, struct inet_cork *cork,
 	cork->dst = &rt->dst;
 	cork->length = 0;
 	cork->tx_flags = ipc->tx_flags;
+	cork->gso_size = ipc->gso_size;
 	cork->page = NULL;
 	cork->off = 0;
 
@@ -1498,6 +1508,7 @@ void ip_send_reply(struct sock *sk, struct sk_buff *skb, __be32 daddr,
 	ipc.addr = daddr;
 	ipc.opt = NULL;
 	ipc.tx_flags = 0;
+	ipc.gso_size = 0;
 
 	if (replyopts.opt.opt.optlen) {
 		ipc.opt = &replyopts.opt;
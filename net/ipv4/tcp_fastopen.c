@@ -0,0 +1,134 @@
+/*
+ * TCP Fast Open: carry data in the SYN of repeat connections.
+ *
+ * A server hands out a cookie, the AES encryption of the client address
+ * under a key chosen at boot, and accepts data in a later SYN that comes
+ * back with a valid cookie before the handshake has completed.  Clients
+ * remember the cookie, the server MSS and recent SYN losses in the
+ * inet_peer of the destination.
+ */
+
+#define pr_fmt(fmt) "TCP: " fmt
+
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/seqlock.h>
+#include <linux/tcp.h>
+#include <net/inetpeer.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+#define TCP_FASTOPEN_KEY_LENGTH	16
+
+static struct crypto_cipher *tcp_fastopen_tfm __read_mostly;
+
+/* Computes the fastopen cookie for the peer.
+ * The peer address is a 128 bits long (pad with zeros for IPv4).
+ *
+ * The caller must check foc->len to determine if a valid cookie
+ * has been generated successfully.
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__be32 peer_addr[4] = { addr, 0, 0, 0 };
+	struct crypto_cipher *tfm = ACCESS_ONCE(tcp_fastopen_tfm);
+
+	if (tfm) {
+		crypto_cipher_encrypt_one(tfm, foc->val, (__u8 *)peer_addr);
+		foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	}
+}
+
+/* Protects the tcp_fastopen fields of every inet_peer; they are only
+ * written when a SYN-ACK is processed, so one lock is plenty.
+ */
+static DEFINE_SEQLOCK(fastopen_seqlock);
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct inet_peer *peer;
+	bool release_it;
+	unsigned int seq;
+
+	peer = icsk->icsk_af_ops->get_peer(sk, &release_it);
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&fastopen_seqlock);
+		if (peer->tcp_fastopen.mss)
+			*mss = peer->tcp_fastopen.mss;
+		cookie->len = peer->tcp_fastopen.cookie_len;
+		memcpy(cookie->val, peer->tcp_fastopen.cookie,
+		       sizeof(cookie->val));
+		*syn_loss = peer->tcp_fastopen.syn_loss;
+		*last_syn_loss = *syn_loss ?
+				 peer->tcp_fastopen.last_syn_loss : 0;
+	} while (read_seqretry(&fastopen_seqlock, seq));
+
+	if (release_it)
+		inet_putpeer(peer);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct inet_peer *peer;
+	bool release_it;
+
+	peer = icsk->icsk_af_ops->get_peer(sk, &release_it);
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&fastopen_seqlock);
+	if (mss)
+		peer->tcp_fastopen.mss = mss;
+	if (cookie->len > 0) {
+		peer->tcp_fastopen.cookie_len = cookie->len;
+		memcpy(peer->tcp_fastopen.cookie, cookie->val,
+		       sizeof(peer->tcp_fastopen.cookie));
+	}
+	if (syn_lost) {
+		++peer->tcp_fastopen.syn_loss;
+		peer->tcp_fastopen.last_syn_loss = jiffies;
+	} else
+		peer->tcp_fastopen.syn_loss = 0;
+	write_sequnlock_bh(&fastopen_seqlock);
+
+	if (release_it)
+		inet_putpeer(peer);
+}
+
+static int __init tcp_fastopen_init(void)
+{
+	__u8 key[TCP_FASTOPEN_KEY_LENGTH];
+	struct crypto_cipher *tfm;
+	int err;
+
+	tfm = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("TFO aes cipher alloc error: %ld\n", PTR_ERR(tfm));
+		return PTR_ERR(tfm);
+	}
+
+	get_random_bytes(key, sizeof(key));
+	err = crypto_cipher_setkey(tfm, key, sizeof(key));
+	if (err) {
+		pr_err("TFO cipher key error: %d\n", err);
+		crypto_free_cipher(tfm);
+		return err;
+	}
+
+	tcp_fastopen_tfm = tfm;
+	return 0;
+}
+
+late_initcall(tcp_fastopen_init);
@@ -97,6 +97,7 @@
 #include <linux/inet.h>
 #include <linux/netdevice.h>
 #include <linux/slab.h>
+#include <linux/static_key.h>
 #include <net/tcp_states.h>
 #include <linux/skbuff.h>
 #include <linux/proc_fs.h>
@@ -137,6 +138,7 @@ static int udp_lib_lport_inuse(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 
 	sk_nulls_for_each(sk2, node, &hslot->head)
 		if (net_eq(sock_net(sk2), net) &&
@@ -145,6 +147,8 @@ static int udp_lib_lport_inuse(struct net *net, __u16 num,
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (*saddr_comp)(sk, sk2)) {
 			if (bitmap)
 				__set_bit(udp_sk(sk2)->udp_port_hash >> log,
@@ -167,6 +171,7 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 	int res = 0;
 
 	spin_lock(&hslot2->lock);
@@ -177,6 +182,8 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (*saddr_comp)(sk, sk2)) {
 			res = 1;
 			break;
@@ -407,19 +414,34 @@ static struct sock *udp4_lib_lookup2(struct net *net,
 {
 	struct sock *sk, *result;
 	struct hlist_nulls_node *node;
-	int score, badness;
+	int score, badness, matches = 0, reuseport;
+	u32 hash = 0;
 
 begin:
 	result = NULL;
 	badness = -1;
+	reuseport = 0;
 	udp_portaddr_for_each_entry_rcu(sk, node, &hslot2->head) {
 		score = compute_score2(sk, net, saddr, sport,
 				      daddr, hnum, dif);
 		if (score > badness) {
 			result = sk;
 			badness = score;
-			if (score == SCORE2_MAX)
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			} else if (score == SCORE2_MAX)
 				goto exact_match;
+		} else if (score == badness && reuseport) {
+			/* Spread datagrams over the SO_REUSEPORT group,
+			 * keeping each 4-tuple on the same socket.
+			 */
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -455,7 +477,8 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 	unsigned short hnum = ntohs(dport);
 	unsigned int hash2, slot2, slot = udp_hashfn(net, hnum, udptable->mask);
 	struct udp_hslot *hslot2, *hslot = &udptable->hash[slot];
-	int score, badness;
+	int score, badness, matches = 0, reuseport;
+	u32 hash = 0;
 
 	rcu_read_lock();
 	if (hslot->count > 10) {
@@ -485,12 +508,24 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 begin:
 	result = NULL;
 	badness = -1;
+	reuseport = 0;
 	sk_nulls_for_each_rcu(sk, node, &hslot->head) {
 		score = compute_score(sk, net, saddr, hnum, sport,
 				      daddr, dport, dif);
 		if (score > badness) {
 			result = sk;
 			badness = score;
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			}
+		} else if (score == badness && reuseport) {
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -709,7 +744,8 @@ static void udp4_hwcsum(struct sk_buff *skb, __be32 src, __be32 dst)
 	}
 }
 
-static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
+static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4,
+			u16 gso_size)
 {
 	struct sock *sk = skb->sk;
 	struct inet_sock *inet = inet_sk(sk);
@@ -729,6 +765,23 @@ static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
 	uh->len = htons(len);
 	uh->check = 0;
 
+	if (gso_size) {
+		/* Segments are checksummed by the device or in skb_segment */
+		if (skb->ip_summed != CHECKSUM_PARTIAL || is_udplite ||
+		    skb_has_frags(skb) || dst_xfrm(skb_dst(skb))) {
+			kfree_skb(skb);
+			return -EIO;
+		}
+		if (len - sizeof(*uh) > gso_size) {
+			skb_shinfo(skb)->gso_size = gso_size;
+			skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+			skb_shinfo(skb)->gso_segs = DIV_ROUND_UP(len - sizeof(*uh),
+								 gso_size);
+		}
+		udp4_hwcsum(skb, fl4->saddr, fl4->daddr);
+		goto send;
+	}
+
 	if (is_udplite)  				 /*     UDP-Lite      */
 		csum = udplite_csum(skb);
 
@@ -780,7 +833,7 @@ int udp_push_pending_frames(struct sock *sk)
 	if (!skb)
 		goto out;
 
-	err = udp_send_skb(skb, fl4);
+	err = udp_send_skb(skb, fl4, 0);
 
 out:
 	up->len = 0;
@@ -822,6 +875,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 
 	ipc.opt = NULL;
 	ipc.tx_flags = 0;
+	ipc.gso_size = 0;
 
 	getfrag = is_udplite ? udplite_getfrag : ip_generic_getfrag;
 
@@ -963,12 +1017,23 @@ back_from_confirm:
 
 	/* Lockless fast path for the non-corking case. */
 	if (!corkreq) {
+		ipc.gso_size = up->gso_size;
+		if (ipc.gso_size) {
+			/* Each segment must fit the path MTU on its own */
+			err = -EINVAL;
+			if (sizeof(struct iphdr) +
+			    (ipc.opt ? ipc.opt->opt.optlen : 0) +
+			    sizeof(struct udphdr) + ipc.gso_size >
+			    dst_mtu(&rt->dst) ||
+			    ulen > ipc.gso_size * UDP_MAX_SEGMENTS)
+				goto out;
+		}
 		skb = ip_make_skb(sk, fl4, getfrag, msg->msg_iov, ulen,
 				  sizeof(struct udphdr), &ipc, &rt,
 				  msg->msg_flags);
 		err = PTR_ERR(skb);
 		if (skb && !IS_ERR(skb))
-			err = udp_send_skb(skb, fl4);
+			err = udp_send_skb(skb, fl4, ipc.gso_size);
 		goto out;
 	}
 
@@ -1238,6 +1303,11 @@ try_again:
 	}
 	if (inet->cmsg_flags)
 		ip_cmsg_recv(msg, skb);
+	if (udp_sk(sk)->gro_enabled && skb_is_gso(skb)) {
+		int gso_size = skb_shinfo(skb)->gso_size;
+
+		put_cmsg(msg, SOL_UDP, UDP_GRO, sizeof(gso_size), &gso_size);
+	}
 
 	err = copied;
 	if (flags & MSG_TRUNC)
@@ -1400,6 +1470,12 @@ int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 		goto drop;
 	nf_reset(skb);
 
+	/* GRO only coalesces for sockets that asked for it with UDP_GRO,
+	 * but the option may have been cleared since.
+	 */
+	if (unlikely(skb_is_gso(skb) && !up->gro_enabled))
+		goto drop;
+
 	if (up->encap_type) {
 		int (*encap_rcv)(struct sock *sk, struct sk_buff *skb);
 
@@ -1714,11 +1790,17 @@ int udp_rcv(struct sk_buff *skb)
 	return __udp4_lib_rcv(skb, &udp_table, IPPROTO_UDP);
 }
 
+/* Keeps the socket lookup off the GRO path while no socket uses UDP_GRO */
+static struct static_key udp_gro_needed __read_mostly;
+
 void udp_destroy_sock(struct sock *sk)
 {
 	bool slow = lock_sock_fast(sk);
 	udp_flush_pending_frames(sk);
 	unlock_sock_fast(sk, slow);
+
+	if (udp_sk(sk)->gro_enabled)
+		static_key_slow_dec(&udp_gro_needed);
 }
 
 /*
@@ -1797,6 +1879,28 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		up->pcflag |= UDPLITE_RECV_CC;
 		break;
 
+	/* Segmentation and coalescing are only done for IPv4 so far */
+	case UDP_SEGMENT:
+		if (sk->sk_family != AF_INET || is_udplite)
+			return -ENOPROTOOPT;
+		if (val < 0 || val > USHRT_MAX)
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
+	case UDP_GRO:
+		if (sk->sk_family != AF_INET || is_udplite)
+			return -ENOPROTOOPT;
+		/* Each socket holds udp_gro_needed once while enabled */
+		lock_sock(sk);
+		if (val && !up->gro_enabled)
+			static_key_slow_inc(&udp_gro_needed);
+		else if (!val && up->gro_enabled)
+			static_key_slow_dec(&udp_gro_needed);
+		up->gro_enabled = val ? 1 : 0;
+		release_sock(sk);
+		break;
+
 	default:
 		err = -ENOPROTOOPT;
 		break;
@@ -1859,6 +1963,14 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->pcrlen;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
+	case UDP_GRO:
+		val = up->gro_enabled;
+		break;
+
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -2233,6 +2345,70 @@ int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/*
+ * Split a UDP_SEGMENT send, or a datagram train built by GRO, back into
+ * datagrams of gso_size payload, each with its own UDP header.
+ */
+static struct sk_buff *udp4_gso_segment(struct sk_buff *skb,
+	netdev_features_t features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	unsigned int mss = skb_shinfo(skb)->gso_size;
+	const struct iphdr *iph;
+	struct sk_buff *seg;
+	struct udphdr *uh;
+	unsigned int len;
+
+	if (unlikely(skb->len <= sizeof(*uh) + mss))
+		goto out;
+
+	if (!pskb_may_pull(skb, sizeof(*uh)))
+		goto out;
+
+	if (skb_gso_ok(skb, features | NETIF_F_GSO_ROBUST)) {
+		/* Packet is from an untrusted source, reset gso_segs. */
+		int type = skb_shinfo(skb)->gso_type;
+
+		if (unlikely(type & ~(SKB_GSO_UDP_L4 | SKB_GSO_DODGY)))
+			goto out;
+
+		skb_shinfo(skb)->gso_segs = DIV_ROUND_UP(skb->len - sizeof(*uh),
+							 mss);
+		segs = NULL;
+		goto out;
+	}
+
+	__skb_pull(skb, sizeof(*uh));
+	segs = skb_segment(skb, features);
+	if (IS_ERR(segs))
+		goto out;
+
+	for (seg = segs; seg; seg = seg->next) {
+		iph = ip_hdr(seg);
+		uh = udp_hdr(seg);
+		len = seg->len - skb_transport_offset(seg);
+
+		uh->len = htons(len);
+		uh->check = 0;
+		if (seg->ip_summed == CHECKSUM_PARTIAL) {
+			seg->csum_start = skb_transport_header(seg) - seg->head;
+			seg->csum_offset = offsetof(struct udphdr, check);
+			uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+						       len, IPPROTO_UDP, 0);
+		} else {
+			/* skb_segment left the payload sum in seg->csum */
+			uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr,
+					len, IPPROTO_UDP,
+					csum_partial(uh, sizeof(*uh),
+						     seg->csum));
+			if (uh->check == 0)
+				uh->check = CSUM_MANGLED_0;
+		}
+	}
+out:
+	return segs;
+}
+
 struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	netdev_features_t features)
 {
@@ -2241,6 +2417,9 @@ struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	int offset;
 	__wsum csum;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4)
+		return udp4_gso_segment(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -2276,3 +2455,120 @@ out:
 	return segs;
 }
 
+/*
+ * Coalesce datagrams of one flow for sockets that set UDP_GRO: the
+ * receiver gets one skb holding back to back payloads of gso_size bytes,
+ * the last one possibly shorter, and the segment size in a cmsg.
+ */
+struct sk_buff **udp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	struct sk_buff **pp = NULL;
+	struct udphdr *uh, *uh2;
+	struct sk_buff *p;
+	unsigned int hlen, off, ulen;
+	struct sock *sk;
+	int flush = 1;
+
+	if (!static_key_false(&udp_gro_needed))
+		goto out;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*uh);
+	uh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto out;
+	}
+
+	/* A zero checksum could not be reproduced when segmenting */
+	ulen = ntohs(uh->len);
+	if (!uh->check || ulen <= sizeof(*uh) || ulen != skb_gro_len(skb))
+		goto out;
+
+	if (ipv4_is_multicast(iph->daddr) || ipv4_is_lbcast(iph->daddr))
+		goto out;
+
+	switch (skb->ip_summed) {
+	case CHECKSUM_COMPLETE:
+		if (!csum_tcpudp_magic(iph->saddr, iph->daddr, ulen,
+				       IPPROTO_UDP, skb->csum)) {
+			skb->ip_summed = CHECKSUM_UNNECESSARY;
+			break;
+		}
+		goto out;
+	case CHECKSUM_NONE:
+		goto out;
+	}
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	if (!sk)
+		goto out;
+	flush = !udp_sk(sk)->gro_enabled || udp_sk(sk)->encap_type;
+	sock_put(sk);
+	if (flush)
+		goto out;
+
+	skb_gro_pull(skb, sizeof(*uh));
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = udp_hdr(p);
+
+		/* Checksums are never zero here, so the ports are the flow */
+		if (*(u32 *)&uh->source ^ *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		goto found;
+	}
+
+	/* New flow: hold it, nothing to flush */
+	flush = 0;
+	goto out;
+
+found:
+	/* A longer datagram cannot follow, it would not fit gso_size, so
+	 * it starts a new train instead; a shorter one ends this train.
+	 */
+	hlen = ntohs(uh2->len);
+	if (NAPI_GRO_CB(p)->flush || ulen > hlen ||
+	    skb_gro_receive(head, skb)) {
+		pp = head;
+		goto out;
+	}
+
+	p = *head;
+	if (ulen != hlen || NAPI_GRO_CB(p)->count >= UDP_GRO_CNT_MAX)
+		pp = head;
+
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+int udp4_gro_complete(struct sk_buff *skb)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct udphdr *uh = udp_hdr(skb);
+	int len = skb->len - skb_transport_offset(skb);
+
+	uh->len = htons(len);
+	uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr, len,
+				       IPPROTO_UDP, 0);
+	skb->csum_start = skb_transport_header(skb) - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+
+	return 0;
+}
@@ -62,9 +62,96 @@ int (*nf_nat_seq_adjust_hook)(struct sk_buff *skb,
 			      unsigned int protoff);
 EXPORT_SYMBOL_GPL(nf_nat_seq_adjust_hook);
 
+/*
+ * nf_conntrack_lock protects the expectations and the helper assignments.
+ * The hash table is protected by nf_conntrack_locks[], bucket i by lock
+ * i % CONNTRACK_LOCKS, and the unconfirmed and dying lists by the lock of
+ * the per-cpu list an entry is on.  Lookups are lockless under RCU.
+ *
+ * Lock order: nf_conntrack_lock, bucket locks, per-cpu list lock.
+ */
 DEFINE_SPINLOCK(nf_conntrack_lock);
 EXPORT_SYMBOL_GPL(nf_conntrack_lock);
 
+__cacheline_aligned_in_smp spinlock_t nf_conntrack_locks[CONNTRACK_LOCKS];
+EXPORT_SYMBOL_GPL(nf_conntrack_locks);
+
+static __cacheline_aligned_in_smp DEFINE_SPINLOCK(nf_conntrack_locks_all_lock);
+static bool nf_conntrack_locks_all;
+
+/* Take a bucket lock, waiting for a table resize to complete. */
+void nf_conntrack_bucket_lock(spinlock_t *lock) __acquires(lock)
+{
+	spin_lock(lock);
+	if (likely(!ACCESS_ONCE(nf_conntrack_locks_all))) {
+		/* pairs with the barrier in nf_conntrack_all_unlock() */
+		smp_rmb();
+		return;
+	}
+
+	/* a resize is in progress: wait for it behind the global lock */
+	spin_unlock(lock);
+	spin_lock(&nf_conntrack_locks_all_lock);
+	spin_lock(lock);
+	spin_unlock(&nf_conntrack_locks_all_lock);
+}
+EXPORT_SYMBOL_GPL(nf_conntrack_bucket_lock);
+
+static void nf_conntrack_double_unlock(unsigned int h1, unsigned int h2)
+{
+	h1 %= CONNTRACK_LOCKS;
+	h2 %= CONNTRACK_LOCKS;
+	spin_unlock(&nf_conntrack_locks[h1]);
+	if (h1 != h2)
+		spin_unlock(&nf_conntrack_locks[h2]);
+}
+
+/* Returns true if the buckets must be recomputed after a table resize. */
+static bool nf_conntrack_double_lock(struct net *net, unsigned int h1,
+				     unsigned int h2, unsigned int sequence)
+{
+	h1 %= CONNTRACK_LOCKS;
+	h2 %= CONNTRACK_LOCKS;
+	if (h1 > h2)
+		swap(h1, h2);
+
+	nf_conntrack_bucket_lock(&nf_conntrack_locks[h1]);
+	if (h1 != h2)
+		spin_lock_nested(&nf_conntrack_locks[h2],
+				 SINGLE_DEPTH_NESTING);
+
+	if (read_seqcount_retry(&net->ct.generation, sequence)) {
+		nf_conntrack_double_unlock(h1, h2);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Excludes all bucket lock holders: the ones that took their lock before
+ * nf_conntrack_locks_all was set are waited for, later ones wait for
+ * nf_conntrack_all_unlock() in nf_conntrack_bucket_lock().
+ */
+static void nf_conntrack_all_lock(void)
+{
+	int i;
+
+	spin_lock(&nf_conntrack_locks_all_lock);
+	nf_conntrack_locks_all = true;
+
+	for (i = 0; i < CONNTRACK_LOCKS; i++) {
+		spin_lock(&nf_conntrack_locks[i]);
+		spin_unlock(&nf_conntrack_locks[i]);
+	}
+}
+
+static void nf_conntrack_all_unlock(void)
+{
+	smp_wmb();
+	nf_conntrack_locks_all = false;
+	spin_unlock(&nf_conntrack_locks_all_lock);
+}
+
 unsigned int nf_conntrack_htable_size __read_mostly;
 EXPORT_SYMBOL_GPL(nf_conntrack_htable_size);
 
@@ -189,9 +276,49 @@ clean_from_lists(struct nf_conn *ct)
 	pr_debug("clean_from_lists(%pK)\n", ct);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode);
+}
+
+/* Destroy all pending expectations */
+static void clean_expectations(struct nf_conn *ct)
+{
+	/* Optimization: most connection never expect any others. */
+	if (!nfct_help(ct))
+		return;
 
-	/* Destroy all pending expectations */
+	spin_lock_bh(&nf_conntrack_lock);
 	nf_ct_remove_expectations(ct);
+	spin_unlock_bh(&nf_conntrack_lock);
+}
+
+/*
+ * The unconfirmed and dying lists are per cpu, on the cpu that added the
+ * entry.  We overload the first tuple to link into them.
+ */
+static void nf_ct_add_to_pcpu_list(struct nf_conn *ct, bool dying)
+{
+	struct ct_pcpu *pcpu;
+
+	local_bh_disable();
+	ct->cpu = smp_processor_id();
+	pcpu = per_cpu_ptr(nf_ct_net(ct)->ct.pcpu_lists, ct->cpu);
+
+	spin_lock(&pcpu->lock);
+	hlist_nulls_add_head_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
+				 dying ? &pcpu->dying : &pcpu->unconfirmed);
+	spin_unlock(&pcpu->lock);
+	local_bh_enable();
+}
+
+static void nf_ct_del_from_pcpu_list(struct nf_conn *ct)
+{
+	struct ct_pcpu *pcpu;
+
+	pcpu = per_cpu_ptr(nf_ct_net(ct)->ct.pcpu_lists, ct->cpu);
+
+	spin_lock_bh(&pcpu->lock);
+	BUG_ON(hlist_nulls_unhashed(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode));
+	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
+	spin_unlock_bh(&pcpu->lock);
 }
 
 static void
@@ -215,21 +342,16 @@ destroy_conntrack(struct nf_conntrack *nfct)
 
 	rcu_read_unlock();
 
-	spin_lock_bh(&nf_conntrack_lock);
-	/* Expectations will have been removed in clean_from_lists,
+	/* Expectations will have been removed in nf_ct_delete_from_lists,
 	 * except TFTP can create an expectation on the first packet,
 	 * before connection is in the list, so we need to clean here,
 	 * too. */
-	nf_ct_remove_expectations(ct);
+	clean_expectations(ct);
 
-	/* We overload first tuple to link into unconfirmed list. */
-	if (!nf_ct_is_confirmed(ct)) {
-		BUG_ON(hlist_nulls_unhashed(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode));
-		hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
-	}
+	if (!nf_ct_is_confirmed(ct))
+		nf_ct_del_from_pcpu_list(ct);
 
-	NF_CT_STAT_INC(net, delete);
-	spin_unlock_bh(&nf_conntrack_lock);
+	NF_CT_STAT_INC_ATOMIC(net, delete);
 
 	if (ct->master)
 		nf_ct_put(ct->master);
@@ -241,14 +363,28 @@ destroy_conntrack(struct nf_conntrack *nfct)
 void nf_ct_delete_from_lists(struct nf_conn *ct)
 {
 	struct net *net = nf_ct_net(ct);
+	unsigned int hash, repl_hash, sequence;
+	u16 zone = nf_ct_zone(ct);
 
 	nf_ct_helper_destroy(ct);
-	spin_lock_bh(&nf_conntrack_lock);
-	/* Inside lock so preempt is disabled on module removal path.
+
+	local_bh_disable();
+	do {
+		sequence = read_seqcount_begin(&net->ct.generation);
+		hash = hash_conntrack(net, zone,
+				      &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
+		repl_hash = hash_conntrack(net, zone,
+					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+	} while (nf_conntrack_double_lock(net, hash, repl_hash, sequence));
+
+	/* BHs are disabled so preempt is disabled on module removal path.
 	 * Otherwise we can get spurious warnings. */
 	NF_CT_STAT_INC(net, delete_list);
 	clean_from_lists(ct);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_conntrack_double_unlock(hash, repl_hash);
+	local_bh_enable();
+
+	clean_expectations(ct);
 }
 EXPORT_SYMBOL_GPL(nf_ct_delete_from_lists);
 
@@ -269,9 +405,7 @@ static void death_by_event(unsigned long ul_conntrack)
 	}
 	/* we've got the event delivered, now it's dying */
 	set_bit(IPS_DYING_BIT, &ct->status);
-	spin_lock(&nf_conntrack_lock);
-	hlist_nulls_del(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
-	spin_unlock(&nf_conntrack_lock);
+	nf_ct_del_from_pcpu_list(ct);
 	nf_ct_put(ct);
 }
 
@@ -283,10 +417,7 @@ void nf_ct_insert_dying_list(struct nf_conn *ct)
 	BUG_ON(ecache == NULL);
 
 	/* add this conntrack to the dying list */
-	spin_lock_bh(&nf_conntrack_lock);
-	hlist_nulls_add_head(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
-			     &net->ct.dying);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_ct_add_to_pcpu_list(ct, true);
 	/* set a new timer to retry event delivery */
 	setup_timer(&ecache->timeout, death_by_event, (unsigned long)ct);
 	ecache->timeout.expires = jiffies +
@@ -336,7 +467,7 @@ nf_ct_key_equal(struct nf_conntrack_tuple_hash *h,
  * - Caller must take a reference on returned object
  *   and recheck nf_ct_tuple_equal(tuple, &h->tuple)
  * OR
- * - Caller must lock nf_conntrack_lock before calling this function
+ * - Caller must hold the bucket lock before calling this function
  */
 static struct nf_conntrack_tuple_hash *
 ____nf_conntrack_find(struct net *net, u16 zone,
@@ -435,18 +566,21 @@ int
 nf_conntrack_hash_check_insert(struct nf_conn *ct)
 {
 	struct net *net = nf_ct_net(ct);
-	unsigned int hash, repl_hash;
+	unsigned int hash, repl_hash, sequence;
 	struct nf_conntrack_tuple_hash *h;
 	struct hlist_nulls_node *n;
 	u16 zone;
 
 	zone = nf_ct_zone(ct);
-	hash = hash_conntrack(net, zone,
-			      &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
-	repl_hash = hash_conntrack(net, zone,
-				   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
 
-	spin_lock_bh(&nf_conntrack_lock);
+	local_bh_disable();
+	do {
+		sequence = read_seqcount_begin(&net->ct.generation);
+		hash = hash_conntrack(net, zone,
+				      &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
+		repl_hash = hash_conntrack(net, zone,
+					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+	} while (nf_conntrack_double_lock(net, hash, repl_hash, sequence));
 
 	/* See if there's one in the list already, including reverse */
 	hlist_nulls_for_each_entry(h, n, &net->ct.hash[hash], hnnode)
@@ -464,13 +598,15 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 	nf_conntrack_get(&ct->ct_general);
 	__nf_conntrack_hash_insert(ct, hash, repl_hash);
 	NF_CT_STAT_INC(net, insert);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_conntrack_double_unlock(hash, repl_hash);
+	local_bh_enable();
 
 	return 0;
 
 out:
 	NF_CT_STAT_INC(net, insert_failed);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_conntrack_double_unlock(hash, repl_hash);
+	local_bh_enable();
 	return -EEXIST;
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_hash_check_insert);
@@ -479,7 +615,7 @@ EXPORT_SYMBOL_GPL(nf_conntrack_hash_check_insert);
 int
 __nf_conntrack_confirm(struct sk_buff *skb)
 {
-	unsigned int hash, repl_hash;
+	unsigned int hash, repl_hash, sequence;
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 	struct nf_conn_help *help;
@@ -500,11 +636,15 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		return NF_ACCEPT;
 
 	zone = nf_ct_zone(ct);
-	/* reuse the hash saved before */
-	hash = *(unsigned long *)&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev;
-	hash = hash_bucket(hash, net);
-	repl_hash = hash_conntrack(net, zone,
-				   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+	local_bh_disable();
+	do {
+		sequence = read_seqcount_begin(&net->ct.generation);
+		/* reuse the hash saved before */
+		hash = *(unsigned long *)&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev;
+		hash = hash_bucket(hash, net);
+		repl_hash = hash_conntrack(net, zone,
+					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+	} while (nf_conntrack_double_lock(net, hash, repl_hash, sequence));
 
 	/* We're not in hash table, and we refuse to set up related
 	   connections for unconfirmed conns.  But packet copies and
@@ -516,15 +656,14 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	NF_CT_ASSERT(!nf_ct_is_confirmed(ct));
 	pr_debug("Confirming conntrack %pK\n", ct);
 
-	spin_lock_bh(&nf_conntrack_lock);
-
 	/* We have to check the DYING flag inside the lock to prevent
 	   a race against nf_ct_get_next_corpse() possibly called from
 	   user context, else we insert an already 'dead' hash, blocking
 	   further use of that particular connection -JM */
 
 	if (unlikely(nf_ct_is_dying(ct))) {
-		spin_unlock_bh(&nf_conntrack_lock);
+		nf_conntrack_double_unlock(hash, repl_hash);
+		local_bh_enable();
 		return NF_ACCEPT;
 	}
 
@@ -543,7 +682,7 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 			goto out;
 
 	/* Remove from unconfirmed list */
-	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
+	nf_ct_del_from_pcpu_list(ct);
 
 	/* Timer relative to confirmation time, not original
 	   setting time, otherwise we'd get timer wrap in
@@ -568,7 +707,8 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	 */
 	__nf_conntrack_hash_insert(ct, hash, repl_hash);
 	NF_CT_STAT_INC(net, insert);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_conntrack_double_unlock(hash, repl_hash);
+	local_bh_enable();
 
 	help = nfct_help(ct);
 	if (help && help->helper)
@@ -580,7 +720,8 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 
 out:
 	NF_CT_STAT_INC(net, insert_failed);
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_conntrack_double_unlock(hash, repl_hash);
+	local_bh_enable();
 	return NF_DROP;
 }
 EXPORT_SYMBOL_GPL(__nf_conntrack_confirm);
@@ -783,6 +924,9 @@ void nf_conntrack_free(struct nf_conn *ct)
 	nf_ct_ext_destroy(ct);
 	atomic_dec(&net->ct.count);
 	nf_ct_ext_free(ct);
+	/* Only confirmed entries get into the flow cache, see below */
+	if (nf_ct_is_confirmed(ct))
+		atomic_inc(&net->ct.flow_cache_gen);
 	kmem_cache_free(net->ct.nf_conntrack_cachep, ct);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_free);
@@ -802,7 +946,7 @@ init_conntrack(struct net *net, struct nf_conn *tmpl,
 	struct nf_conn_help *help;
 	struct nf_conntrack_tuple repl_tuple;
 	struct nf_conntrack_ecache *ecache;
-	struct nf_conntrack_expect *exp;
+	struct nf_conntrack_expect *exp = NULL;
 	u16 zone = tmpl ? nf_ct_zone(tmpl) : NF_CT_DEFAULT_ZONE;
 	struct nf_conn_timeout *timeout_ext;
 	unsigned int *timeouts;
@@ -841,39 +985,45 @@ init_conntrack(struct net *net, struct nf_conn *tmpl,
 				 ecache ? ecache->expmask : 0,
 			     GFP_ATOMIC);
 
-	spin_lock_bh(&nf_conntrack_lock);
-	exp = nf_ct_find_expectation(net, zone, tuple);
-	if (exp) {
-		pr_debug("conntrack: expectation arrives ct=%pK exp=%pK\n",
-			 ct, exp);
-		/* Welcome, Mr. Bond.  We've been expecting you... */
-		__set_bit(IPS_EXPECTED_BIT, &ct->status);
-		ct->master = exp->master;
-		if (exp->helper) {
-			help = nf_ct_helper_ext_add(ct, exp->helper,
-						    GFP_ATOMIC);
-			if (help)
-				rcu_assign_pointer(help->helper, exp->helper);
-		}
+	/* Most flows are not expected: only take the lock if some are. */
+	local_bh_disable();
+	if (net->ct.expect_count) {
+		spin_lock(&nf_conntrack_lock);
+		exp = nf_ct_find_expectation(net, zone, tuple);
+		if (exp) {
+			pr_debug("conntrack: expectation arrives ct=%pK exp=%pK\n",
+				 ct, exp);
+			/* Welcome, Mr. Bond.  We've been expecting you... */
+			__set_bit(IPS_EXPECTED_BIT, &ct->status);
+			ct->master = exp->master;
+			if (exp->helper) {
+				help = nf_ct_helper_ext_add(ct, exp->helper,
+							    GFP_ATOMIC);
+				if (help)
+					rcu_assign_pointer(help->helper,
+							   exp->helper);
+			}
 
 #ifdef CONFIG_NF_CONNTRACK_MARK
-		ct->mark = exp->master->mark;
+			ct->mark = exp->master->mark;
 #endif
 #ifdef CONFIG_NF_CONNTRACK_SECMARK
-		ct->secmark = exp->master->secmark;
+			ct->secmark = exp->master->secmark;
 #endif
-		nf_conntrack_get(&ct->master->ct_general);
-		NF_CT_STAT_INC(net, expect_new);
-	} else {
+			nf_conntrack_get(&ct->master->ct_general);
+			NF_CT_STAT_INC(net, expect_new);
+		}
+		spin_unlock(&nf_conntrack_lock);
+	}
+	if (!exp) {
+		/* Helpers are RCU protected, and unregistering one waits
+		 * for us to be on the unconfirmed list. */
 		__nf_ct_try_assign_helper(ct, tmpl, GFP_ATOMIC);
 		NF_CT_STAT_INC(net, new);
 	}
 
-	/* Overload tuple linked list to put us in unconfirmed list. */
-	hlist_nulls_add_head_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
-		       &net->ct.unconfirmed);
-
-	spin_unlock_bh(&nf_conntrack_lock);
+	nf_ct_add_to_pcpu_list(ct, false);
+	local_bh_enable();
 
 	if (exp) {
 		if (exp->expectfn)
@@ -884,6 +1034,90 @@ init_conntrack(struct net *net, struct nf_conn *tmpl,
 	return &ct->tuplehash[IP_CT_DIR_ORIGINAL];
 }
 
+/*
+ * Per-cpu cache of the entries of established flows, indexed by the flow
+ * hash that the device or RPS already computed for the packet, with one
+ * slot per direction as that hash is symmetric.  A hit saves hashing the
+ * tuple and walking the bucket.
+ *
+ * The cache holds no references.  SLAB_DESTROY_BY_RCU only keeps an entry
+ * found within the current RCU read side section mapped, so each slot
+ * records net->ct.flow_cache_gen, which nf_conntrack_free() bumps before
+ * a confirmed conntrack goes back to the slab.  A slot with an older
+ * generation is never dereferenced; a current one points to memory that
+ * is still a conntrack, possibly recycled, and is revalidated like in
+ * __nf_conntrack_find_get().
+ */
+#define NF_CT_FLOW_CACHE_SIZE	256
+
+struct nf_ct_flow_cache_slot {
+	struct nf_conntrack_tuple_hash	*h;
+	unsigned int			gen;
+};
+
+struct nf_ct_flow_cache {
+	struct nf_ct_flow_cache_slot slot[NF_CT_FLOW_CACHE_SIZE][IP_CT_DIR_MAX];
+};
+
+static struct nf_conntrack_tuple_hash *
+nf_ct_flow_cache_get(struct net *net, const struct sk_buff *skb, u16 zone,
+		     const struct nf_conntrack_tuple *tuple)
+{
+	unsigned int gen = atomic_read(&net->ct.flow_cache_gen);
+	struct nf_conntrack_tuple_hash *h = NULL;
+	struct nf_ct_flow_cache_slot *slot;
+	struct nf_ct_flow_cache *cache;
+	struct nf_conn *ct;
+	int dir;
+
+	cache = get_cpu_ptr(net->ct.flow_cache);
+	slot = cache->slot[skb->rxhash % NF_CT_FLOW_CACHE_SIZE];
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		if (slot[dir].gen != gen)
+			continue;
+		h = slot[dir].h;
+		if (h && nf_ct_key_equal(h, tuple, zone))
+			break;
+		h = NULL;
+	}
+	put_cpu_ptr(net->ct.flow_cache);
+
+	if (!h)
+		return NULL;
+
+	ct = nf_ct_tuplehash_to_ctrack(h);
+	if (unlikely(nf_ct_is_dying(ct) ||
+		     !atomic_inc_not_zero(&ct->ct_general.use)))
+		return NULL;
+	/*
+	 * The slot may now point to a recycled object: under the reference,
+	 * only a confirmed conntrack with our tuple is a hit.  Anything
+	 * else, a new unconfirmed one included, is left to the hash lookup.
+	 */
+	if (unlikely(!nf_ct_is_confirmed(ct) ||
+		     !nf_ct_key_equal(h, tuple, zone))) {
+		nf_ct_put(ct);
+		return NULL;
+	}
+	NF_CT_STAT_INC_ATOMIC(net, found);
+	return h;
+}
+
+static void nf_ct_flow_cache_set(struct net *net, const struct sk_buff *skb,
+				 struct nf_conntrack_tuple_hash *h)
+{
+	struct nf_ct_flow_cache_slot *slot;
+	struct nf_ct_flow_cache *cache;
+
+	/* We hold a reference: h cannot be freed before the bump */
+	cache = get_cpu_ptr(net->ct.flow_cache);
+	slot = &cache->slot[skb->rxhash % NF_CT_FLOW_CACHE_SIZE]
+			   [NF_CT_DIRECTION(h)];
+	slot->h = h;
+	slot->gen = atomic_read(&net->ct.flow_cache_gen);
+	put_cpu_ptr(net->ct.flow_cache);
+}
+
 /* On success, returns conntrack ptr, sets skb->nfct and ctinfo */
 static inline struct nf_conn *
 resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
@@ -910,15 +1144,20 @@ resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
 	}
 
 	/* look for tuple match */
-	hash = hash_conntrack_raw(&tuple, zone);
-	h = __nf_conntrack_find_get(net, zone, &tuple, hash);
+	h = skb->rxhash ? nf_ct_flow_cache_get(net, skb, zone, &tuple) : NULL;
 	if (!h) {
-		h = init_conntrack(net, tmpl, &tuple, l3proto, l4proto,
-				   skb, dataoff, hash);
-		if (!h)
-			return NULL;
-		if (IS_ERR(h))
-			return (void *)h;
+		hash = hash_conntrack_raw(&tuple, zone);
+		h = __nf_conntrack_find_get(net, zone, &tuple, hash);
+		if (!h) {
+			h = init_conntrack(net, tmpl, &tuple, l3proto, l4proto,
+					   skb, dataoff, hash);
+			if (!h)
+				return NULL;
+			if (IS_ERR(h))
+				return (void *)h;
+		} else if (skb->rxhash) {
+			nf_ct_flow_cache_set(net, skb, h);
+		}
 	}
 	ct = nf_ct_tuplehash_to_ctrack(h);
 
@@ -1243,25 +1482,43 @@ get_next_corpse(struct net *net, int (*iter)(struct nf_conn *i, void *data),
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 	struct hlist_nulls_node *n;
+	spinlock_t *lockp;
+	int cpu;
 
-	spin_lock_bh(&nf_conntrack_lock);
 	for (; *bucket < net->ct.htable_size; (*bucket)++) {
-		hlist_nulls_for_each_entry(h, n, &net->ct.hash[*bucket], hnnode) {
+		lockp = &nf_conntrack_locks[*bucket % CONNTRACK_LOCKS];
+		local_bh_disable();
+		nf_conntrack_bucket_lock(lockp);
+		/* the table may have shrunk while we were waiting */
+		if (*bucket < net->ct.htable_size) {
+			hlist_nulls_for_each_entry(h, n,
+						   &net->ct.hash[*bucket],
+						   hnnode) {
+				ct = nf_ct_tuplehash_to_ctrack(h);
+				if (iter(ct, data))
+					goto found;
+			}
+		}
+		spin_unlock(lockp);
+		local_bh_enable();
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct ct_pcpu *pcpu = per_cpu_ptr(net->ct.pcpu_lists, cpu);
+
+		spin_lock_bh(&pcpu->lock);
+		hlist_nulls_for_each_entry(h, n, &pcpu->unconfirmed, hnnode) {
 			ct = nf_ct_tuplehash_to_ctrack(h);
 			if (iter(ct, data))
-				goto found;
+				set_bit(IPS_DYING_BIT, &ct->status);
 		}
+		spin_unlock_bh(&pcpu->lock);
 	}
-	hlist_nulls_for_each_entry(h, n, &net->ct.unconfirmed, hnnode) {
-		ct = nf_ct_tuplehash_to_ctrack(h);
-		if (iter(ct, data))
-			set_bit(IPS_DYING_BIT, &ct->status);
-	}
-	spin_unlock_bh(&nf_conntrack_lock);
 	return NULL;
 found:
 	atomic_inc(&ct->ct_general.use);
-	spin_unlock_bh(&nf_conntrack_lock);
+	spin_unlock(lockp);
+	local_bh_enable();
 	return ct;
 }
 
@@ -1337,14 +1594,19 @@ static void nf_ct_release_dying_list(struct net *net)
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 	struct hlist_nulls_node *n;
+	int cpu;
 
-	spin_lock_bh(&nf_conntrack_lock);
-	hlist_nulls_for_each_entry(h, n, &net->ct.dying, hnnode) {
-		ct = nf_ct_tuplehash_to_ctrack(h);
-		/* never fails to remove them, no listeners at this point */
-		nf_ct_kill(ct);
+	for_each_possible_cpu(cpu) {
+		struct ct_pcpu *pcpu = per_cpu_ptr(net->ct.pcpu_lists, cpu);
+
+		spin_lock_bh(&pcpu->lock);
+		hlist_nulls_for_each_entry(h, n, &pcpu->dying, hnnode) {
+			ct = nf_ct_tuplehash_to_ctrack(h);
+			/* never fails to remove them, no listeners at this point */
+			nf_ct_kill(ct);
+		}
+		spin_unlock_bh(&pcpu->lock);
 	}
-	spin_unlock_bh(&nf_conntrack_lock);
 }
 
 static int untrack_refs(void)
@@ -1391,6 +1653,8 @@ static void nf_conntrack_cleanup_net(struct net *net)
 	kmem_cache_destroy(net->ct.nf_conntrack_cachep);
 	kfree(net->ct.slabname);
 	free_percpu(net->ct.stat);
+	free_percpu(net->ct.flow_cache);
+	free_percpu(net->ct.pcpu_lists);
 }
 
 /* Mishearing the voices in his head, our hero wonders how he's
@@ -1463,9 +1727,12 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 	/* Lookups in the old hash might happen in parallel, which means we
 	 * might get false negatives during connection lookup. New connections
 	 * created because of a false negative won't make it into the hash
-	 * though since that required taking the lock.
+	 * though since that required taking the locks.  nf_conntrack_lock
+	 * keeps the walk of the helper unregistration consistent.
 	 */
 	spin_lock_bh(&nf_conntrack_lock);
+	nf_conntrack_all_lock();
+	write_seqcount_begin(&init_net.ct.generation);
 	for (i = 0; i < init_net.ct.htable_size; i++) {
 		while (!hlist_nulls_empty(&init_net.ct.hash[i])) {
 			h = hlist_nulls_entry(init_net.ct.hash[i].first,
@@ -1482,6 +1749,8 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 
 	init_net.ct.htable_size = nf_conntrack_htable_size = hashsize;
 	init_net.ct.hash = hash;
+	write_seqcount_end(&init_net.ct.generation);
+	nf_conntrack_all_unlock();
 	spin_unlock_bh(&nf_conntrack_lock);
 
 	nf_ct_free_hashtable(old_hash, old_size);
@@ -1504,7 +1773,10 @@ EXPORT_SYMBOL_GPL(nf_ct_untracked_status_or);
 static int nf_conntrack_init_init_net(void)
 {
 	int max_factor = 8;
-	int ret, cpu;
+	int i, ret, cpu;
+
+	for (i = 0; i < CONNTRACK_LOCKS; i++)
+		spin_lock_init(&nf_conntrack_locks[i]);
 
 	/* Idea from tcp.c: use 1/16384 of memory.  On i386: 32MB
 	 * machine has 512 buckets. >= 1GB machines have 16384 buckets. */
@@ -1564,11 +1836,31 @@ err_proto:
 
 static int nf_conntrack_init_net(struct net *net)
 {
-	int ret;
+	int ret, cpu;
 
 	atomic_set(&net->ct.count, 0);
-	INIT_HLIST_NULLS_HEAD(&net->ct.unconfirmed, UNCONFIRMED_NULLS_VAL);
-	INIT_HLIST_NULLS_HEAD(&net->ct.dying, DYING_NULLS_VAL);
+	atomic_set(&net->ct.flow_cache_gen, 0);
+	seqcount_init(&net->ct.generation);
+
+	net->ct.pcpu_lists = alloc_percpu(struct ct_pcpu);
+	if (!net->ct.pcpu_lists) {
+		ret = -ENOMEM;
+		goto err_pcpu_lists;
+	}
+	for_each_possible_cpu(cpu) {
+		struct ct_pcpu *pcpu = per_cpu_ptr(net->ct.pcpu_lists, cpu);
+
+		spin_lock_init(&pcpu->lock);
+		INIT_HLIST_NULLS_HEAD(&pcpu->unconfirmed, UNCONFIRMED_NULLS_VAL);
+		INIT_HLIST_NULLS_HEAD(&pcpu->dying, DYING_NULLS_VAL);
+	}
+
+	net->ct.flow_cache = alloc_percpu(struct nf_ct_flow_cache);
+	if (!net->ct.flow_cache) {
+		ret = -ENOMEM;
+		goto err_flow_cache;
+	}
+
 	net->ct.stat = alloc_percpu(struct ip_conntrack_stat);
 	if (!net->ct.stat) {
 		ret = -ENOMEM;
@@ -1643,6 +1935,10 @@ err_cache:
 err_slabname:
 	free_percpu(net->ct.stat);
 err_stat:
+	free_percpu(net->ct.flow_cache);
+err_flow_cache:
+	free_percpu(net->ct.pcpu_lists);
+err_pcpu_lists:
 	return ret;
 }
 
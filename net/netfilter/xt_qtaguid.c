@@ -185,17 +185,19 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  *     iface_stat_list_lock
  *
  * qtaguid_mt()
+ *   iface_stat_update_from_skb()
+ *     rcu_read_lock()
+ *       (iface_stat_list)
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock()
+ *         (iface_stat_list)
+ *         get_sock_stat_rcu()
+ *           (sk->sk_qtag)
+ *         struct iface_stat->tag_stat_list_lock
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             read tag_counter_set_list_lock
  *
  *
  * qtaguid_ctrl_parse()
@@ -227,7 +229,7 @@ static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
-static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+static DEFINE_RWLOCK(tag_counter_set_list_lock);
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -269,6 +271,21 @@ static inline void dc_add_byte_packets(struct data_counters *counters, int set,
 	counters->bpc[set][direction][ifs_proto].packets += packets;
 }
 
+/* Counters are created from atomic context, alloc_percpu() could sleep */
+static struct data_counters_cpu *dc_cpu_alloc(void)
+{
+	return kcalloc(nr_cpu_ids, sizeof(struct data_counters_cpu),
+		       GFP_ATOMIC);
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
+
+	kfree(ts_entry->counters);
+	kfree(ts_entry);
+}
+
 static struct tag_node *tag_node_tree_search(struct rb_root *root, tag_t tag)
 {
 	struct rb_node *node = root->rb_node;
@@ -417,7 +434,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sock_put(st_entry->sk);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -736,17 +753,18 @@ static int get_active_counter_set(tag_t tag)
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
+	read_lock_bh(&tag_counter_set_list_lock);
 	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (tcs)
 		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	read_unlock_bh(&tag_counter_set_list_lock);
 	return active_set;
 }
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock(): entries are
+ * added with list_add_rcu() and never removed.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -759,7 +777,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -786,9 +804,9 @@ static int pp_iface_stat_line(bool header, char *outp,
 			       "tx_other_bytes tx_other_packets\n"
 			);
 	} else {
-		struct data_counters *cnts;
+		struct data_counters totals, *cnts = &totals;
 		int cnt_set = 0;   /* We only use one set for the device */
-		cnts = &iface_entry->totals_via_skb;
+		dc_fold(cnts, iface_entry->totals_via_skb);
 		len = snprintf(
 			outp, char_count,
 			"%s "
@@ -989,6 +1007,14 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
+	new_iface->totals_via_skb = dc_cpu_alloc();
+	if (new_iface->totals_via_skb == NULL) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "counters alloc failed\n", net_dev->name);
+		kfree(new_iface->ifname);
+		kfree(new_iface);
+		return NULL;
+	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
 	_iface_stat_set_active(new_iface, net_dev, true);
@@ -1002,6 +1028,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		kfree(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -1009,7 +1036,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1190,16 +1217,26 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * The packet path gets the tag from the socket instead of searching
+ * sock_tag_tree: sk->sk_qtag is only set and cleared under sock_tag_list_lock
+ * while the sock_tag holds a reference on sk, and sock_tags are freed after
+ * a grace period.
+ * Caller must hold rcu_read_lock().
+ */
+static struct sock_tag *get_sock_stat_rcu(const struct sock *sk)
 {
-	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
-	if (!sk)
+	MT_DEBUG("qtaguid: get_sock_stat_rcu(sk=%p)\n", sk);
+	if (!sk || sk->sk_state == TCP_TIME_WAIT)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	return rcu_dereference(sk->sk_qtag);
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_unlink(struct sock_tag *st_entry)
+{
+	rb_erase(&st_entry->sock_node, &sock_tag_tree);
+	RCU_INIT_POINTER(st_entry->sk->sk_qtag, NULL);
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1223,10 +1260,15 @@ static int ipx_proto(const struct sk_buff *skb,
 	return tproto;
 }
 
+/* Called from the netfilter hooks, with BHs disabled */
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct data_counters_cpu *cnts, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_cpu *dcc = &cnts[smp_processor_id()];
+	struct data_counters *dc = &dcc->dc;
+
+	u64_stats_update_begin(&dcc->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1240,6 +1282,7 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&dcc->syncp);
 }
 
 /*
@@ -1350,21 +1393,21 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 		 par->hooknum, __func__, el_dev->name, el_dev->type,
 		 par->family, proto, direction);
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid[%d]: iface_stat: %s(%s): not tracked\n",
 			 par->hooknum, __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid[%d]: %s(%s): entry=%p\n", par->hooknum,  __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
+	data_counters_update(entry->totals_via_skb, 0, direction, proto,
 			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	rcu_read_unlock();
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
@@ -1376,7 +1419,7 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(tag_entry->counters, active_set, direction,
 			     proto, bytes);
 	if (tag_entry->parent_counters)
 		data_counters_update(tag_entry->parent_counters, active_set,
@@ -1400,6 +1443,13 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->counters = dc_cpu_alloc();
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
@@ -1413,7 +1463,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct data_counters_cpu *uid_tag_counters;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
@@ -1421,12 +1471,12 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err_ratelimited("qtaguid: tag_stat: stat_update() "
 				   "%s not found\n", ifname);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
@@ -1438,7 +1488,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
+	sock_tag_entry = get_sock_stat_rcu(sk);
 	if (sock_tag_entry) {
 		tag = sock_tag_entry->tag;
 		acct_tag = get_atag_from_tag(tag);
@@ -1451,12 +1501,17 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: tag_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
+	/*
+	 * Loop over tag list under this interface for {acct_tag,uid_tag}.
+	 * The lock only covers the tree: the counters are per cpu, and
+	 * ctrl_cmd_delete() frees tag_stats after a grace period.
+	 */
 	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
 	if (tag_stat_entry) {
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 		/*
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
@@ -1476,17 +1531,17 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
-			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+			goto unlock_tree;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
 		/* Create the child {acct_tag, uid_tag} and hook up parent. */
 		new_tag_stat = create_if_tag_stat(iface_entry, tag);
 		if (!new_tag_stat)
-			goto unlock;
+			goto unlock_tree;
 		new_tag_stat->parent_counters = uid_tag_counters;
 	} else {
 		/*
@@ -1499,10 +1554,13 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
+	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 	tag_stat_update(new_tag_stat, direction, proto, bytes);
-unlock:
+	goto unlock;
+unlock_tree:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-	spin_unlock_bh(&iface_stat_list_lock);
+unlock:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -2104,7 +2162,7 @@ static int ctrl_cmd_delete(const char *input)
 			 input, st_entry->tag, entry_uid);
 
 		if (!acct_tag || st_entry->tag == tag) {
-			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_unlink(st_entry);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2127,7 +2185,7 @@ static int ctrl_cmd_delete(const char *input)
 	sock_tag_tree_erase(&st_to_free_tree);
 
 	/* Delete tag counter-sets */
-	spin_lock_bh(&tag_counter_set_list_lock);
+	write_lock_bh(&tag_counter_set_list_lock);
 	/* Counter sets are only on the uid tag, not full tag */
 	tcs_entry = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (tcs_entry) {
@@ -2140,7 +2198,7 @@ static int ctrl_cmd_delete(const char *input)
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
 	}
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	write_unlock_bh(&tag_counter_set_list_lock);
 
 	/*
 	 * If acct_tag is 0, then all entries belonging to uid are
@@ -2169,7 +2227,7 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2238,12 +2296,12 @@ static int ctrl_cmd_counter_set(const char *input)
 	}
 
 	tag = make_tag_from_uid(uid);
-	spin_lock_bh(&tag_counter_set_list_lock);
+	write_lock_bh(&tag_counter_set_list_lock);
 	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (!tcs) {
 		tcs = kzalloc(sizeof(*tcs), GFP_ATOMIC);
 		if (!tcs) {
-			spin_unlock_bh(&tag_counter_set_list_lock);
+			write_unlock_bh(&tag_counter_set_list_lock);
 			pr_err("qtaguid: ctrl_counterset(%s): "
 			       "failed to alloc counter set\n",
 			       input);
@@ -2257,7 +2315,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	write_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
 
@@ -2275,6 +2333,7 @@ static int ctrl_cmd_tag(const char *input)
 	struct socket *el_socket;
 	int res, argc;
 	struct sock_tag *sock_tag_entry;
+	struct sock_tag *new_sock_tag_entry;
 	struct tag_ref *tag_ref_entry;
 	struct uid_tag_data *uid_tag_data_entry;
 	struct proc_qtu_data *pqd_entry;
@@ -2336,6 +2395,25 @@ static int ctrl_cmd_tag(const char *input)
 		goto err_put;
 	}
 	tag_ref_entry->num_sock_tags++;
+	/*
+	 * The packet path reads the published sock_tag without locks, so
+	 * a retag replaces the entry instead of updating its tag.
+	 */
+	new_sock_tag_entry = kzalloc(sizeof(*new_sock_tag_entry), GFP_ATOMIC);
+	if (!new_sock_tag_entry) {
+		pr_err("qtaguid: ctrl_tag(%s): "
+		       "socket tag alloc failed\n",
+		       input);
+		BUG_ON(tag_ref_entry->num_sock_tags <= 0);
+		tag_ref_entry->num_sock_tags--;
+		free_tag_ref_from_utd_entry(tag_ref_entry,
+					    uid_tag_data_entry);
+		spin_unlock_bh(&uid_tag_data_tree_lock);
+		spin_unlock_bh(&sock_tag_list_lock);
+		res = -ENOMEM;
+		goto err_put;
+	}
+	new_sock_tag_entry->tag = full_tag;
 	if (sock_tag_entry) {
 		struct tag_ref *prev_tag_ref_entry;
 
@@ -2348,33 +2426,29 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
-		sock_tag_entry->tag = full_tag;
+		/* The sk reference moves over to the new entry */
+		new_sock_tag_entry->sk = sock_tag_entry->sk;
+		new_sock_tag_entry->pid = sock_tag_entry->pid;
+		rb_replace_node(&sock_tag_entry->sock_node,
+				&new_sock_tag_entry->sock_node,
+				&sock_tag_tree);
+		if (sock_tag_entry->list.next && sock_tag_entry->list.prev)
+			list_replace(&sock_tag_entry->list,
+				     &new_sock_tag_entry->list);
+		rcu_assign_pointer(el_socket->sk->sk_qtag,
+				   new_sock_tag_entry);
+		kfree_rcu(sock_tag_entry, rcu);
+		sock_tag_entry = new_sock_tag_entry;
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
-		sock_tag_entry = kzalloc(sizeof(*sock_tag_entry),
-					 GFP_ATOMIC);
-		if (!sock_tag_entry) {
-			pr_err("qtaguid: ctrl_tag(%s): "
-			       "socket tag alloc failed\n",
-			       input);
-			BUG_ON(tag_ref_entry->num_sock_tags <= 0);
-			tag_ref_entry->num_sock_tags--;
-			free_tag_ref_from_utd_entry(tag_ref_entry,
-						    uid_tag_data_entry);
-			spin_unlock_bh(&uid_tag_data_tree_lock);
-			spin_unlock_bh(&sock_tag_list_lock);
-			res = -ENOMEM;
-			goto err_put;
-		}
+		sock_tag_entry = new_sock_tag_entry;
 		/* Hold the sk refcount here to make sure the sk pointer cannot
 		 * be freed and reused
 		 */
 		sock_hold(el_socket->sk);
 		sock_tag_entry->sk = el_socket->sk;
 		sock_tag_entry->pid = current->tgid;
-		sock_tag_entry->tag = combine_atag_with_uid(acct_tag,
-							    uid);
 		pqd_entry = proc_qtu_data_tree_search(
 			&proc_qtu_data_tree, current->tgid);
 		/*
@@ -2394,6 +2468,7 @@ static int ctrl_cmd_tag(const char *input)
 				 &pqd_entry->sock_tag_list);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		rcu_assign_pointer(el_socket->sk->sk_qtag, sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&uid_tag_data_tree_lock);
@@ -2466,7 +2541,7 @@ int qtaguid_untag(struct socket *el_socket, bool kernel)
 	 * The socket already belongs to the current process
 	 * so it can do whatever it wants to it.
 	 */
-	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_unlink(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2507,7 +2582,7 @@ int qtaguid_untag(struct socket *el_socket, bool kernel)
 		 sock_tag_entry,
 		 atomic_read(&el_socket->sk->sk_refcnt));
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2583,7 +2658,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters totals, *cnts = &totals;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2614,7 +2689,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		dc_fold(cnts, ppi->ts_entry->counters);
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2861,7 +2936,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		tr->num_sock_tags--;
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
-		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_unlink(st_entry);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -11,8 +11,13 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -197,6 +202,42 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * The packet path updates counters without taking any lock: there is one
+ * data_counters_cpu per possible cpu, only ever written by that cpu with BHs
+ * disabled by the netfilter core, and readers add them all up with dc_fold().
+ */
+struct data_counters_cpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+static inline void dc_fold(struct data_counters *sum,
+			   const struct data_counters_cpu *cnts)
+{
+	struct data_counters snap;
+	unsigned int start;
+	int cpu, set, dir, proto;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		do {
+			start = u64_stats_fetch_begin(&cnts[cpu].syncp);
+			snap = cnts[cpu].dc;
+		} while (u64_stats_fetch_retry(&cnts[cpu].syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					sum->bpc[set][dir][proto].bytes +=
+						snap.bpc[set][dir][proto].bytes;
+					sum->bpc[set][dir][proto].packets +=
+						snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
 
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
@@ -206,23 +247,25 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct data_counters_cpu *counters;  /* nr_cpu_ids entries */
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters_cpu *parent_counters;
+	/* The packet path updates the counters after dropping the tree lock */
+	struct rcu_head rcu;
 };
 
 struct iface_stat {
-	struct list_head list;  /* in iface_stat_list */
+	struct list_head list;  /* in iface_stat_list, RCU for the packet path */
 	char *ifname;
 	bool active;
 	/* net_dev is only valid for active iface_stat */
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	struct data_counters_cpu *totals_via_skb;  /* nr_cpu_ids entries */
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -255,12 +298,17 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
-	struct sock *sk;  /* Only used as a number, never dereferenced */
+	struct sock *sk;  /* Held while tagged, points back via sk->sk_qtag */
 	/* Used to associate with a given pid */
 	struct list_head list;   /* in proc_qtu_data.sock_tag_list */
 	pid_t pid;
 
+	/*
+	 * Never changed once published in sk->sk_qtag: the packet path reads
+	 * it under rcu_read_lock(), so a retag installs a new sock_tag.
+	 */
 	tag_t tag;
+	struct rcu_head rcu;
 };
 
 struct qtaguid_event_counts {
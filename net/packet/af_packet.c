@@ -2824,7 +2824,8 @@ static int packet_recvmsg(struct kiocb *iocb, struct socket *sock,
 				vnet_hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
 			else if (sinfo->gso_type & SKB_GSO_UDP)
 				vnet_hdr.gso_type = VIRTIO_NET_HDR_GSO_UDP;
-			else if (sinfo->gso_type & SKB_GSO_FCOE)
+			else if (sinfo->gso_type & (SKB_GSO_FCOE |
+						     SKB_GSO_UDP_L4))
 				goto out_free;
 			else
 				BUG();